@@ -0,0 +1,379 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "CollectableSubsystem.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundBase.h"
+#include "PortalSubsystem.h"
+
+// "stat collectable"
+DECLARE_STATS_GROUP(TEXT("Collectable"), STATGROUP_Collectable, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT(TEXT("Update"), STAT_CollectableUpdate, STATGROUP_Collectable);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Collectables"), STAT_Collectables, STATGROUP_Collectable);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Instanced Batches"), STAT_CollectableBatches, STATGROUP_Collectable);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Cells Tested"), STAT_CollectableCellsTested, STATGROUP_Collectable);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Collected"), STAT_CollectablesCollected, STATGROUP_Collectable);
+
+UCollectableSubsystem::UCollectableSubsystem()
+{
+	MaxSweepDistance = 500.0f;
+	CellSize = 512.0f;
+	MaxPickupRadius = 0.0f;
+	NextCollectableId = 0;
+	BatchOwner = nullptr;
+}
+
+void UCollectableSubsystem::Deinitialize()
+{
+	TickFunction.Unregister();
+
+	Collectables.Empty();
+	CollectableIndices.Empty();
+	Batches.Empty();
+	Cells.Empty();
+	LastCollectorLocations.Empty();
+	BatchComponents.Empty();
+	CollectSounds.Empty();
+	BatchOwner = nullptr;
+
+	Super::Deinitialize();
+}
+
+int32 UCollectableSubsystem::SpawnCollectable(const FCollectableType& Type, const FTransform& Transform)
+{
+	UWorld* World = GetWorld();
+
+	if (World == nullptr || !World->IsGameWorld() || Type.Mesh == nullptr)
+	{
+		return INDEX_NONE;
+	}
+
+	int32 BatchIndex = FindOrAddBatch(Type);
+
+	if (BatchIndex == INDEX_NONE)
+	{
+		return INDEX_NONE;
+	}
+
+	FBatch& Batch = Batches[BatchIndex];
+
+	//-----------------------------------
+	// Reuse a hidden instance before
+	// growing the instanced component
+	//-----------------------------------
+	int32 Instance;
+
+	if (Batch.FreeInstances.Num() > 0)
+	{
+		Instance = Batch.FreeInstances.Pop(false);
+		Batch.Component->UpdateInstanceTransform(Instance, Transform, true, false, true);
+		Batch.bDirty = true;
+	}
+	else
+	{
+		Instance = Batch.Component->AddInstanceWorldSpace(Transform);
+	}
+
+	FCollectable Collectable;
+	Collectable.Id = NextCollectableId++;
+	Collectable.TypeName = Type.Name;
+	Collectable.Transform = Transform;
+	Collectable.PickupRadius = FMath::Max(Type.PickupRadius, 0.0f);
+	Collectable.CollectSound = Type.CollectSound;
+	Collectable.Batch = BatchIndex;
+	Collectable.Instance = Instance;
+	Collectable.Cell = GetCell(Transform.GetLocation());
+
+	int32 Index = Collectables.Add(Collectable);
+	CollectableIndices.Add(Collectable.Id, Index);
+	Cells.FindOrAdd(Collectable.Cell).Add(Index);
+
+	MaxPickupRadius = FMath::Max(MaxPickupRadius, Collectable.PickupRadius);
+
+	if (Type.CollectSound != nullptr)
+	{
+		CollectSounds.AddUnique(Type.CollectSound);
+	}
+
+	// Only tick worlds that have collectables
+	TickFunction.Register(this);
+
+	return Collectable.Id;
+}
+
+void UCollectableSubsystem::RemoveCollectable(int32 CollectableId)
+{
+	const int32* Index = CollectableIndices.Find(CollectableId);
+
+	if (Index != nullptr)
+	{
+		ReleaseCollectable(*Index);
+	}
+}
+
+bool UCollectableSubsystem::IsCollectableActive(int32 CollectableId) const
+{
+	return CollectableIndices.Contains(CollectableId);
+}
+
+int32 UCollectableSubsystem::GetNumCollectables() const
+{
+	return Collectables.Num();
+}
+
+int32 UCollectableSubsystem::FindOrAddBatch(const FCollectableType& Type)
+{
+	int32 BatchIndex = Batches.IndexOfByPredicate([&Type](const FBatch& Batch)
+	{
+		return Batch.Mesh == Type.Mesh && Batch.Materials == Type.OverrideMaterials;
+	});
+
+	if (BatchIndex != INDEX_NONE)
+	{
+		return BatchIndex;
+	}
+
+	//-----------------------------------
+	// One transient actor holds the instanced
+	// components of every batch
+	//-----------------------------------
+	if (BatchOwner == nullptr)
+	{
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.Name = TEXT("CollectableBatches");
+		SpawnParameters.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+		SpawnParameters.ObjectFlags |= RF_Transient;
+
+		BatchOwner = GetWorld()->SpawnActor<AActor>(SpawnParameters);
+
+		if (BatchOwner == nullptr)
+		{
+			return INDEX_NONE;
+		}
+
+		USceneComponent* Root = NewObject<USceneComponent>(BatchOwner, TEXT("Root"));
+		BatchOwner->SetRootComponent(Root);
+		Root->RegisterComponent();
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(BatchOwner);
+	Component->SetStaticMesh(Type.Mesh);
+
+	for (int32 MaterialIndex = 0; MaterialIndex < Type.OverrideMaterials.Num(); MaterialIndex++)
+	{
+		Component->SetMaterial(MaterialIndex, Type.OverrideMaterials[MaterialIndex]);
+	}
+
+	// Picked up by the grid, not by overlaps
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->SetGenerateOverlapEvents(false);
+	Component->SetCanEverAffectNavigation(false);
+	Component->SetupAttachment(BatchOwner->GetRootComponent());
+	Component->RegisterComponent();
+
+	BatchComponents.Add(Component);
+
+	FBatch& Batch = Batches.AddDefaulted_GetRef();
+	Batch.Mesh = Type.Mesh;
+	Batch.Materials = Type.OverrideMaterials;
+	Batch.Component = Component;
+
+	return Batches.Num() - 1;
+}
+
+void UCollectableSubsystem::ReleaseCollectable(int32 Index)
+{
+	if (!Collectables.IsAllocated(Index))
+	{
+		return;
+	}
+
+	const FCollectable& Collectable = Collectables[Index];
+
+	//-----------------------------------
+	// Hidden until reused, the renderer is
+	// updated once for the whole frame
+	//-----------------------------------
+	FBatch& Batch = Batches[Collectable.Batch];
+
+	if (Batch.Component != nullptr)
+	{
+		FTransform HiddenTransform = Collectable.Transform;
+		HiddenTransform.SetScale3D(FVector::ZeroVector);
+
+		Batch.Component->UpdateInstanceTransform(Collectable.Instance, HiddenTransform, true, false, true);
+		Batch.FreeInstances.Add(Collectable.Instance);
+		Batch.bDirty = true;
+	}
+
+	TArray<int32>* Cell = Cells.Find(Collectable.Cell);
+
+	if (Cell != nullptr)
+	{
+		Cell->RemoveSwap(Index);
+
+		if (Cell->Num() == 0)
+		{
+			Cells.Remove(Collectable.Cell);
+		}
+	}
+
+	CollectableIndices.Remove(Collectable.Id);
+	Collectables.RemoveAt(Index);
+}
+
+FIntVector UCollectableSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / CellSize),
+		FMath::FloorToInt(Location.Y / CellSize),
+		FMath::FloorToInt(Location.Z / CellSize));
+}
+
+void UCollectableSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CollectableUpdate);
+
+	UpdatePickups();
+
+	FlushBatches();
+
+	INC_DWORD_STAT_BY(STAT_Collectables, Collectables.Num());
+	INC_DWORD_STAT_BY(STAT_CollectableBatches, Batches.Num());
+}
+
+void UCollectableSubsystem::UpdatePickups()
+{
+	PickedUp.Reset();
+
+	for (auto It = LastCollectorLocations.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* Controller = It->Get();
+		APawn* Pawn = Controller != nullptr ? Controller->GetPawn() : nullptr;
+
+		if (Pawn == nullptr)
+		{
+			continue;
+		}
+
+		//-----------------------------------
+		// Path since last frame, so that a fast
+		// player collects what it went through
+		//-----------------------------------
+		FVector End = Pawn->GetActorLocation();
+		FVector Start = End;
+		FVector* LastLocation = LastCollectorLocations.Find(Pawn);
+
+		// Went through a portal : only where it is now
+		if (LastLocation != nullptr && FVector::DistSquared(*LastLocation, End) <= FMath::Square(MaxSweepDistance))
+		{
+			Start = *LastLocation;
+		}
+
+		LastCollectorLocations.Add(Pawn, End);
+
+		if (Collectables.Num() == 0)
+		{
+			continue;
+		}
+
+		float CollectorRadius = Pawn->GetSimpleCollisionRadius();
+		FBox QueryBox = FBox(Start.ComponentMin(End), Start.ComponentMax(End)).ExpandBy(CollectorRadius + MaxPickupRadius);
+		FIntVector MinCell = GetCell(QueryBox.Min);
+		FIntVector MaxCell = GetCell(QueryBox.Max);
+
+		for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+				{
+					const TArray<int32>* Cell = Cells.Find(FIntVector(X, Y, Z));
+
+					INC_DWORD_STAT(STAT_CollectableCellsTested);
+
+					if (Cell == nullptr)
+					{
+						continue;
+					}
+
+					for (int32 Index : *Cell)
+					{
+						const FCollectable& Collectable = Collectables[Index];
+						float Distance = FMath::PointDistToSegment(Collectable.Transform.GetLocation(), Start, End);
+
+						// Split-screen : the first player to reach it takes it
+						if (Distance <= Collectable.PickupRadius + CollectorRadius
+							&& !PickedUp.ContainsByPredicate([&Collectable](const TPair<int32, APawn*>& Pair) { return Pair.Key == Collectable.Id; }))
+						{
+							PickedUp.Emplace(Collectable.Id, Pawn);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//-----------------------------------
+	// Collected after the queries, the
+	// callbacks may spawn or remove some
+	//-----------------------------------
+	for (const TPair<int32, APawn*>& Pair : PickedUp)
+	{
+		const int32* Index = CollectableIndices.Find(Pair.Key);
+
+		if (Index == nullptr)
+		{
+			continue;
+		}
+
+		FCollectable Collectable = Collectables[*Index];
+		ReleaseCollectable(*Index);
+
+		INC_DWORD_STAT(STAT_CollectablesCollected);
+
+		// Heard through the portals, or not at all when no player can hear it
+		if (Collectable.CollectSound != nullptr)
+		{
+			UPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPortalSubsystem>();
+
+			if (PortalSubsystem != nullptr)
+			{
+				PortalSubsystem->PlayPortalSoundAtLocation(Collectable.CollectSound, Collectable.Transform.GetLocation());
+			}
+			else
+			{
+				UGameplayStatics::PlaySoundAtLocation(this, Collectable.CollectSound, Collectable.Transform.GetLocation());
+			}
+		}
+
+		OnCollected.Broadcast(Collectable.Id, Collectable.TypeName, Collectable.Transform, Pair.Value);
+	}
+}
+
+void UCollectableSubsystem::FlushBatches()
+{
+	for (FBatch& Batch : Batches)
+	{
+		if (Batch.bDirty && Batch.Component != nullptr)
+		{
+			Batch.Component->MarkRenderStateDirty();
+		}
+
+		Batch.bDirty = false;
+	}
+}
@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineBaseTypes.h"
+#include "WorldSubsystemTickFunction.h"
+#include "CollectableSubsystem.generated.h"
+
+//Forward declaration
+class AActor;
+class APawn;
+class UCollectableSubsystem;
+class UHierarchicalInstancedStaticMeshComponent;
+class UMaterialInterface;
+class USoundBase;
+class UStaticMesh;
+
+// What a collectable looks like and how it is picked up
+USTRUCT(BlueprintType)
+struct EL_API FCollectableType
+{
+    GENERATED_BODY()
+
+    // Reported by OnCollected (book, cup, ...)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collectable")
+        FName Name;
+
+    // Collectables sharing the mesh and materials are drawn by one instanced component
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collectable")
+        UStaticMesh* Mesh = nullptr;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collectable")
+        TArray<UMaterialInterface*> OverrideMaterials;
+
+    // Picked up when a player gets this close (added to the player radius)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collectable")
+        float PickupRadius = 50.0f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Collectable")
+        USoundBase* CollectSound = nullptr;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FCollectableCollectedSignature, int32, CollectableId, FName, TypeName, const FTransform&, Transform, APawn*, Collector);
+
+/**
+ * Owns the collectables of a world instead of one ticking actor each.
+ *
+ * Collectables sharing a mesh are drawn by one hierarchical instanced
+ * static mesh component, and are kept in a uniform hash grid. Once per
+ * frame the path of each player pawn since the last frame is tested
+ * against the cells around it, so a fast player never skips a pickup.
+ *
+ * Collected instances are hidden (zero scale) and kept in a free list,
+ * the next collectable of the same mesh reuses them : the instanced
+ * components never grow, shrink or reorder while playing.
+ *
+ * "stat collectable" shows the update time and the collectable counts.
+ */
+UCLASS()
+class EL_API UCollectableSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    UCollectableSubsystem();
+
+    virtual void Deinitialize() override;
+
+    // Add a collectable, returns its id (never reused)
+    UFUNCTION(BlueprintCallable, Category = "Collectable")
+        int32 SpawnCollectable(const FCollectableType& Type, const FTransform& Transform);
+
+    // Remove a collectable without collecting it
+    UFUNCTION(BlueprintCallable, Category = "Collectable")
+        void RemoveCollectable(int32 CollectableId);
+
+    UFUNCTION(BlueprintPure, Category = "Collectable")
+        bool IsCollectableActive(int32 CollectableId) const;
+
+    UFUNCTION(BlueprintPure, Category = "Collectable")
+        int32 GetNumCollectables() const;
+
+    // Manual Tick, called by the tick function
+    void Tick(float DeltaTime);
+
+    // Called when a player picks up a collectable
+    UPROPERTY(BlueprintAssignable, Category = "Collectable")
+        FCollectableCollectedSignature OnCollected;
+
+    // Larger moves in one frame are teleports (portals), not swept
+    UPROPERTY(BlueprintReadWrite, Category = "Collectable")
+        float MaxSweepDistance;
+
+    // Size of the cells of the pickup grid
+    UPROPERTY(BlueprintReadOnly, Category = "Collectable")
+        float CellSize;
+
+private:
+    struct FCollectable
+    {
+        int32 Id = INDEX_NONE;
+        FName TypeName;
+        FTransform Transform;
+        float PickupRadius = 0.0f;
+        USoundBase* CollectSound = nullptr;
+
+        // Batch and instance drawing it
+        int32 Batch = INDEX_NONE;
+        int32 Instance = INDEX_NONE;
+
+        FIntVector Cell;
+    };
+
+    // Collectables drawn by one instanced component
+    struct FBatch
+    {
+        UStaticMesh* Mesh = nullptr;
+        TArray<UMaterialInterface*> Materials;
+        UHierarchicalInstancedStaticMeshComponent* Component = nullptr;
+
+        // Hidden instances, reused first
+        TArray<int32> FreeInstances;
+
+        // Instance transforms changed this frame
+        bool bDirty = false;
+    };
+
+    int32 FindOrAddBatch(const FCollectableType& Type);
+
+    // Hide the instance and put it back in the pool
+    void ReleaseCollectable(int32 Index);
+
+    FIntVector GetCell(const FVector& Location) const;
+
+    // Test the path of every player pawn against the grid
+    void UpdatePickups();
+
+    // Push the hidden/reused instances to the renderer, once per frame
+    void FlushBatches();
+
+    // After the movement of the pawns
+    TWorldSubsystemTickFunction<UCollectableSubsystem, TG_PostPhysics> TickFunction;
+
+    TSparseArray<FCollectable> Collectables;
+
+    // Id to index in Collectables
+    TMap<int32, int32> CollectableIndices;
+
+    int32 NextCollectableId;
+
+    TArray<FBatch> Batches;
+
+    TMap<FIntVector, TArray<int32>> Cells;
+
+    // Largest pickup radius, widens the queries
+    float MaxPickupRadius;
+
+    // Where each pawn was last frame
+    TMap<TWeakObjectPtr<APawn>, FVector> LastCollectorLocations;
+
+    // Scratch, reused every update (id, collector)
+    TArray<TPair<int32, APawn*>> PickedUp;
+
+    // Holds the instanced components
+    UPROPERTY(transient)
+        AActor* BatchOwner;
+
+    UPROPERTY(transient)
+        TArray<UHierarchicalInstancedStaticMeshComponent*> BatchComponents;
+
+    // Keeps the sounds of spawned collectables loaded
+    UPROPERTY(transient)
+        TArray<USoundBase*> CollectSounds;
+};
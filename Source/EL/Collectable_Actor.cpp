@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Collectable_Actor.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+
+ACollectable_Actor::ACollectable_Actor()
+{
+    PrimaryActorTick.bCanEverTick = false;
+    CollectableId = INDEX_NONE;
+
+    RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootComponent"));
+
+    PreviewComponent = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("PreviewComponent"));
+    PreviewComponent->SetupAttachment(GetRootComponent());
+    PreviewComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+    PreviewComponent->SetGenerateOverlapEvents(false);
+}
+
+void ACollectable_Actor::OnConstruction(const FTransform& Transform)
+{
+    Super::OnConstruction(Transform);
+
+    PreviewComponent->SetStaticMesh(Type.Mesh);
+
+    for (int32 MaterialIndex = 0; MaterialIndex < Type.OverrideMaterials.Num(); MaterialIndex++)
+    {
+        PreviewComponent->SetMaterial(MaterialIndex, Type.OverrideMaterials[MaterialIndex]);
+    }
+}
+
+void ACollectable_Actor::BeginPlay()
+{
+    Super::BeginPlay();
+
+    UCollectableSubsystem* CollectableSubsystem = GetWorld()->GetSubsystem<UCollectableSubsystem>();
+
+    if (CollectableSubsystem == nullptr)
+    {
+        return;
+    }
+
+    CollectableId = CollectableSubsystem->SpawnCollectable(Type, PreviewComponent->GetComponentTransform());
+
+    //Drawn by the instanced component of its mesh from now on
+    if (CollectableId != INDEX_NONE)
+    {
+        PreviewComponent->DestroyComponent();
+        PreviewComponent = nullptr;
+    }
+}
+
+void ACollectable_Actor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    //Level streamed out before it was collected
+    UCollectableSubsystem* CollectableSubsystem = GetWorld()->GetSubsystem<UCollectableSubsystem>();
+
+    if (CollectableSubsystem != nullptr && CollectableId != INDEX_NONE)
+    {
+        CollectableSubsystem->RemoveCollectable(CollectableId);
+    }
+
+    CollectableId = INDEX_NONE;
+
+    Super::EndPlay(EndPlayReason);
+}
+
+int32 ACollectable_Actor::GetCollectableId() const
+{
+    return CollectableId;
+}
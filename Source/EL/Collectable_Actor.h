@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "CollectableSubsystem.h"
+#include "Collectable_Actor.generated.h"
+
+//Forward declaration
+class UStaticMeshComponent;
+
+/**
+ * Collectable placed in a level. Only a placeholder : when play begins
+ * it hands its type and transform to the UCollectableSubsystem, which
+ * draws and picks it up, and it stops rendering. It never ticks.
+ *
+ * The Collectable_* Blueprints are meant to be reparented to this class,
+ * with their mesh, materials and collect sound moved to Type.
+ */
+UCLASS()
+class EL_API ACollectable_Actor : public AActor
+{
+    GENERATED_BODY()
+
+public:
+    ACollectable_Actor();
+
+    virtual void OnConstruction(const FTransform& Transform) override;
+
+protected:
+    virtual void BeginPlay() override;
+
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Collectable")
+        FCollectableType Type;
+
+    // Id in the UCollectableSubsystem, INDEX_NONE before BeginPlay
+    UFUNCTION(BlueprintPure, Category = "Collectable")
+        int32 GetCollectableId() const;
+
+private:
+    // Shows Type in the editor, removed when play begins
+    UPROPERTY(VisibleAnywhere, Category = "Collectable")
+        UStaticMeshComponent* PreviewComponent;
+
+    int32 CollectableId;
+};
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HoverComponent.h"
+#include "HoverSubsystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+
+UHoverComponent::UHoverComponent()
+{
+    PrimaryComponentTick.bCanEverTick = false;
+
+    HoverHeight = 60.0f;
+    TraceExtraLength = 40.0f;
+    TraceChannel = ECC_Visibility;
+    Stiffness = 2000.0f;
+    Damping = 4.0f;
+    bAccelChange = true;
+    bHoverEnabled = true;
+
+    bGroundValid = false;
+    GroundLocation = FVector::ZeroVector;
+    GroundNormal = FVector::UpVector;
+    GroundDistance = 0.0f;
+}
+
+void UHoverComponent::OnRegister()
+{
+    Super::OnRegister();
+
+    UWorld* World = GetWorld();
+    UHoverSubsystem* HoverSubsystem = World != nullptr && World->IsGameWorld() ? World->GetSubsystem<UHoverSubsystem>() : nullptr;
+
+    if (HoverSubsystem != nullptr)
+    {
+        HoverSubsystem->RegisterHover(this);
+    }
+}
+
+void UHoverComponent::OnUnregister()
+{
+    UWorld* World = GetWorld();
+    UHoverSubsystem* HoverSubsystem = World != nullptr ? World->GetSubsystem<UHoverSubsystem>() : nullptr;
+
+    if (HoverSubsystem != nullptr)
+    {
+        HoverSubsystem->UnregisterHover(this);
+    }
+
+    Super::OnUnregister();
+}
+
+UPrimitiveComponent* UHoverComponent::GetHoveredBody() const
+{
+    UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(GetAttachParent());
+
+    if (Body == nullptr && GetOwner() != nullptr)
+    {
+        Body = Cast<UPrimitiveComponent>(GetOwner()->GetRootComponent());
+    }
+
+    return Body;
+}
+
+bool UHoverComponent::IsOnGround() const
+{
+    return bGroundValid && GroundDistance <= HoverHeight + TraceExtraLength;
+}
+
+float UHoverComponent::GetGroundDistance() const
+{
+    return bGroundValid ? GroundDistance : -1.0f;
+}
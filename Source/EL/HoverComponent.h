@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "Engine/EngineTypes.h"
+#include "HoverComponent.generated.h"
+
+//Forward declaration
+class UPrimitiveComponent;
+
+/**
+ * Hover point of a physics object (chair, globe) : pushes the body it is
+ * attached to away from the ground below with a damped spring.
+ *
+ * It does not tick. The UHoverSubsystem traces the ground of every hover
+ * point asynchronously (results used the next frame) and integrates all
+ * the springs in one loop, every frame. Far or off-screen objects trace
+ * less often and keep hovering on the last ground found.
+ */
+UCLASS(ClassGroup = (Physics), meta = (BlueprintSpawnableComponent))
+class EL_API UHoverComponent : public USceneComponent
+{
+    GENERATED_BODY()
+
+public:
+    UHoverComponent();
+
+    // Height kept above the ground, along the down vector of the component
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hover")
+        float HoverHeight;
+
+    // Ground searched that far below the hover height
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hover")
+        float TraceExtraLength;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hover")
+        TEnumAsByte<ECollisionChannel> TraceChannel;
+
+    // Force per unit of compression (0 at the hover height, 1 on the ground)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hover")
+        float Stiffness;
+
+    // Force per cm/s of vertical speed at the hover point
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hover")
+        float Damping;
+
+    // Stiffness and Damping are accelerations (same behaviour whatever the mass)
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hover")
+        bool bAccelChange;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hover")
+        bool bHoverEnabled;
+
+    // Body pushed by the spring : the parent, or the root of the owner
+    UPrimitiveComponent* GetHoveredBody() const;
+
+    // Ground below the hover point, from the last completed trace
+    UFUNCTION(BlueprintPure, Category = "Hover")
+        bool IsOnGround() const;
+
+    UFUNCTION(BlueprintPure, Category = "Hover")
+        float GetGroundDistance() const;
+
+protected:
+    virtual void OnRegister() override;
+    virtual void OnUnregister() override;
+
+private:
+    friend class UHoverSubsystem;
+
+    // Kept by the subsystem
+    bool bGroundValid;
+    FVector GroundLocation;
+    FVector GroundNormal;
+    float GroundDistance;
+};
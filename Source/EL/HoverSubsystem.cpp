@@ -0,0 +1,224 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HoverSubsystem.h"
+#include "HoverComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "GameFramework/PlayerController.h"
+
+// "stat hover"
+DECLARE_STATS_GROUP(TEXT("Hover"), STATGROUP_Hover, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT(TEXT("Update"), STAT_HoverUpdate, STATGROUP_Hover);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hover Points"), STAT_HoverPoints, STATGROUP_Hover);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Traces Requested"), STAT_HoverTraces, STATGROUP_Hover);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Forces Applied"), STAT_HoverForces, STATGROUP_Hover);
+
+UHoverSubsystem::UHoverSubsystem()
+{
+	ReducedRateDistance = 3000.0f;
+	ReducedTraceInterval = 6;
+	OffScreenTime = 0.25f;
+}
+
+void UHoverSubsystem::Deinitialize()
+{
+	TickFunction.Unregister();
+
+	Hovers.Empty();
+
+	Super::Deinitialize();
+}
+
+void UHoverSubsystem::RegisterHover(UHoverComponent* Hover)
+{
+	bool bRegistered = Hovers.ContainsByPredicate([Hover](const FHover& Registered)
+	{
+		return Registered.Component == Hover;
+	});
+
+	if (Hover != nullptr && !bRegistered)
+	{
+		FHover& Registered = Hovers.AddDefaulted_GetRef();
+		Registered.Component = Hover;
+
+		// Only tick worlds that have hover points
+		TickFunction.Register(this);
+	}
+}
+
+void UHoverSubsystem::UnregisterHover(UHoverComponent* Hover)
+{
+	int32 Index = Hovers.IndexOfByPredicate([Hover](const FHover& Registered)
+	{
+		return Registered.Component == Hover;
+	});
+
+	if (Index != INDEX_NONE)
+	{
+		Hovers.RemoveAtSwap(Index);
+	}
+}
+
+void UHoverSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_HoverUpdate);
+
+	ViewLocations.Reset();
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* Controller = It->Get();
+
+		if (Controller != nullptr && Controller->IsLocalController())
+		{
+			FVector Location;
+			FRotator Rotation;
+			Controller->GetPlayerViewPoint(Location, Rotation);
+			ViewLocations.Add(Location);
+		}
+	}
+
+	ReadTraces();
+
+	UpdateHovers(DeltaTime);
+
+	INC_DWORD_STAT_BY(STAT_HoverPoints, Hovers.Num());
+}
+
+void UHoverSubsystem::ReadTraces()
+{
+	UWorld* World = GetWorld();
+
+	for (FHover& Hover : Hovers)
+	{
+		if (!Hover.PendingTrace.IsValid())
+		{
+			continue;
+		}
+
+		FTraceDatum TraceData;
+
+		// Not done yet : read next frame
+		if (!World->QueryTraceData(Hover.PendingTrace, TraceData))
+		{
+			// Results of too old frames are gone
+			if (!World->IsTraceHandleValid(Hover.PendingTrace, false))
+			{
+				Hover.PendingTrace = FTraceHandle();
+			}
+
+			continue;
+		}
+
+		Hover.PendingTrace = FTraceHandle();
+
+		UHoverComponent* Component = Hover.Component.Get();
+
+		if (Component == nullptr)
+		{
+			continue;
+		}
+
+		const FHitResult* Hit = TraceData.OutHits.FindByPredicate([](const FHitResult& Result)
+		{
+			return Result.bBlockingHit;
+		});
+
+		Component->bGroundValid = Hit != nullptr;
+
+		if (Hit != nullptr)
+		{
+			Component->GroundLocation = Hit->ImpactPoint;
+			Component->GroundNormal = Hit->ImpactNormal;
+		}
+	}
+}
+
+void UHoverSubsystem::UpdateHovers(float DeltaTime)
+{
+	for (int32 Index = Hovers.Num() - 1; Index >= 0; Index--)
+	{
+		FHover& Hover = Hovers[Index];
+		UHoverComponent* Component = Hover.Component.Get();
+
+		if (Component == nullptr)
+		{
+			Hovers.RemoveAtSwap(Index);
+			continue;
+		}
+
+		UPrimitiveComponent* Body = Component->GetHoveredBody();
+
+		// At rest bodies stay asleep until something wakes them
+		if (!Component->bHoverEnabled || Body == nullptr || !Body->IsSimulatingPhysics() || !Body->RigidBodyIsAwake())
+		{
+			continue;
+		}
+
+		FVector Location = Component->GetComponentLocation();
+		FVector Up = Component->GetUpVector();
+
+		//-----------------------------------
+		// Spring against the ground plane of the last
+		// trace, every frame whatever the trace rate
+		//-----------------------------------
+		if (Component->bGroundValid)
+		{
+			float UpAlongNormal = FMath::Max(FVector::DotProduct(Up, Component->GroundNormal), 0.1f);
+			float Distance = FVector::DotProduct(Location - Component->GroundLocation, Component->GroundNormal) / UpAlongNormal;
+			Component->GroundDistance = Distance;
+
+			if (Distance < Component->HoverHeight && Component->HoverHeight > KINDA_SMALL_NUMBER)
+			{
+				float Compression = FMath::Clamp(1.0f - Distance / Component->HoverHeight, 0.0f, 1.0f);
+				float Speed = FVector::DotProduct(Body->GetPhysicsLinearVelocityAtPoint(Location), Up);
+				float Strength = Component->Stiffness * Compression - Component->Damping * Speed;
+
+				if (Component->bAccelChange)
+				{
+					Strength *= Body->GetMass();
+				}
+
+				Body->AddForceAtLocation(Up * Strength, Location);
+
+				INC_DWORD_STAT(STAT_HoverForces);
+			}
+		}
+
+		//-----------------------------------
+		// Next ground trace, less often when no
+		// player can see the difference
+		//-----------------------------------
+		if (Hover.PendingTrace.IsValid() || GFrameCounter < Hover.NextTraceFrame)
+		{
+			continue;
+		}
+
+		float ClosestDistanceSquared = MAX_flt;
+
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, FVector::DistSquared(ViewLocation, Location));
+		}
+
+		bool bReducedRate = ClosestDistanceSquared > FMath::Square(ReducedRateDistance) || !Body->WasRecentlyRendered(OffScreenTime);
+
+		Hover.NextTraceFrame = GFrameCounter + (bReducedRate ? FMath::Max(ReducedTraceInterval, 1) : 1);
+
+		RequestTrace(Hover, Component);
+	}
+}
+
+void UHoverSubsystem::RequestTrace(FHover& Hover, UHoverComponent* Component)
+{
+	FVector Start = Component->GetComponentLocation();
+	FVector End = Start - Component->GetUpVector() * (Component->HoverHeight + Component->TraceExtraLength);
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(HoverTrace), false, Component->GetOwner());
+
+	Hover.PendingTrace = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, End, Component->TraceChannel, Params);
+
+	INC_DWORD_STAT(STAT_HoverTraces);
+}
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineBaseTypes.h"
+#include "WorldSubsystemTickFunction.h"
+#include "WorldCollision.h"
+#include "HoverSubsystem.generated.h"
+
+//Forward declaration
+class UHoverComponent;
+class UHoverSubsystem;
+
+/**
+ * Drives every UHoverComponent of a world in one pass per frame.
+ *
+ * The ground traces are asynchronous : the ones issued this frame are
+ * read the next one, and the springs use the last ground found (as a
+ * plane) in between, so the force is applied every frame whatever the
+ * trace rate. Hover points far from every player camera, or on objects
+ * not rendered lately, trace every ReducedTraceInterval frames only.
+ *
+ * "stat hover" shows the update time and the trace counts.
+ */
+UCLASS()
+class EL_API UHoverSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    UHoverSubsystem();
+
+    virtual void Deinitialize() override;
+
+    // Called by the hover components when registered/unregistered
+    void RegisterHover(UHoverComponent* Hover);
+    void UnregisterHover(UHoverComponent* Hover);
+
+    // Manual Tick, called by the tick function
+    void Tick(float DeltaTime);
+
+    // Further than this from every player camera : reduced trace rate
+    UPROPERTY(BlueprintReadWrite, Category = "Hover")
+        float ReducedRateDistance;
+
+    // Frames between two traces at the reduced rate
+    UPROPERTY(BlueprintReadWrite, Category = "Hover")
+        int32 ReducedTraceInterval;
+
+    // Not rendered for that long : off-screen
+    UPROPERTY(BlueprintReadWrite, Category = "Hover")
+        float OffScreenTime;
+
+private:
+    struct FHover
+    {
+        TWeakObjectPtr<UHoverComponent> Component;
+
+        // Trace issued last frame, read this frame
+        FTraceHandle PendingTrace;
+
+        uint64 NextTraceFrame = 0;
+    };
+
+    // Ground of the traces issued last frame
+    void ReadTraces();
+
+    // Spring forces, then the traces of the hover points due
+    void UpdateHovers(float DeltaTime);
+
+    void RequestTrace(FHover& Hover, UHoverComponent* Component);
+
+    // Forces added before the simulation of the frame
+    TWorldSubsystemTickFunction<UHoverSubsystem, TG_PrePhysics> TickFunction;
+
+    TArray<FHover> Hovers;
+
+    // Player cameras of this frame
+    TArray<FVector> ViewLocations;
+};
@@ -1,15 +1,16 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "Player_Character.h"
+#include "PortalCharacterMovement.h"
 #include "Animation/AnimInstance.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
 #include "GameFramework/InputSettings.h"
 #include "Kismet/GameplayStatics.h"
-#include "Player_Controller.h"
 
-APlayer_Character::APlayer_Character()
+APlayer_Character::APlayer_Character(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UPortalCharacterMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(55.f, 96.0f);
@@ -108,18 +109,3 @@ void APlayer_Character::LookUpAtRate(float Rate)
 	// calculate delta for this frame from the rate information
 	AddControllerPitchInput(Rate * BaseLookUpRate * GetWorld()->GetDeltaSeconds());
 }
-
-void APlayer_Character::TickActor(float DeltaTime, enum ELevelTick TickType, FActorTickFunction& ThisTickFunction)
-{
-	Super::TickActor(DeltaTime, TickType, ThisTickFunction);
-
-	if (UGameplayStatics::GetPlayerController(GetWorld(), 0) != nullptr)
-	{
-		APlayer_Controller* EPC = Cast<APlayer_Controller>(UGameplayStatics::GetPlayerController(GetWorld(), 0));
-		if (EPC != nullptr) {
-			if (EPC->PortalManager != NULL) {
-				EPC->PortalManager->Update(DeltaTime);
-			}
-		}
-	}
-}
\ No newline at end of file
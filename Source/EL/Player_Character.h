@@ -30,14 +30,13 @@ class EL_API APlayer_Character : public ACharacter
 
 public:
 	// Sets default values for this character's properties
-	APlayer_Character();
+	// (the movement predicts the portal teleports in networked games)
+	APlayer_Character(const FObjectInitializer& ObjectInitializer);
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-	virtual void TickActor(float DeltaTime, enum ELevelTick TickType, FActorTickFunction& ThisTickFunction) override;
-
 public:
 
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
@@ -2,14 +2,23 @@
 
 
 #include "Player_Controller.h"
+#include "Engine/Engine.h"
 
 void APlayer_Controller::BeginPlay()
 {
 	Super::BeginPlay();
 
+    PortalManager = nullptr;
+
+    // Only the players of this machine see the portals, the
+    // controllers of remote players on a listen server get none
+    if (!IsLocalController())
+    {
+        return;
+    }
+
     FActorSpawnParameters SpawnParams;
 
-    PortalManager = nullptr;
     PortalManager = GetWorld()->SpawnActor<APortalManager>(APortalManager::StaticClass(),
         FVector::ZeroVector,
         FRotator::ZeroRotator,
@@ -19,7 +28,7 @@ void APlayer_Controller::BeginPlay()
     PortalManager->Init();
 }
 
-FMatrix APlayer_Controller::GetCameraProjectionMatrix()
+FMatrix APlayer_Controller::GetCameraProjectionMatrix(EStereoscopicPass StereoPass)
 {
     FMatrix ProjectionMatrix;
 
@@ -28,7 +37,7 @@ FMatrix APlayer_Controller::GetCameraProjectionMatrix()
         FSceneViewProjectionData PlayerProjectionData;
 
         GetLocalPlayer()->GetProjectionData(GetLocalPlayer()->ViewportClient->Viewport,
-            EStereoscopicPass::eSSP_FULL,
+            StereoPass,
             PlayerProjectionData);
 
         ProjectionMatrix = PlayerProjectionData.ProjectionMatrix;
@@ -37,6 +46,46 @@ FMatrix APlayer_Controller::GetCameraProjectionMatrix()
     return ProjectionMatrix;
 }
 
+bool APlayer_Controller::GetCameraProjectionData(FSceneViewProjectionData& OutProjectionData, EStereoscopicPass StereoPass)
+{
+    if (GetLocalPlayer() == nullptr || GetLocalPlayer()->ViewportClient == nullptr)
+    {
+        return false;
+    }
+
+    return GetLocalPlayer()->GetProjectionData(GetLocalPlayer()->ViewportClient->Viewport,
+        StereoPass,
+        OutProjectionData);
+}
+
+bool APlayer_Controller::IsStereoRendering() const
+{
+    ULocalPlayer* LocalPlayer = GetLocalPlayer();
+
+    return GEngine != nullptr
+        && LocalPlayer != nullptr
+        && LocalPlayer->ViewportClient != nullptr
+        && GEngine->IsStereoscopic3D(LocalPlayer->ViewportClient->Viewport);
+}
+
+void APlayer_Controller::UpdateHiddenComponents(const FVector& ViewLocation, TSet<FPrimitiveComponentId>& HiddenComponents)
+{
+    Super::UpdateHiddenComponents(ViewLocation, HiddenComponents);
+
+    if (PortalManager == nullptr)
+    {
+        return;
+    }
+
+    for (const TWeakObjectPtr<UPrimitiveComponent>& Display : PortalManager->GetHiddenPortalDisplays())
+    {
+        if (Display.IsValid())
+        {
+            HiddenComponents.Add(Display->ComponentId);
+        }
+    }
+}
+
 APortalManager* APlayer_Controller::GetPortalManager()
 {
     return PortalManager;
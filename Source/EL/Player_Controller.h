@@ -4,10 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/PlayerController.h"
+#include "StereoRendering.h"
 #include "PortalManager.h"
 #include "Portal_Actor.h"
 #include "Player_Controller.generated.h"
 
+struct FSceneViewProjectionData;
+
 /**
  * 
  */
@@ -23,7 +26,17 @@ protected:
 public:
 	APortalManager* PortalManager;
 	
-	FMatrix GetCameraProjectionMatrix();
+	FMatrix GetCameraProjectionMatrix(EStereoscopicPass StereoPass = eSSP_FULL);
+
+	// View and projection of the player camera, false if there is no LocalPlayer
+	// (StereoPass selects an eye when IsStereoRendering())
+	bool GetCameraProjectionData(FSceneViewProjectionData& OutProjectionData, EStereoscopicPass StereoPass = eSSP_FULL);
+
+	// The viewport is rendered for a HMD (or -emulatestereo)
+	bool IsStereoRendering() const;
+
+	// Hide the portal displays of the other split-screen players
+	virtual void UpdateHiddenComponents(const FVector& ViewLocation, TSet<FPrimitiveComponentId>& HiddenComponents) override;
 
 	APortalManager* GetPortalManager();
 
@@ -0,0 +1,360 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalAudio.h"
+#include "PortalRegistry.h"
+#include "Portal_Actor.h"
+#include "Components/AudioComponent.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "Sound/SoundAttenuation.h"
+#include "Sound/SoundBase.h"
+
+FPortalAudio::FPortalAudio()
+{
+	NumVirtual = 0;
+	NumCulled = 0;
+}
+
+FPortalAudio::~FPortalAudio()
+{
+}
+
+void FPortalAudio::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	for (FEmitter& Emitter : Emitters)
+	{
+		Collector.AddReferencedObject(Emitter.Virtual);
+	}
+
+	Collector.AddReferencedObjects(FreeVirtuals);
+}
+
+FString FPortalAudio::GetReferencerName() const
+{
+	return TEXT("FPortalAudio");
+}
+
+void FPortalAudio::TrackEmitter(UAudioComponent* Emitter)
+{
+	if (Emitter == nullptr)
+	{
+		return;
+	}
+
+	bool bTracked = Emitters.ContainsByPredicate([Emitter](const FEmitter& Tracked)
+	{
+		return Tracked.Source == Emitter;
+	});
+
+	if (!bTracked)
+	{
+		FEmitter& Tracked = Emitters.AddDefaulted_GetRef();
+		Tracked.Source = Emitter;
+	}
+}
+
+void FPortalAudio::UntrackEmitter(UAudioComponent* Emitter)
+{
+	int32 Index = Emitters.IndexOfByPredicate([Emitter](const FEmitter& Tracked)
+	{
+		return Tracked.Source == Emitter;
+	});
+
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	FEmitter& Tracked = Emitters[Index];
+	ReleaseVirtual(Tracked);
+
+	// Give it back the way we found it
+	if (Tracked.bCulled && Emitter != nullptr)
+	{
+		Emitter->Play();
+	}
+
+	Emitters.RemoveAtSwap(Index);
+}
+
+void FPortalAudio::Update(UWorld* World, const FPortalRegistry& Registry, TArrayView<const FPortalAudioListener> Listeners, const FPortalAudioSettings& Settings)
+{
+	NumVirtual = 0;
+	NumCulled = 0;
+
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	for (int32 Index = Emitters.Num() - 1; Index >= 0; Index--)
+	{
+		FEmitter& Emitter = Emitters[Index];
+		UAudioComponent* Source = Emitter.Source.Get();
+
+		if (Source == nullptr)
+		{
+			ReleaseVirtual(Emitter);
+			Emitters.RemoveAtSwap(Index);
+			continue;
+		}
+
+		bool bPlaying = Source->IsPlaying() || Emitter.bCulled;
+		const FSoundAttenuationSettings* Attenuation = Source->GetAttenuationSettingsToApply();
+
+		// Not spatialized : heard the same everywhere
+		if (Source->Sound == nullptr || Attenuation == nullptr || !bPlaying || Listeners.Num() == 0)
+		{
+			ReleaseVirtual(Emitter);
+
+			if (Emitter.bCulled)
+			{
+				Emitter.bCulled = false;
+				Source->Play();
+			}
+
+			continue;
+		}
+
+		FVector Location = Source->GetComponentLocation();
+		bool bDirect = IsDirectlyAudible(Location, Attenuation, Listeners);
+
+		FPortalPath Path;
+		bool bThroughPortal = FindPortalPath(Registry, Listeners, Settings, Location, Attenuation, Path);
+
+		//-----------------------------------
+		// Virtual emitter at the mirrored location,
+		// follows the source every frame
+		//-----------------------------------
+		if (bThroughPortal)
+		{
+			if (Emitter.Virtual == nullptr)
+			{
+				Emitter.Virtual = AcquireVirtual(World, Source);
+			}
+
+			if (Emitter.Virtual != nullptr)
+			{
+				Emitter.Portal = Path.Portal;
+				Emitter.Virtual->SetWorldLocation(Path.VirtualLocation);
+				Emitter.Virtual->SetVolumeMultiplier(Source->VolumeMultiplier * Path.Gain);
+
+				if (!Emitter.Virtual->IsPlaying())
+				{
+					Emitter.Virtual->Play();
+				}
+
+				NumVirtual++;
+			}
+		}
+		else
+		{
+			ReleaseVirtual(Emitter);
+		}
+
+		//-----------------------------------
+		// Inaudible loops give their voice back,
+		// one-shots end by themselves. Stopping an
+		// auto destroyed component would destroy it
+		//-----------------------------------
+		bool bInaudible = !bDirect && !bThroughPortal;
+
+		if (Settings.bCullInaudible && bInaudible && Source->Sound->IsLooping() && !Source->bAutoDestroy)
+		{
+			if (!Emitter.bCulled)
+			{
+				Emitter.bCulled = true;
+				Source->Stop();
+			}
+
+			NumCulled++;
+		}
+		else if (Emitter.bCulled)
+		{
+			Emitter.bCulled = false;
+			Source->Play();
+		}
+	}
+}
+
+bool FPortalAudio::PlaySoundAtLocation(UWorld* World, const FPortalRegistry& Registry, TArrayView<const FPortalAudioListener> Listeners, const FPortalAudioSettings& Settings, USoundBase* Sound, const FVector& Location, float VolumeMultiplier)
+{
+	if (World == nullptr || Sound == nullptr)
+	{
+		return false;
+	}
+
+	const FSoundAttenuationSettings* Attenuation = Sound->GetAttenuationSettingsToApply();
+
+	if (Attenuation == nullptr || Listeners.Num() == 0)
+	{
+		UGameplayStatics::PlaySoundAtLocation(World, Sound, Location, VolumeMultiplier);
+		return true;
+	}
+
+	bool bDirect = IsDirectlyAudible(Location, Attenuation, Listeners);
+
+	FPortalPath Path;
+	bool bThroughPortal = FindPortalPath(Registry, Listeners, Settings, Location, Attenuation, Path);
+
+	if (bDirect || !Settings.bCullInaudible)
+	{
+		UGameplayStatics::PlaySoundAtLocation(World, Sound, Location, VolumeMultiplier);
+	}
+
+	if (bThroughPortal)
+	{
+		UGameplayStatics::PlaySoundAtLocation(World, Sound, Path.VirtualLocation, VolumeMultiplier * Path.Gain);
+	}
+
+	return bDirect || bThroughPortal || !Settings.bCullInaudible;
+}
+
+bool FPortalAudio::IsDirectlyAudible(const FVector& Location, const FSoundAttenuationSettings* Attenuation, TArrayView<const FPortalAudioListener> Listeners)
+{
+	float MaxDistanceSquared = FMath::Square(Attenuation->GetMaxDimension());
+
+	return Listeners.ContainsByPredicate([&Location, MaxDistanceSquared](const FPortalAudioListener& Listener)
+	{
+		return FVector::DistSquared(Listener.Location, Location) <= MaxDistanceSquared;
+	});
+}
+
+bool FPortalAudio::FindPortalPath(const FPortalRegistry& Registry, TArrayView<const FPortalAudioListener> Listeners, const FPortalAudioSettings& Settings, const FVector& Location, const FSoundAttenuationSettings* Attenuation, FPortalPath& OutPath)
+{
+	OutPath = FPortalPath();
+
+	float MaxDistanceSquared = FMath::Square(Attenuation->GetMaxDimension());
+
+	for (const FPortalAudioListener& Listener : Listeners)
+	{
+		NearbyPortals.Reset();
+		Registry.QuerySphere(Listener.Location, Settings.PortalDistance, NearbyPortals);
+
+		for (APortal_Actor* Portal : NearbyPortals)
+		{
+			if (Portal->GetTarget() == nullptr)
+			{
+				continue;
+			}
+
+			FVector PortalLocation = Portal->GetActorLocation();
+			FVector Normal = Portal->GetActorForwardVector();
+			FVector ToListener = Listener.Location - PortalLocation;
+			float ListenerSide = FVector::DotProduct(ToListener, Normal);
+
+			// Listener in front of the opening
+			if (ListenerSide <= 0.0f)
+			{
+				continue;
+			}
+
+			//-----------------------------------
+			// Target side brought back behind the opening,
+			// where the capture shows it to the listener
+			// (same transform as the capture view)
+			//-----------------------------------
+			FVector VirtualLocation = Portal->GetViewLinkMatrix().InverseTransformPosition(Location);
+
+			if (FVector::DotProduct(VirtualLocation - PortalLocation, Normal) >= 0.0f
+				|| FVector::DistSquared(Listener.Location, VirtualLocation) > MaxDistanceSquared)
+			{
+				continue;
+			}
+
+			// Quieter from the side and far from the opening
+			float Distance = ToListener.Size();
+			float AngleGain = FMath::Lerp(Settings.MinAngleGain, 1.0f, ListenerSide / FMath::Max(Distance, KINDA_SMALL_NUMBER));
+			float DistanceGain = 1.0f - FMath::Square(FMath::Clamp(Distance / FMath::Max(Settings.PortalDistance, 1.0f), 0.0f, 1.0f));
+			float Gain = AngleGain * DistanceGain;
+
+			if (Gain > OutPath.Gain)
+			{
+				OutPath.Portal = Portal;
+				OutPath.VirtualLocation = VirtualLocation;
+				OutPath.Gain = Gain;
+			}
+		}
+	}
+
+	return OutPath.Portal != nullptr && OutPath.Gain > KINDA_SMALL_NUMBER;
+}
+
+UAudioComponent* FPortalAudio::AcquireVirtual(UWorld* World, UAudioComponent* Source)
+{
+	UAudioComponent* Virtual = nullptr;
+
+	while (Virtual == nullptr && FreeVirtuals.Num() > 0)
+	{
+		Virtual = FreeVirtuals.Pop(false);
+
+		if (Virtual != nullptr && Virtual->IsPendingKill())
+		{
+			Virtual = nullptr;
+		}
+	}
+
+	if (Virtual == nullptr)
+	{
+		Virtual = NewObject<UAudioComponent>(World);
+		Virtual->bAutoActivate = false;
+		Virtual->bAutoDestroy = false;
+		Virtual->RegisterComponentWithWorld(World);
+	}
+
+	// Sounds the same, only the location and the volume change
+	Virtual->SetSound(Source->Sound);
+	Virtual->AttenuationSettings = Source->AttenuationSettings;
+	Virtual->bOverrideAttenuation = Source->bOverrideAttenuation;
+	Virtual->AttenuationOverrides = Source->AttenuationOverrides;
+	Virtual->SoundClassOverride = Source->SoundClassOverride;
+	Virtual->PitchMultiplier = Source->PitchMultiplier;
+
+	return Virtual;
+}
+
+void FPortalAudio::ReleaseVirtual(FEmitter& Emitter)
+{
+	if (Emitter.Virtual != nullptr && !Emitter.Virtual->IsPendingKill())
+	{
+		Emitter.Virtual->Stop();
+		FreeVirtuals.Add(Emitter.Virtual);
+	}
+
+	Emitter.Virtual = nullptr;
+	Emitter.Portal = nullptr;
+}
+
+void FPortalAudio::RemovePortal(APortal_Actor* Portal)
+{
+	for (FEmitter& Emitter : Emitters)
+	{
+		if (Emitter.Portal == Portal)
+		{
+			ReleaseVirtual(Emitter);
+		}
+	}
+}
+
+void FPortalAudio::Reset()
+{
+	for (FEmitter& Emitter : Emitters)
+	{
+		ReleaseVirtual(Emitter);
+	}
+
+	Emitters.Empty();
+	FreeVirtuals.Empty();
+	NumVirtual = 0;
+	NumCulled = 0;
+}
+
+int32 FPortalAudio::NumVirtualEmitters() const
+{
+	return NumVirtual;
+}
+
+int32 FPortalAudio::NumCulledEmitters() const
+{
+	return NumCulled;
+}
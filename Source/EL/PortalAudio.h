@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+
+//Forward declaration
+class APortal_Actor;
+class FPortalRegistry;
+class UAudioComponent;
+class USoundBase;
+class UWorld;
+struct FSoundAttenuationSettings;
+
+// Where a player hears from
+struct FPortalAudioListener
+{
+    FVector Location;
+};
+
+struct FPortalAudioSettings
+{
+    // Portals further than this from the listeners carry no sound
+    float PortalDistance = 3000.0f;
+
+    // Gain when the listener looks at the portal from the side (1 when facing it)
+    float MinAngleGain = 0.25f;
+
+    // Stop the looping emitters that no listener can hear, directly or through a portal.
+    // They restart from the beginning once heard again. Auto destroyed components
+    // (SpawnSoundAttached, SpawnSoundAtLocation) are never culled.
+    bool bCullInaudible = true;
+};
+
+/**
+ * Makes the sounds on the target side of a portal heard through it.
+ *
+ * For an emitter in front of the target of a portal (what its capture
+ * shows) a virtual emitter plays the same sound behind the portal, at
+ * the location given by the inverse of the view link of the captures,
+ * attenuated by the distance and the angle of the listener to the portal.
+ * The sound attenuation then applies to the distance through the opening.
+ *
+ * Tracked looping emitters that are neither directly audible nor audible
+ * through a portal are stopped, and restarted once they are, so that
+ * they do not hold a voice. One-shots go through PlaySoundAtLocation().
+ */
+class EL_API FPortalAudio : public FGCObject
+{
+public:
+    FPortalAudio();
+    virtual ~FPortalAudio();
+
+    //FGCObject, keeps the virtual emitters
+    virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+    virtual FString GetReferencerName() const override;
+
+    void TrackEmitter(UAudioComponent* Emitter);
+    void UntrackEmitter(UAudioComponent* Emitter);
+
+    // Place the virtual emitters and cull the tracked emitters
+    void Update(UWorld* World, const FPortalRegistry& Registry, TArrayView<const FPortalAudioListener> Listeners, const FPortalAudioSettings& Settings);
+
+    // Play a one-shot where it is heard from : in place, through the
+    // best portal, both or not at all. Returns false when culled.
+    bool PlaySoundAtLocation(UWorld* World, const FPortalRegistry& Registry, TArrayView<const FPortalAudioListener> Listeners, const FPortalAudioSettings& Settings, USoundBase* Sound, const FVector& Location, float VolumeMultiplier);
+
+    // Move the virtual emitters heard through the portal back to their pool
+    void RemovePortal(APortal_Actor* Portal);
+
+    // Stop and forget everything (the world is going away)
+    void Reset();
+
+    // Virtual emitters playing / tracked emitters stopped
+    int32 NumVirtualEmitters() const;
+    int32 NumCulledEmitters() const;
+
+private:
+    struct FEmitter
+    {
+        TWeakObjectPtr<UAudioComponent> Source;
+
+        // Playing the source at its mirrored location, if any
+        UAudioComponent* Virtual = nullptr;
+        APortal_Actor* Portal = nullptr;
+
+        // Stopped by us, played again once audible
+        bool bCulled = false;
+    };
+
+    // Path through a portal from a listener to a sound
+    struct FPortalPath
+    {
+        APortal_Actor* Portal = nullptr;
+        FVector VirtualLocation = FVector::ZeroVector;
+        float Gain = 0.0f;
+    };
+
+    // Heard in place by at least one listener
+    static bool IsDirectlyAudible(const FVector& Location, const FSoundAttenuationSettings* Attenuation, TArrayView<const FPortalAudioListener> Listeners);
+
+    // Loudest path through the portals around the listeners, false if none
+    bool FindPortalPath(const FPortalRegistry& Registry, TArrayView<const FPortalAudioListener> Listeners, const FPortalAudioSettings& Settings, const FVector& Location, const FSoundAttenuationSettings* Attenuation, FPortalPath& OutPath);
+
+    UAudioComponent* AcquireVirtual(UWorld* World, UAudioComponent* Source);
+    void ReleaseVirtual(FEmitter& Emitter);
+
+    TArray<FEmitter> Emitters;
+
+    // Stopped virtual emitters, reused
+    TArray<UAudioComponent*> FreeVirtuals;
+
+    int32 NumVirtual;
+    int32 NumCulled;
+
+    // Scratch, reused every query
+    TArray<APortal_Actor*> NearbyPortals;
+};
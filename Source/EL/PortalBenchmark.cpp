@@ -0,0 +1,504 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalBenchmark.h"
+#include "PortalRegistry.h"
+#include "PortalCrossing.h"
+#include "PortalSubsystem.h"
+#include "Portal_Actor.h"
+#include "PortalMath.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Controller.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/DateTime.h"
+#include "Math/RandomStream.h"
+#include "RenderCore.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+static TAutoConsoleVariable<float> CVarPortalBenchmarkSpeed(
+	TEXT("portal.Benchmark.Speed"),
+	600.0f,
+	TEXT("Speed of the benchmark fly-through, in units per second."));
+
+static TAutoConsoleVariable<float> CVarPortalBenchmarkRunUp(
+	TEXT("portal.Benchmark.RunUp"),
+	600.0f,
+	TEXT("Distance in front of each portal where the fly-through starts."));
+
+static TAutoConsoleVariable<int32> CVarPortalBenchmarkWarmupFrames(
+	TEXT("portal.Benchmark.WarmupFrames"),
+	30,
+	TEXT("Frames ignored at the start (shader compilation, render target creation...)."));
+
+static TAutoConsoleVariable<float> CVarPortalBenchmarkMaxAvgGameThreadMs(
+	TEXT("portal.Benchmark.MaxAvgGameThreadMs"),
+	16.6f,
+	TEXT("The benchmark fails when the average game thread time is above this."));
+
+static TAutoConsoleVariable<float> CVarPortalBenchmarkMaxAvgPortalMs(
+	TEXT("portal.Benchmark.MaxAvgPortalMs"),
+	2.0f,
+	TEXT("The benchmark fails when the average portal system time is above this."));
+
+static TAutoConsoleVariable<float> CVarPortalBenchmarkMaxPeakPortalMs(
+	TEXT("portal.Benchmark.MaxPeakPortalMs"),
+	8.0f,
+	TEXT("The benchmark fails when one frame spends more than this in the portal system."));
+
+static FAutoConsoleCommandWithWorld PortalBenchmarkCommand(
+	TEXT("Portal.Benchmark"),
+	TEXT("Fly the player through every portal of the level and record the portal timings to Saved/Profiling/PortalBenchmark."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		UPortalSubsystem* PortalSubsystem = World != nullptr ? World->GetSubsystem<UPortalSubsystem>() : nullptr;
+
+		if (PortalSubsystem != nullptr)
+		{
+			PortalSubsystem->StartBenchmark(false);
+		}
+	}));
+
+//-----------------------------------
+// Math microbenchmarks (the checks are the
+// EL.Portal.Math automation tests)
+//-----------------------------------
+
+// Runs Function Iterations times, returns the time per element in ns
+template<typename FunctionType>
+static double MeasureNsPerElement(int32 Iterations, int32 Count, FunctionType Function)
+{
+	double StartTime = FPlatformTime::Seconds();
+
+	for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+	{
+		Function();
+	}
+
+	double Elapsed = FPlatformTime::Seconds() - StartTime;
+
+	return Elapsed * 1e9 / (double(Iterations) * FMath::Max(Count, 1));
+}
+
+static void RunPortalMathBenchmark(const TArray<FString>& Args)
+{
+	int32 Count = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 4099;
+	int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 200;
+
+	FRandomStream Random(0x1234);
+
+	FVector SourceLocation = FVector(100.0f, -200.0f, 50.0f);
+	FQuat SourceRotation = FRotator(0.0f, 30.0f, 0.0f).Quaternion();
+	FVector Normal = SourceRotation.GetForwardVector();
+	FMatrix LinkMatrix = FPortalMath::MakeLinkMatrix(SourceLocation, SourceRotation, FVector(-3000.0f, 750.0f, 400.0f), FRotator(10.0f, -120.0f, 5.0f).Quaternion(), false);
+
+	//-----------------------------------
+	// Arrays : random points
+	//-----------------------------------
+	TArray<float> X, Y, Z;
+	X.SetNumUninitialized(Count);
+	Y.SetNumUninitialized(Count);
+	Z.SetNumUninitialized(Count);
+
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		X[Index] = Random.FRandRange(-1000.0f, 1000.0f);
+		Y[Index] = Random.FRandRange(-1000.0f, 1000.0f);
+		Z[Index] = Random.FRandRange(-1000.0f, 1000.0f);
+	}
+
+	// In front
+	TArray<bool> InFront, InFrontScalar;
+	InFront.SetNumZeroed(Count);
+	InFrontScalar.SetNumZeroed(Count);
+
+	double InFrontNs = MeasureNsPerElement(Iterations, Count, [&]()
+	{
+		FPortalMath::PointsInFrontOfPlane(X.GetData(), Y.GetData(), Z.GetData(), Count, SourceLocation, Normal, InFront.GetData());
+	});
+
+	double InFrontScalarNs = MeasureNsPerElement(Iterations, Count, [&]()
+	{
+		FPortalMath::PointsInFrontOfPlaneScalar(X.GetData(), Y.GetData(), Z.GetData(), Count, SourceLocation, Normal, InFrontScalar.GetData());
+	});
+
+	// Transform (back and forth to keep the values in range)
+	TArray<float> TX = X, TY = Y, TZ = Z;
+	TArray<float> SX = X, SY = Y, SZ = Z;
+
+	FMatrix InverseLinkMatrix = LinkMatrix.Inverse();
+
+	double TransformNs = MeasureNsPerElement(Iterations, Count, [&]()
+	{
+		FPortalMath::TransformPositions(LinkMatrix, TX.GetData(), TY.GetData(), TZ.GetData(), Count);
+		FPortalMath::TransformPositions(InverseLinkMatrix, TX.GetData(), TY.GetData(), TZ.GetData(), Count);
+	}) * 0.5;
+
+	double TransformScalarNs = MeasureNsPerElement(Iterations, Count, [&]()
+	{
+		FPortalMath::TransformPositionsScalar(LinkMatrix, SX.GetData(), SY.GetData(), SZ.GetData(), Count);
+		FPortalMath::TransformPositionsScalar(InverseLinkMatrix, SX.GetData(), SY.GetData(), SZ.GetData(), Count);
+	}) * 0.5;
+
+	// Crossings : short random steps next to one opening
+	TArray<float> CurX, CurY, CurZ;
+	CurX.SetNumUninitialized(Count);
+	CurY.SetNumUninitialized(Count);
+	CurZ.SetNumUninitialized(Count);
+
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		X[Index] = SourceLocation.X + Random.FRandRange(-100.0f, 100.0f);
+		Y[Index] = SourceLocation.Y + Random.FRandRange(-100.0f, 100.0f);
+		Z[Index] = SourceLocation.Z + Random.FRandRange(-100.0f, 100.0f);
+		CurX[Index] = X[Index] + Random.FRandRange(-50.0f, 50.0f);
+		CurY[Index] = Y[Index] + Random.FRandRange(-50.0f, 50.0f);
+		CurZ[Index] = Z[Index] + Random.FRandRange(-50.0f, 50.0f);
+	}
+
+	FVector Right = SourceRotation.GetRightVector();
+	FVector Up = SourceRotation.GetUpVector();
+	TArray<float> CenterX, CenterY, CenterZ, NormalX, NormalY, NormalZ, RightX, RightY, RightZ, UpX, UpY, UpZ, HalfWidths, HalfHeights;
+
+	CenterX.Init(SourceLocation.X, Count);
+	CenterY.Init(SourceLocation.Y, Count);
+	CenterZ.Init(SourceLocation.Z, Count);
+	NormalX.Init(Normal.X, Count);
+	NormalY.Init(Normal.Y, Count);
+	NormalZ.Init(Normal.Z, Count);
+	RightX.Init(Right.X, Count);
+	RightY.Init(Right.Y, Count);
+	RightZ.Init(Right.Z, Count);
+	UpX.Init(Up.X, Count);
+	UpY.Init(Up.Y, Count);
+	UpZ.Init(Up.Z, Count);
+	HalfWidths.Init(60.0f, Count);
+	HalfHeights.Init(90.0f, Count);
+
+	FPortalCrossingBatch Batch;
+	Batch.PrevX = X.GetData();
+	Batch.PrevY = Y.GetData();
+	Batch.PrevZ = Z.GetData();
+	Batch.CurX = CurX.GetData();
+	Batch.CurY = CurY.GetData();
+	Batch.CurZ = CurZ.GetData();
+	Batch.CenterX = CenterX.GetData();
+	Batch.CenterY = CenterY.GetData();
+	Batch.CenterZ = CenterZ.GetData();
+	Batch.NormalX = NormalX.GetData();
+	Batch.NormalY = NormalY.GetData();
+	Batch.NormalZ = NormalZ.GetData();
+	Batch.RightX = RightX.GetData();
+	Batch.RightY = RightY.GetData();
+	Batch.RightZ = RightZ.GetData();
+	Batch.UpX = UpX.GetData();
+	Batch.UpY = UpY.GetData();
+	Batch.UpZ = UpZ.GetData();
+	Batch.HalfWidths = HalfWidths.GetData();
+	Batch.HalfHeights = HalfHeights.GetData();
+	Batch.Num = Count;
+
+	TArray<int32> Crossed, CrossedScalar;
+
+	double CrossingsNs = MeasureNsPerElement(Iterations, Count, [&]()
+	{
+		Crossed.Reset();
+		FPortalMath::FindCrossings(Batch, Crossed);
+	});
+
+	double CrossingsScalarNs = MeasureNsPerElement(Iterations, Count, [&]()
+	{
+		CrossedScalar.Reset();
+		FPortalMath::FindCrossingsScalar(Batch, CrossedScalar);
+	});
+
+	UE_LOG(LogTemp, Display, TEXT("Portal math : %d elements x %d iterations"), Count, Iterations);
+	UE_LOG(LogTemp, Display, TEXT("  PointsInFrontOfPlane %.2f ns/op (scalar %.2f)"), InFrontNs, InFrontScalarNs);
+	UE_LOG(LogTemp, Display, TEXT("  TransformPositions   %.2f ns/op (scalar %.2f)"), TransformNs, TransformScalarNs);
+	UE_LOG(LogTemp, Display, TEXT("  FindCrossings        %.2f ns/op (scalar %.2f), %d crossings"), CrossingsNs, CrossingsScalarNs, Crossed.Num());
+}
+
+static FAutoConsoleCommand PortalMathBenchmarkCommand(
+	TEXT("Portal.MathBenchmark"),
+	TEXT("Log the time per element of the portal math, vector and scalar versions. Arguments : [Count] [Iterations]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunPortalMathBenchmark));
+
+FPortalBenchmark::FPortalBenchmark()
+	: CrossingTracker(nullptr)
+	, bUntrackPawn(false)
+	, PreviousMovementMode(MOVE_None)
+	, PreviousCustomMode(0)
+	, CurrentSegment(INDEX_NONE)
+	, SegmentDistance(0.0f)
+	, ExpectedLocation(FVector::ZeroVector)
+	, Crossings(0)
+	, WarmupFramesLeft(0)
+	, bRunning(false)
+	, bPassed(false)
+	, bExitWhenDone(false)
+{
+}
+
+bool FPortalBenchmark::Start(APawn* InPawn, const FPortalRegistry& Registry, FPortalCrossingTracker& InCrossingTracker, bool bInExitWhenDone)
+{
+	if (bRunning || InPawn == nullptr)
+	{
+		return false;
+	}
+
+	//-----------------------------------
+	// One run per portal : from the run up point
+	// in front of it, straight through its center
+	//-----------------------------------
+	TArray<APortal_Actor*> Portals;
+	Registry.GetPortals(Portals);
+
+	Segments.Reset();
+
+	float RunUp = CVarPortalBenchmarkRunUp.GetValueOnGameThread();
+
+	for (APortal_Actor* Portal : Portals)
+	{
+		if (Portal->GetTarget() == nullptr)
+		{
+			continue;
+		}
+
+		FSegment& Segment = Segments.AddDefaulted_GetRef();
+		Segment.Portal = Portal;
+		Segment.Direction = -Portal->GetActorForwardVector();
+		Segment.Start = Portal->GetActorLocation() - Segment.Direction * RunUp;
+		Segment.Length = RunUp * 2.0f;
+	}
+
+	if (Segments.Num() == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Portal benchmark : no portal with a target in the level"));
+		return false;
+	}
+
+	Pawn = InPawn;
+	Frames.Reset();
+	Crossings = 0;
+	WarmupFramesLeft = CVarPortalBenchmarkWarmupFrames.GetValueOnGameThread();
+	bExitWhenDone = bInExitWhenDone;
+	bPassed = false;
+	bRunning = true;
+
+	// Free flight, no gravity or floor checks
+	ACharacter* Character = Cast<ACharacter>(InPawn);
+
+	if (Character != nullptr && Character->GetCharacterMovement() != nullptr)
+	{
+		PreviousMovementMode = Character->GetCharacterMovement()->MovementMode;
+		PreviousCustomMode = Character->GetCharacterMovement()->CustomMovementMode;
+		Character->GetCharacterMovement()->SetMovementMode(MOVE_Flying);
+	}
+
+	// The fly-through relies on the crossing detection to go through
+	CrossingTracker = &InCrossingTracker;
+	bUntrackPawn = !CrossingTracker->IsTracked(InPawn);
+	CrossingTracker->TrackActor(InPawn);
+
+#if CSV_PROFILER
+	// Full capture with the Portal category next to our summary
+	FCsvProfiler::Get()->BeginCapture();
+#endif
+
+	StartSegment(0);
+
+	UE_LOG(LogTemp, Log, TEXT("Portal benchmark : started over %d portals"), Segments.Num());
+
+	return true;
+}
+
+bool FPortalBenchmark::IsRunning() const
+{
+	return bRunning;
+}
+
+bool FPortalBenchmark::HasPassed() const
+{
+	return bPassed;
+}
+
+void FPortalBenchmark::StartSegment(int32 SegmentIndex)
+{
+	CurrentSegment = SegmentIndex;
+	SegmentDistance = 0.0f;
+
+	APawn* CurrentPawn = Pawn.Get();
+
+	if (CurrentPawn == nullptr || !Segments.IsValidIndex(SegmentIndex))
+	{
+		return;
+	}
+
+	const FSegment& Segment = Segments[SegmentIndex];
+
+	CurrentPawn->SetActorLocation(Segment.Start, false, nullptr, ETeleportType::TeleportPhysics);
+	ExpectedLocation = CurrentPawn->GetActorLocation();
+
+	if (CurrentPawn->GetController() != nullptr)
+	{
+		CurrentPawn->GetController()->SetControlRotation(Segment.Direction.Rotation());
+	}
+}
+
+void FPortalBenchmark::Tick(float DeltaTime, double PortalTimeMs)
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	APawn* CurrentPawn = Pawn.Get();
+
+	if (CurrentPawn == nullptr)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Portal benchmark : pawn destroyed, aborting"));
+		Finish();
+		return;
+	}
+
+	//-----------------------------------
+	// Record the frame that just ended
+	//-----------------------------------
+	if (WarmupFramesLeft > 0)
+	{
+		WarmupFramesLeft--;
+	}
+	else
+	{
+		FFrame& Frame = Frames.AddDefaulted_GetRef();
+		Frame.FrameMs = DeltaTime * 1000.0f;
+		Frame.GameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+		Frame.RenderThreadMs = FPlatformTime::ToMilliseconds(GRenderThreadTime);
+		Frame.PortalMs = float(PortalTimeMs);
+		Frame.Segment = CurrentSegment;
+	}
+
+	//-----------------------------------
+	// The crossing detection moved the pawn to the
+	// target : this run is done, go to the next portal
+	//-----------------------------------
+	float Step = CVarPortalBenchmarkSpeed.GetValueOnGameThread() * DeltaTime;
+	bool bTeleported = !CurrentPawn->GetActorLocation().Equals(ExpectedLocation, FMath::Max(Step, 1.0f) + 50.0f);
+
+	if (bTeleported)
+	{
+		Crossings++;
+	}
+
+	if (bTeleported || SegmentDistance >= Segments[CurrentSegment].Length)
+	{
+		if (CurrentSegment + 1 >= Segments.Num())
+		{
+			Finish();
+			return;
+		}
+
+		StartSegment(CurrentSegment + 1);
+		return;
+	}
+
+	const FSegment& Segment = Segments[CurrentSegment];
+
+	CurrentPawn->SetActorLocation(CurrentPawn->GetActorLocation() + Segment.Direction * Step);
+	ExpectedLocation = CurrentPawn->GetActorLocation();
+	SegmentDistance += Step;
+}
+
+void FPortalBenchmark::Finish()
+{
+	bRunning = false;
+
+#if CSV_PROFILER
+	FCsvProfiler::Get()->EndCapture();
+#endif
+
+	//-----------------------------------
+	// Give the pawn back as it was (nothing
+	// to do when it was destroyed)
+	//-----------------------------------
+	APawn* CurrentPawn = Pawn.Get();
+	ACharacter* Character = Cast<ACharacter>(CurrentPawn);
+
+	if (Character != nullptr && Character->GetCharacterMovement() != nullptr)
+	{
+		Character->GetCharacterMovement()->SetMovementMode(PreviousMovementMode, PreviousCustomMode);
+	}
+
+	if (CurrentPawn != nullptr && CrossingTracker != nullptr && bUntrackPawn)
+	{
+		CrossingTracker->UntrackActor(CurrentPawn);
+	}
+
+	CrossingTracker = nullptr;
+	bUntrackPawn = false;
+
+	//-----------------------------------
+	// Summary and thresholds
+	//-----------------------------------
+	double TotalGameThreadMs = 0.0;
+	double TotalPortalMs = 0.0;
+	float PeakPortalMs = 0.0f;
+
+	for (const FFrame& Frame : Frames)
+	{
+		TotalGameThreadMs += Frame.GameThreadMs;
+		TotalPortalMs += Frame.PortalMs;
+		PeakPortalMs = FMath::Max(PeakPortalMs, Frame.PortalMs);
+	}
+
+	int32 FrameCount = FMath::Max(Frames.Num(), 1);
+	float AvgGameThreadMs = float(TotalGameThreadMs / FrameCount);
+	float AvgPortalMs = float(TotalPortalMs / FrameCount);
+
+	bPassed = Frames.Num() > 0
+		&& AvgGameThreadMs <= CVarPortalBenchmarkMaxAvgGameThreadMs.GetValueOnGameThread()
+		&& AvgPortalMs <= CVarPortalBenchmarkMaxAvgPortalMs.GetValueOnGameThread()
+		&& PeakPortalMs <= CVarPortalBenchmarkMaxPeakPortalMs.GetValueOnGameThread();
+
+	FString Filename;
+	WriteCsv(Filename);
+
+	UE_LOG(LogTemp, Display, TEXT("Portal benchmark : %s - %d frames, %d/%d portals crossed, game thread avg %.2fms, portals avg %.2fms peak %.2fms (%s)"),
+		bPassed ? TEXT("PASSED") : TEXT("FAILED"),
+		Frames.Num(),
+		Crossings,
+		Segments.Num(),
+		AvgGameThreadMs,
+		AvgPortalMs,
+		PeakPortalMs,
+		*Filename);
+
+	if (bExitWhenDone)
+	{
+		FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+	}
+}
+
+bool FPortalBenchmark::WriteCsv(FString& OutFilename) const
+{
+	OutFilename = FPaths::Combine(FPaths::ProfilingDir(), TEXT("PortalBenchmark"),
+		FString::Printf(TEXT("PortalBenchmark-%s.csv"), *FDateTime::Now().ToString()));
+
+	FString Csv = TEXT("Frame,FrameMs,GameThreadMs,RenderThreadMs,PortalMs,Segment\n");
+
+	for (int32 Index = 0; Index < Frames.Num(); Index++)
+	{
+		const FFrame& Frame = Frames[Index];
+
+		Csv += FString::Printf(TEXT("%d,%.3f,%.3f,%.3f,%.3f,%d\n"),
+			Index,
+			Frame.FrameMs,
+			Frame.GameThreadMs,
+			Frame.RenderThreadMs,
+			Frame.PortalMs,
+			Frame.Segment);
+	}
+
+	return FFileHelper::SaveStringToFile(Csv, *OutFilename);
+}
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+//Forward declaration
+class APawn;
+class APortal_Actor;
+class FPortalCrossingTracker;
+class FPortalRegistry;
+
+/**
+ * Scripted fly-through of the view pawn across every portal of the
+ * level, recording per frame timings to a CSV file and checking them
+ * against the portal.Benchmark.* thresholds.
+ *
+ * Run it with "Portal.Benchmark" in the console, or on a build agent with
+ *   EL Main -game -nullrhi -unattended -PortalBenchmark
+ * which exits with a non zero code when a threshold is exceeded, or as
+ * the EL.Portal.Benchmark automation test.
+ */
+class EL_API FPortalBenchmark
+{
+public:
+    FPortalBenchmark();
+
+    // Build the path from the registered portals and take control of the Pawn.
+    // The pawn is tracked by CrossingTracker and flies for the run, both are
+    // restored when it finishes.
+    bool Start(APawn* Pawn, const FPortalRegistry& Registry, FPortalCrossingTracker& CrossingTracker, bool bExitWhenDone);
+
+    bool IsRunning() const;
+
+    // Thresholds met by the last finished run
+    bool HasPassed() const;
+
+    // Move the pawn for this frame and record the previous one
+    // PortalTimeMs is the time spent in the portal subsystem last frame
+    void Tick(float DeltaTime, double PortalTimeMs);
+
+private:
+    struct FFrame
+    {
+        float FrameMs;
+        float GameThreadMs;
+        float RenderThreadMs;
+        float PortalMs;
+        int32 Segment;
+    };
+
+    // One straight run through a portal
+    struct FSegment
+    {
+        TWeakObjectPtr<APortal_Actor> Portal;
+        FVector Start;
+        FVector Direction;
+        float Length;
+    };
+
+    void StartSegment(int32 SegmentIndex);
+
+    void Finish();
+
+    bool WriteCsv(FString& OutFilename) const;
+
+    TWeakObjectPtr<APawn> Pawn;
+
+    FPortalCrossingTracker* CrossingTracker;
+
+    // State of the pawn before the run
+    bool bUntrackPawn;
+
+    TEnumAsByte<EMovementMode> PreviousMovementMode;
+
+    uint8 PreviousCustomMode;
+
+    TArray<FSegment> Segments;
+
+    TArray<FFrame> Frames;
+
+    int32 CurrentSegment;
+
+    float SegmentDistance;
+
+    FVector ExpectedLocation;
+
+    int32 Crossings;
+
+    int32 WarmupFramesLeft;
+
+    bool bRunning;
+
+    bool bPassed;
+
+    bool bExitWhenDone;
+};
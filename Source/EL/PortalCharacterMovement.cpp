@@ -0,0 +1,325 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalCharacterMovement.h"
+#include "Portal_Actor.h"
+#include "PortalStats.h"
+#include "GameFramework/Character.h"
+#include "Components/CapsuleComponent.h"
+
+//-----------------------------------
+// FPortalTeleportPayload
+//-----------------------------------
+bool FPortalTeleportPayload::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	// Net GUID of the portal (level placed, so never exported after the first use)
+	UObject* PortalObject = Portal;
+	bOutSuccess = Map->SerializeObject(Ar, APortal_Actor::StaticClass(), PortalObject);
+
+	if (Ar.IsLoading())
+	{
+		Portal = Cast<APortal_Actor>(PortalObject);
+	}
+
+	bool bLocationSuccess = true;
+	RelativeLocation.NetSerialize(Ar, Map, bLocationSuccess);
+
+	bOutSuccess &= bLocationSuccess;
+	return true;
+}
+
+//-----------------------------------
+// UPortalCharacterMovementComponent
+//-----------------------------------
+UPortalCharacterMovementComponent::UPortalCharacterMovementComponent()
+{
+	MaxPortalTeleportError = 100.0f;
+	bPortalTeleportPending = false;
+	bApplyingPortalTeleport = false;
+	NumPredictedTeleports = 0;
+	NumRejectedTeleports = 0;
+	NumCorrections = 0;
+}
+
+bool UPortalCharacterMovementComponent::TeleportThroughPortal(APortal_Actor* Portal)
+{
+	if (CharacterOwner == nullptr || Portal == nullptr || bApplyingPortalTeleport)
+	{
+		return false;
+	}
+
+	switch (CharacterOwner->GetLocalRole())
+	{
+	case ROLE_AutonomousProxy:
+		PredictPortalTeleport(Portal);
+		return true;
+
+	case ROLE_SimulatedProxy:
+		// Follows the location replicated by the server
+		return true;
+
+	case ROLE_Authority:
+		// A remote player teleports through its own moves
+		return CharacterOwner->IsPlayerControlled() && !CharacterOwner->IsLocallyControlled();
+
+	default:
+		return false;
+	}
+}
+
+void UPortalCharacterMovementComponent::PredictPortalTeleport(APortal_Actor* Portal)
+{
+	FPortalTeleportPayload Payload;
+	Payload.Portal = Portal;
+	Payload.RelativeLocation = Portal->GetActorTransform().InverseTransformPosition(UpdatedComponent->GetComponentLocation());
+
+	// Location, velocity and view move now, like offline
+	{
+		TGuardValue<bool> ApplyingGuard(bApplyingPortalTeleport, true);
+		Portal->TeleportActor(CharacterOwner);
+	}
+
+	// Picked up by the next saved move
+	PendingPortalTeleport = Payload;
+	bPortalTeleportPending = true;
+
+	// Reliable and sent before the flagged move
+	ServerPortalTeleport(Payload);
+
+	++NumPredictedTeleports;
+	INC_PORTAL_COUNTER(PortalNetTeleports, 1);
+}
+
+bool UPortalCharacterMovementComponent::ServerPortalTeleport_Validate(const FPortalTeleportPayload& Payload)
+{
+	// Checked against the movement when the flagged move arrives
+	return true;
+}
+
+void UPortalCharacterMovementComponent::ServerPortalTeleport_Implementation(const FPortalTeleportPayload& Payload)
+{
+	PendingPortalTeleport = Payload;
+	bPortalTeleportPending = true;
+}
+
+void UPortalCharacterMovementComponent::UpdateFromCompressedFlags(uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	if ((Flags & FSavedMove_Character::FLAG_Custom_0) != 0)
+	{
+		ApplyPendingPortalTeleport();
+	}
+}
+
+void UPortalCharacterMovementComponent::ApplyPendingPortalTeleport()
+{
+	if (CharacterOwner == nullptr)
+	{
+		return;
+	}
+
+	bool bAuthority = CharacterOwner->GetLocalRole() == ROLE_Authority;
+
+	//-----------------------------------
+	// The server only trusts the payload if the
+	// character really is at the portal
+	//-----------------------------------
+	if (!bPortalTeleportPending || (bAuthority && !IsPortalTeleportValid(PendingPortalTeleport)))
+	{
+		if (bAuthority)
+		{
+			++NumRejectedTeleports;
+			INC_PORTAL_COUNTER(PortalNetRejected, 1);
+		}
+
+		bPortalTeleportPending = false;
+		return;
+	}
+
+	APortal_Actor* Portal = PendingPortalTeleport.Portal;
+	bPortalTeleportPending = false;
+
+	if (Portal == nullptr)
+	{
+		return;
+	}
+
+	//-----------------------------------
+	// Same location and velocity as TeleportActor(),
+	// the view comes with the moves of the client
+	//-----------------------------------
+	FVector NewLocation = Portal->TransformLocationToTarget(UpdatedComponent->GetComponentLocation());
+
+	CharacterOwner->SetActorLocation(NewLocation, false, nullptr, ETeleportType::TeleportPhysics);
+	Velocity = Portal->TransformDirectionToTarget(Velocity);
+}
+
+bool UPortalCharacterMovementComponent::IsPortalTeleportValid(const FPortalTeleportPayload& Teleport)
+{
+	APortal_Actor* Portal = Teleport.Portal;
+
+	if (Portal == nullptr || Portal->GetTarget() == nullptr)
+	{
+		return false;
+	}
+
+	FVector RelativeLocation = Portal->GetActorTransform().InverseTransformPosition(UpdatedComponent->GetComponentLocation());
+
+	// Started from where the server has it
+	if (FVector::DistSquared(RelativeLocation, Teleport.RelativeLocation) > FMath::Square(MaxPortalTeleportError))
+	{
+		return false;
+	}
+
+	// At the opening (the whole plane when there is none)
+	const FBox& Opening = Portal->GetLocalOpeningBounds();
+
+	if (Opening.IsValid)
+	{
+		float Tolerance = MaxPortalTeleportError + CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleRadius();
+
+		if (!Opening.ExpandBy(Tolerance).IsInsideOrOn(RelativeLocation))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void UPortalCharacterMovementComponent::OnMovementUpdated(float DeltaSeconds, const FVector& OldLocation, const FVector& OldVelocity)
+{
+	Super::OnMovementUpdated(DeltaSeconds, OldLocation, OldVelocity);
+
+	// The new saved move took the teleport
+	if (CharacterOwner != nullptr && CharacterOwner->GetLocalRole() == ROLE_AutonomousProxy && !CharacterOwner->bClientUpdating)
+	{
+		bPortalTeleportPending = false;
+	}
+}
+
+bool UPortalCharacterMovementComponent::ClientUpdatePositionAfterServerUpdate()
+{
+	// Replayed moves overwrite the teleport waiting for the next move
+	FPortalTeleportPayload NextTeleport = PendingPortalTeleport;
+	bool bNextTeleportPending = bPortalTeleportPending;
+
+	bool bResult = Super::ClientUpdatePositionAfterServerUpdate();
+
+	PendingPortalTeleport = NextTeleport;
+	bPortalTeleportPending = bNextTeleportPending;
+
+	return bResult;
+}
+
+void UPortalCharacterMovementComponent::ClientAdjustPosition_Implementation(float TimeStamp, FVector NewLoc, FVector NewVel, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode)
+{
+	++NumCorrections;
+	INC_PORTAL_COUNTER(PortalNetCorrections, 1);
+
+	Super::ClientAdjustPosition_Implementation(TimeStamp, NewLoc, NewVel, NewBase, NewBaseBoneName, bHasBase, bBaseRelativePosition, ServerMovementMode);
+}
+
+void UPortalCharacterMovementComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (NumPredictedTeleports > 0 || NumRejectedTeleports > 0 || NumCorrections > 0)
+	{
+		UE_LOG(LogTemp, Log, TEXT("Portal movement %s : %d predicted teleports, %d rejected, %d corrections"),
+			*GetPathNameSafe(CharacterOwner), NumPredictedTeleports, NumRejectedTeleports, NumCorrections);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+FNetworkPredictionData_Client* UPortalCharacterMovementComponent::GetPredictionData_Client() const
+{
+	if (ClientPredictionData == nullptr)
+	{
+		UPortalCharacterMovementComponent* MutableThis = const_cast<UPortalCharacterMovementComponent*>(this);
+		MutableThis->ClientPredictionData = new FNetworkPredictionData_Client_PortalCharacter(*this);
+	}
+
+	return ClientPredictionData;
+}
+
+//-----------------------------------
+// FSavedMove_PortalCharacter
+//-----------------------------------
+void FSavedMove_PortalCharacter::Clear()
+{
+	Super::Clear();
+
+	bPortalTeleport = false;
+	TeleportPortal.Reset();
+	TeleportRelativeLocation = FVector::ZeroVector;
+}
+
+uint8 FSavedMove_PortalCharacter::GetCompressedFlags() const
+{
+	uint8 Flags = Super::GetCompressedFlags();
+
+	if (bPortalTeleport)
+	{
+		Flags |= FLAG_Custom_0;
+	}
+
+	return Flags;
+}
+
+bool FSavedMove_PortalCharacter::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const
+{
+	// The teleport happens between the two moves
+	if (bPortalTeleport || static_cast<const FSavedMove_PortalCharacter*>(NewMove.Get())->bPortalTeleport)
+	{
+		return false;
+	}
+
+	return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+bool FSavedMove_PortalCharacter::IsImportantMove(const FSavedMovePtr& LastAckedMove) const
+{
+	return bPortalTeleport || Super::IsImportantMove(LastAckedMove);
+}
+
+void FSavedMove_PortalCharacter::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData)
+{
+	Super::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
+
+	UPortalCharacterMovementComponent* Movement = Cast<UPortalCharacterMovementComponent>(C->GetCharacterMovement());
+
+	if (Movement != nullptr && Movement->bPortalTeleportPending)
+	{
+		bPortalTeleport = true;
+		TeleportPortal = Movement->PendingPortalTeleport.Portal;
+		TeleportRelativeLocation = Movement->PendingPortalTeleport.RelativeLocation;
+	}
+}
+
+void FSavedMove_PortalCharacter::PrepMoveFor(ACharacter* C)
+{
+	Super::PrepMoveFor(C);
+
+	// Replayed : teleport again when the move starts
+	UPortalCharacterMovementComponent* Movement = Cast<UPortalCharacterMovementComponent>(C->GetCharacterMovement());
+
+	if (Movement != nullptr)
+	{
+		Movement->bPortalTeleportPending = bPortalTeleport;
+		Movement->PendingPortalTeleport.Portal = TeleportPortal.Get();
+		Movement->PendingPortalTeleport.RelativeLocation = TeleportRelativeLocation;
+	}
+}
+
+//-----------------------------------
+// FNetworkPredictionData_Client_PortalCharacter
+//-----------------------------------
+FNetworkPredictionData_Client_PortalCharacter::FNetworkPredictionData_Client_PortalCharacter(const UCharacterMovementComponent& ClientMovement)
+	: Super(ClientMovement)
+{
+}
+
+FSavedMovePtr FNetworkPredictionData_Client_PortalCharacter::AllocateNewMove()
+{
+	return FSavedMovePtr(new FSavedMove_PortalCharacter());
+}
@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Engine/NetSerialization.h"
+#include "PortalCharacterMovement.generated.h"
+
+//Forward declaration
+class APortal_Actor;
+
+// Teleport sent by the owning client : the portal and where the
+// character was relative to it, quantized to a tenth of a centimeter
+USTRUCT()
+struct EL_API FPortalTeleportPayload
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+        APortal_Actor* Portal = nullptr;
+
+    // Location before the teleport, in portal space
+    UPROPERTY()
+        FVector_NetQuantize10 RelativeLocation = FVector::ZeroVector;
+
+    bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FPortalTeleportPayload> : public TStructOpsTypeTraitsBase2<FPortalTeleportPayload>
+{
+    enum
+    {
+        WithNetSerializer = true,
+    };
+};
+
+/**
+ * Character movement teleporting through the portals as part of the
+ * client prediction instead of moving the character on the spot.
+ *
+ * The owning client teleports right away, sends the payload to the
+ * server and flags its next saved move (FLAG_Custom_0). The server
+ * applies the teleport when it simulates that move, after checking the
+ * character is where the client said, at the portal opening. Replayed
+ * moves teleport again at the same point, so a teleport never causes
+ * a correction by itself. A rejected teleport is corrected like any
+ * other move.
+ *
+ * "stat portal" counts the predicted/rejected teleports and corrections,
+ * each component logs its totals when it ends play. Bandwidth is visible
+ * in "stat net" or Networking Insights (-NetTrace=1).
+ */
+UCLASS()
+class EL_API UPortalCharacterMovementComponent : public UCharacterMovementComponent
+{
+    GENERATED_BODY()
+
+public:
+    UPortalCharacterMovementComponent();
+
+    // Called by APortal_Actor::TeleportActor, returns true when the
+    // teleport is handled here (predicted, or left to the owning client)
+    bool TeleportThroughPortal(APortal_Actor* Portal);
+
+    //Distance allowed between the location sent by the client and the one
+    //of the server, also added around the portal opening
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement (Networking)")
+        float MaxPortalTeleportError;
+
+    //UCharacterMovementComponent
+    virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+    virtual void ClientAdjustPosition_Implementation(float TimeStamp, FVector NewLoc, FVector NewVel, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode) override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+protected:
+    UFUNCTION(Server, Reliable, WithValidation)
+        void ServerPortalTeleport(const FPortalTeleportPayload& Payload);
+
+    //UCharacterMovementComponent
+    virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+    virtual void OnMovementUpdated(float DeltaSeconds, const FVector& OldLocation, const FVector& OldVelocity) override;
+    virtual bool ClientUpdatePositionAfterServerUpdate() override;
+
+private:
+    friend class FSavedMove_PortalCharacter;
+
+    // Owning client : teleport now and send it
+    void PredictPortalTeleport(APortal_Actor* Portal);
+
+    // Server and replayed moves : teleport at the start of the flagged move
+    void ApplyPendingPortalTeleport();
+
+    bool IsPortalTeleportValid(const FPortalTeleportPayload& Teleport);
+
+    // Teleport of the next move (owning client) or received from it (server)
+    UPROPERTY(Transient)
+        FPortalTeleportPayload PendingPortalTeleport;
+
+    bool bPortalTeleportPending;
+
+    // Set while the portal moves the character for us
+    bool bApplyingPortalTeleport;
+
+    // Totals logged at EndPlay
+    int32 NumPredictedTeleports;
+    int32 NumRejectedTeleports;
+    int32 NumCorrections;
+};
+
+// Saved move remembering the teleport that happened before it
+class EL_API FSavedMove_PortalCharacter : public FSavedMove_Character
+{
+public:
+    typedef FSavedMove_Character Super;
+
+    virtual void Clear() override;
+    virtual uint8 GetCompressedFlags() const override;
+    virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+    virtual bool IsImportantMove(const FSavedMovePtr& LastAckedMove) const override;
+    virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) override;
+    virtual void PrepMoveFor(ACharacter* C) override;
+
+    bool bPortalTeleport = false;
+
+    TWeakObjectPtr<APortal_Actor> TeleportPortal;
+
+    FVector TeleportRelativeLocation = FVector::ZeroVector;
+};
+
+class EL_API FNetworkPredictionData_Client_PortalCharacter : public FNetworkPredictionData_Client_Character
+{
+public:
+    typedef FNetworkPredictionData_Client_Character Super;
+
+    FNetworkPredictionData_Client_PortalCharacter(const UCharacterMovementComponent& ClientMovement);
+
+    virtual FSavedMovePtr AllocateNewMove() override;
+};
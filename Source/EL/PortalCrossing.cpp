@@ -0,0 +1,384 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalCrossing.h"
+#include "PortalRegistry.h"
+#include "Portal_Actor.h"
+#include "PortalMath.h"
+
+FPortalCrossingTracker::FPortalCrossingTracker()
+{
+}
+
+uint64 FPortalCrossingTracker::GetPairKey(int32 ActorIndex, const APortal_Actor* Portal)
+{
+	return (uint64(uint32(ActorIndex)) << 32) | uint64(Portal->GetUniqueID());
+}
+
+void FPortalCrossingTracker::TrackActor(AActor* Actor)
+{
+	if (Actor == nullptr || ActorIndices.Contains(Actor))
+	{
+		return;
+	}
+
+	FTrackedActor TrackedActor;
+	TrackedActor.Actor = Actor;
+	TrackedActor.Location = Actor->GetActorLocation();
+
+	ActorIndices.Add(Actor, Actors.Add(TrackedActor));
+}
+
+void FPortalCrossingTracker::UntrackActor(AActor* Actor)
+{
+	int32 ActorIndex = INDEX_NONE;
+
+	if (!ActorIndices.RemoveAndCopyValue(Actor, ActorIndex))
+	{
+		return;
+	}
+
+	for (int32 PairIndex = PairActors.Num() - 1; PairIndex >= 0; PairIndex--)
+	{
+		if (PairActors[PairIndex] == ActorIndex)
+		{
+			RemovePair(PairIndex);
+		}
+	}
+
+	Actors.RemoveAt(ActorIndex);
+}
+
+bool FPortalCrossingTracker::IsTracked(const AActor* Actor) const
+{
+	return ActorIndices.Contains(Actor);
+}
+
+void FPortalCrossingTracker::ResetActor(AActor* Actor)
+{
+	const int32* ActorIndex = ActorIndices.Find(Actor);
+
+	if (ActorIndex == nullptr)
+	{
+		return;
+	}
+
+	FVector Location = Actor->GetActorLocation();
+	Actors[*ActorIndex].Location = Location;
+
+	for (int32 PairIndex = 0; PairIndex < PairActors.Num(); PairIndex++)
+	{
+		if (PairActors[PairIndex] == *ActorIndex)
+		{
+			PrevX[PairIndex] = Location.X;
+			PrevY[PairIndex] = Location.Y;
+			PrevZ[PairIndex] = Location.Z;
+		}
+	}
+}
+
+void FPortalCrossingTracker::RemovePortal(APortal_Actor* Portal)
+{
+	for (int32 PairIndex = PairPortals.Num() - 1; PairIndex >= 0; PairIndex--)
+	{
+		if (PairPortals[PairIndex] == Portal)
+		{
+			RemovePair(PairIndex);
+		}
+	}
+}
+
+void FPortalCrossingTracker::Reset()
+{
+	Actors.Empty();
+	ActorIndices.Empty();
+
+	PairActors.Empty();
+	PairPortals.Empty();
+	PrevX.Empty();
+	PrevY.Empty();
+	PrevZ.Empty();
+	PairFrames.Empty();
+	PairIndices.Empty();
+}
+
+int32 FPortalCrossingTracker::NumPairs() const
+{
+	return PairActors.Num();
+}
+
+void FPortalCrossingTracker::Update(const FPortalRegistry& Registry, float QueryRadius, TArray<FPortalCrossing>& OutCrossings)
+{
+	GatherPairs(Registry, QueryRadius);
+	SweepPairs(OutCrossings);
+}
+
+int32 FPortalCrossingTracker::AddPair(int32 ActorIndex, APortal_Actor* Portal, const FVector& Location)
+{
+	// A new pair starts where the actor is, it cannot cross on its first sweep
+	int32 PairIndex = PairActors.Add(ActorIndex);
+	PairPortals.Add(Portal);
+	PrevX.Add(Location.X);
+	PrevY.Add(Location.Y);
+	PrevZ.Add(Location.Z);
+	PairFrames.Add(GFrameCounter);
+
+	PairIndices.Add(GetPairKey(ActorIndex, Portal), PairIndex);
+
+	return PairIndex;
+}
+
+void FPortalCrossingTracker::RemovePair(int32 PairIndex)
+{
+	APortal_Actor* Portal = PairPortals[PairIndex].Get();
+
+	//-----------------------------------
+	// The key of a destroyed portal cannot be rebuilt,
+	// look for the entry by value instead
+	//-----------------------------------
+	if (Portal != nullptr)
+	{
+		PairIndices.Remove(GetPairKey(PairActors[PairIndex], Portal));
+	}
+	else
+	{
+		for (auto It = PairIndices.CreateIterator(); It; ++It)
+		{
+			if (It.Value() == PairIndex)
+			{
+				It.RemoveCurrent();
+				break;
+			}
+		}
+	}
+
+	int32 LastIndex = PairActors.Num() - 1;
+
+	PairActors.RemoveAtSwap(PairIndex, 1, false);
+	PairPortals.RemoveAtSwap(PairIndex, 1, false);
+	PrevX.RemoveAtSwap(PairIndex, 1, false);
+	PrevY.RemoveAtSwap(PairIndex, 1, false);
+	PrevZ.RemoveAtSwap(PairIndex, 1, false);
+	PairFrames.RemoveAtSwap(PairIndex, 1, false);
+
+	// The last pair moved into the hole
+	if (PairIndex != LastIndex)
+	{
+		APortal_Actor* MovedPortal = PairPortals[PairIndex].Get();
+
+		if (MovedPortal != nullptr)
+		{
+			PairIndices.Add(GetPairKey(PairActors[PairIndex], MovedPortal), PairIndex);
+		}
+	}
+}
+
+void FPortalCrossingTracker::GatherPairs(const FPortalRegistry& Registry, float QueryRadius)
+{
+	TArray<APortal_Actor*> Portals;
+
+	for (auto It = Actors.CreateIterator(); It; ++It)
+	{
+		FTrackedActor& TrackedActor = *It;
+		AActor* Actor = TrackedActor.Actor.Get();
+
+		if (Actor == nullptr)
+		{
+			continue;
+		}
+
+		TrackedActor.Location = Actor->GetActorLocation();
+
+		//-----------------------------------
+		// Pair the actor with the portals around it,
+		// keeping the previous position of known pairs
+		//-----------------------------------
+		Portals.Reset();
+		Registry.QuerySphere(TrackedActor.Location, QueryRadius, Portals);
+
+		for (APortal_Actor* Portal : Portals)
+		{
+			if (Portal == Actor)
+			{
+				continue;
+			}
+
+			const int32* PairIndex = PairIndices.Find(GetPairKey(It.GetIndex(), Portal));
+
+			if (PairIndex != nullptr)
+			{
+				PairFrames[*PairIndex] = GFrameCounter;
+			}
+			else
+			{
+				AddPair(It.GetIndex(), Portal, TrackedActor.Location);
+			}
+		}
+	}
+
+	// Pairs that drifted apart, or whose actor/portal is gone
+	for (int32 PairIndex = PairActors.Num() - 1; PairIndex >= 0; PairIndex--)
+	{
+		if (PairFrames[PairIndex] != GFrameCounter
+			|| !PairPortals[PairIndex].IsValid()
+			|| !Actors[PairActors[PairIndex]].Actor.IsValid())
+		{
+			RemovePair(PairIndex);
+		}
+	}
+
+	// Actors destroyed without being untracked
+	for (auto It = Actors.CreateIterator(); It; ++It)
+	{
+		if (!It->Actor.IsValid())
+		{
+			for (auto IndexIt = ActorIndices.CreateIterator(); IndexIt; ++IndexIt)
+			{
+				if (IndexIt.Value() == It.GetIndex())
+				{
+					IndexIt.RemoveCurrent();
+					break;
+				}
+			}
+
+			It.RemoveCurrent();
+		}
+	}
+}
+
+int32 FPortalCrossingTracker::GetPortalIndex(APortal_Actor* Portal)
+{
+	const int32* PlaneIndex = PortalPlaneIndices.Find(Portal);
+
+	if (PlaneIndex != nullptr)
+	{
+		return *PlaneIndex;
+	}
+
+	//-----------------------------------
+	// The plane goes through the actor location, facing forward
+	// (same as IsPointCrossingPortal), the opening is the size
+	// of the portal components on its right and up axes
+	//-----------------------------------
+	FPortalPlane Plane;
+	Plane.Normal = Portal->GetActorForwardVector();
+	Plane.Right = Portal->GetActorRightVector();
+	Plane.Up = Portal->GetActorUpVector();
+	Plane.Center = Portal->GetActorLocation();
+	Plane.HalfWidth = BIG_NUMBER;
+	Plane.HalfHeight = BIG_NUMBER;
+
+	// Cached by the portal with its link transform
+	const FBox& LocalBox = Portal->GetLocalOpeningBounds();
+
+	if (LocalBox.IsValid)
+	{
+		FVector Scale = Portal->GetActorScale3D();
+		FVector LocalCenter = LocalBox.GetCenter() * Scale;
+		FVector LocalExtent = LocalBox.GetExtent() * Scale;
+
+		// No visible opening, accept the whole plane
+		if (LocalExtent.Y > KINDA_SMALL_NUMBER && LocalExtent.Z > KINDA_SMALL_NUMBER)
+		{
+			Plane.Center += Plane.Right * LocalCenter.Y + Plane.Up * LocalCenter.Z;
+			Plane.HalfWidth = LocalExtent.Y;
+			Plane.HalfHeight = LocalExtent.Z;
+		}
+	}
+
+	int32 NewIndex = PortalPlanes.Add(Plane);
+	PortalPlaneIndices.Add(Portal, NewIndex);
+
+	return NewIndex;
+}
+
+void FPortalCrossingTracker::SweepPairs(TArray<FPortalCrossing>& OutCrossings)
+{
+	const int32 PairCount = PairActors.Num();
+
+	PortalPlanes.Reset();
+	PortalPlaneIndices.Reset();
+
+	//-----------------------------------
+	// Gather the current positions and the portal
+	// planes next to the previous positions
+	//-----------------------------------
+	TArray<float>* Streams[] = {
+		&CurX, &CurY, &CurZ,
+		&CenterX, &CenterY, &CenterZ,
+		&NormalX, &NormalY, &NormalZ,
+		&RightX, &RightY, &RightZ,
+		&UpX, &UpY, &UpZ,
+		&HalfWidths, &HalfHeights };
+
+	for (TArray<float>* Stream : Streams)
+	{
+		Stream->SetNumUninitialized(PairCount, false);
+	}
+
+	for (int32 PairIndex = 0; PairIndex < PairCount; PairIndex++)
+	{
+		const FVector& Location = Actors[PairActors[PairIndex]].Location;
+		const FPortalPlane& Plane = PortalPlanes[GetPortalIndex(PairPortals[PairIndex].Get())];
+
+		CurX[PairIndex] = Location.X;
+		CurY[PairIndex] = Location.Y;
+		CurZ[PairIndex] = Location.Z;
+		CenterX[PairIndex] = Plane.Center.X;
+		CenterY[PairIndex] = Plane.Center.Y;
+		CenterZ[PairIndex] = Plane.Center.Z;
+		NormalX[PairIndex] = Plane.Normal.X;
+		NormalY[PairIndex] = Plane.Normal.Y;
+		NormalZ[PairIndex] = Plane.Normal.Z;
+		RightX[PairIndex] = Plane.Right.X;
+		RightY[PairIndex] = Plane.Right.Y;
+		RightZ[PairIndex] = Plane.Right.Z;
+		UpX[PairIndex] = Plane.Up.X;
+		UpY[PairIndex] = Plane.Up.Y;
+		UpZ[PairIndex] = Plane.Up.Z;
+		HalfWidths[PairIndex] = Plane.HalfWidth;
+		HalfHeights[PairIndex] = Plane.HalfHeight;
+	}
+
+	//-----------------------------------
+	// The segment from the previous to the current position must
+	// go from the front to the back of the plane (crossing backward
+	// is ignored, similar to Prey 2006) inside the portal opening
+	//-----------------------------------
+	FPortalCrossingBatch Batch;
+	Batch.PrevX = PrevX.GetData();
+	Batch.PrevY = PrevY.GetData();
+	Batch.PrevZ = PrevZ.GetData();
+	Batch.CurX = CurX.GetData();
+	Batch.CurY = CurY.GetData();
+	Batch.CurZ = CurZ.GetData();
+	Batch.CenterX = CenterX.GetData();
+	Batch.CenterY = CenterY.GetData();
+	Batch.CenterZ = CenterZ.GetData();
+	Batch.NormalX = NormalX.GetData();
+	Batch.NormalY = NormalY.GetData();
+	Batch.NormalZ = NormalZ.GetData();
+	Batch.RightX = RightX.GetData();
+	Batch.RightY = RightY.GetData();
+	Batch.RightZ = RightZ.GetData();
+	Batch.UpX = UpX.GetData();
+	Batch.UpY = UpY.GetData();
+	Batch.UpZ = UpZ.GetData();
+	Batch.HalfWidths = HalfWidths.GetData();
+	Batch.HalfHeights = HalfHeights.GetData();
+	Batch.Num = PairCount;
+
+	CrossingIndices.Reset();
+	FPortalMath::FindCrossings(Batch, CrossingIndices);
+
+	for (int32 PairIndex : CrossingIndices)
+	{
+		FPortalCrossing& Crossed = OutCrossings.AddDefaulted_GetRef();
+		Crossed.Actor = Actors[PairActors[PairIndex]].Actor.Get();
+		Crossed.Portal = PairPortals[PairIndex].Get();
+	}
+
+	// Store values for next sweep
+	FMemory::Memcpy(PrevX.GetData(), CurX.GetData(), PairCount * sizeof(float));
+	FMemory::Memcpy(PrevY.GetData(), CurY.GetData(), PairCount * sizeof(float));
+	FMemory::Memcpy(PrevZ.GetData(), CurZ.GetData(), PairCount * sizeof(float));
+}
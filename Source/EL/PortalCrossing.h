@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Forward declaration
+class AActor;
+class APortal_Actor;
+class FPortalRegistry;
+
+// An actor that went through the front of a portal since the last sweep
+struct FPortalCrossing
+{
+    AActor* Actor;
+    APortal_Actor* Portal;
+};
+
+/**
+ * Tracks the previous position of every (actor, portal) pair near each
+ * other and tests all of them against the portal planes at once.
+ * Pairs are stored as a structure of arrays so that the sweep runs
+ * four pairs per iteration with VectorRegister math.
+ */
+class EL_API FPortalCrossingTracker
+{
+public:
+    FPortalCrossingTracker();
+
+    // Start/stop checking an actor against the portals around it
+    void TrackActor(AActor* Actor);
+    void UntrackActor(AActor* Actor);
+
+    bool IsTracked(const AActor* Actor) const;
+
+    // Forget the previous positions of an actor (after a teleport)
+    void ResetActor(AActor* Actor);
+
+    // Drop every pair using this portal
+    void RemovePortal(APortal_Actor* Portal);
+
+    // Remove everything
+    void Reset();
+
+    // Update the pairs from the registry and sweep them,
+    // actors that crossed a portal forward are added to OutCrossings
+    void Update(const FPortalRegistry& Registry, float QueryRadius, TArray<FPortalCrossing>& OutCrossings);
+
+    int32 NumPairs() const;
+
+private:
+    void GatherPairs(const FPortalRegistry& Registry, float QueryRadius);
+
+    int32 AddPair(int32 ActorIndex, APortal_Actor* Portal, const FVector& Location);
+    void RemovePair(int32 PairIndex);
+
+    // Portal plane and extents, cached once per sweep
+    int32 GetPortalIndex(APortal_Actor* Portal);
+
+    void SweepPairs(TArray<FPortalCrossing>& OutCrossings);
+
+    static uint64 GetPairKey(int32 ActorIndex, const APortal_Actor* Portal);
+
+    struct FTrackedActor
+    {
+        TWeakObjectPtr<AActor> Actor;
+
+        // Refreshed at the start of a sweep
+        FVector Location;
+    };
+
+    TSparseArray<FTrackedActor> Actors;
+
+    TMap<const AActor*, int32> ActorIndices;
+
+    //-----------------------------------
+    // Pairs (structure of arrays, same index everywhere)
+    //-----------------------------------
+    TArray<int32> PairActors;
+    TArray<TWeakObjectPtr<APortal_Actor>> PairPortals;
+    TArray<float> PrevX;
+    TArray<float> PrevY;
+    TArray<float> PrevZ;
+
+    // Frame the pair was last found by the registry query
+    TArray<uint64> PairFrames;
+
+    TMap<uint64, int32> PairIndices;
+
+    //-----------------------------------
+    // Per sweep portal data, gathered per pair
+    //-----------------------------------
+    struct FPortalPlane
+    {
+        FVector Center;
+        FVector Normal;
+        FVector Right;
+        FVector Up;
+        float HalfWidth;
+        float HalfHeight;
+    };
+
+    TArray<FPortalPlane> PortalPlanes;
+
+    TMap<const APortal_Actor*, int32> PortalPlaneIndices;
+
+    TArray<float> CurX, CurY, CurZ;
+    TArray<float> CenterX, CenterY, CenterZ;
+    TArray<float> NormalX, NormalY, NormalZ;
+    TArray<float> RightX, RightY, RightZ;
+    TArray<float> UpX, UpY, UpZ;
+    TArray<float> HalfWidths, HalfHeights;
+
+    // Pairs found by the last sweep
+    TArray<int32> CrossingIndices;
+};
@@ -0,0 +1,252 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalEffects.h"
+#include "NiagaraComponent.h"
+#include "Materials/MaterialInterface.h"
+
+// Thresholds are crossed back only this much further, so that effects don't flicker
+static const float PortalEffectHysteresis = 1.25f;
+
+FPortalEffects::FPortalEffects()
+{
+	NumCulled = 0;
+}
+
+FPortalEffects::~FPortalEffects()
+{
+}
+
+void FPortalEffects::TrackEffect(UNiagaraComponent* Effect)
+{
+	if (Effect == nullptr)
+	{
+		return;
+	}
+
+	bool bTracked = Effects.ContainsByPredicate([Effect](const FEffect& Tracked)
+	{
+		return Tracked.Component == Effect;
+	});
+
+	if (!bTracked)
+	{
+		FEffect& Tracked = Effects.AddDefaulted_GetRef();
+		Tracked.Component = Effect;
+		Tracked.bTranslucent = IsTranslucent(Effect);
+	}
+}
+
+void FPortalEffects::UntrackEffect(UNiagaraComponent* Effect)
+{
+	int32 Index = Effects.IndexOfByPredicate([Effect](const FEffect& Tracked)
+	{
+		return Tracked.Component == Effect;
+	});
+
+	if (Index != INDEX_NONE)
+	{
+		Restore(Effects[Index]);
+		Effects.RemoveAtSwap(Index);
+	}
+}
+
+void FPortalEffects::Update(TArrayView<const FPortalEffectView> Views, const FPortalEffectSettings& Settings)
+{
+	NumCulled = 0;
+	CaptureHiddenEffects.Reset();
+
+	// Another parameter : the old one stays where we left it
+	if (SpawnRateParameterName != Settings.SpawnRateParameterName)
+	{
+		for (FEffect& Effect : Effects)
+		{
+			Effect.SpawnRateScale = 1.0f;
+		}
+
+		SpawnRateParameterName = Settings.SpawnRateParameterName;
+	}
+
+	for (int32 Index = Effects.Num() - 1; Index >= 0; Index--)
+	{
+		FEffect& Effect = Effects[Index];
+		UNiagaraComponent* Component = Effect.Component.Get();
+
+		if (Component == nullptr)
+		{
+			Effects.RemoveAtSwap(Index);
+			continue;
+		}
+
+		// Nothing to score against (no player yet)
+		if (Views.Num() == 0)
+		{
+			Restore(Effect);
+			continue;
+		}
+
+		//-----------------------------------
+		// Captures : small translucent effects are not
+		// worth their overdraw in a downscaled texture
+		//-----------------------------------
+		float CapturePixelRadius = ComputePixelRadius(Component->Bounds, Views, true);
+
+		if (Effect.bTranslucent)
+		{
+			float HideRadius = Settings.CaptureHidePixelRadius * (Effect.bHiddenFromCaptures ? PortalEffectHysteresis : 1.0f);
+			Effect.bHiddenFromCaptures = CapturePixelRadius < HideRadius;
+		}
+
+		if (Effect.bHiddenFromCaptures)
+		{
+			CaptureHiddenEffects.Add(Component);
+			CapturePixelRadius = 0.0f;
+		}
+
+		float PixelRadius = FMath::Max(ComputePixelRadius(Component->Bounds, Views, false), CapturePixelRadius);
+
+		//-----------------------------------
+		// Culling : no simulation and no rendering
+		//-----------------------------------
+		float CullRadius = Settings.CullPixelRadius * (Effect.bCulled ? PortalEffectHysteresis : 1.0f);
+		bool bCulled = PixelRadius < CullRadius;
+
+		if (bCulled != Effect.bCulled)
+		{
+			Effect.bCulled = bCulled;
+			Component->SetPaused(bCulled);
+			Component->SetVisibility(!bCulled);
+		}
+
+		if (bCulled)
+		{
+			NumCulled++;
+			continue;
+		}
+
+		//-----------------------------------
+		// Simulation rate
+		//-----------------------------------
+		float ReducedTickRadius = Settings.ReducedTickPixelRadius * (Effect.bReducedTick ? PortalEffectHysteresis : 1.0f);
+		bool bReducedTick = PixelRadius < ReducedTickRadius;
+
+		if (bReducedTick != Effect.bReducedTick)
+		{
+			Effect.bReducedTick = bReducedTick;
+			Component->SetComponentTickInterval(bReducedTick ? Settings.ReducedTickInterval : 0.0f);
+		}
+
+		//-----------------------------------
+		// Spawn rate, only sent when it changed enough
+		//-----------------------------------
+		float SpawnRateScale = FMath::Clamp(PixelRadius / FMath::Max(Settings.FullRatePixelRadius, 1.0f), FMath::Clamp(Settings.MinSpawnRateScale, 0.0f, 1.0f), 1.0f);
+
+		if (FMath::Abs(SpawnRateScale - Effect.SpawnRateScale) > 0.05f || (SpawnRateScale == 1.0f && Effect.SpawnRateScale != 1.0f))
+		{
+			Effect.SpawnRateScale = SpawnRateScale;
+			Component->SetNiagaraVariableFloat(SpawnRateParameterName.ToString(), SpawnRateScale);
+		}
+	}
+}
+
+float FPortalEffects::ComputePixelRadius(const FBoxSphereBounds& Bounds, TArrayView<const FPortalEffectView> Views, bool bCapturesOnly)
+{
+	float PixelRadius = 0.0f;
+
+	for (const FPortalEffectView& View : Views)
+	{
+		if (bCapturesOnly && !View.bCapture)
+		{
+			continue;
+		}
+
+		FVector ToEffect = Bounds.Origin - View.Location;
+		float Distance = ToEffect.Size();
+
+		// Around the view : full size
+		if (Distance <= Bounds.SphereRadius)
+		{
+			return MAX_flt;
+		}
+
+		// Outside the view cone, widened by the size of the effect
+		float CosAngle = FVector::DotProduct(ToEffect / Distance, View.Direction);
+		float SinRadius = Bounds.SphereRadius / Distance;
+		float CosWidened = View.CosHalfFOV * FMath::Sqrt(1.0f - SinRadius * SinRadius) - FMath::Sqrt(1.0f - View.CosHalfFOV * View.CosHalfFOV) * SinRadius;
+
+		if (CosAngle < CosWidened)
+		{
+			continue;
+		}
+
+		PixelRadius = FMath::Max(PixelRadius, Bounds.SphereRadius / Distance * View.PixelScale);
+	}
+
+	return PixelRadius;
+}
+
+bool FPortalEffects::IsTranslucent(UNiagaraComponent* Effect)
+{
+	TArray<UMaterialInterface*> Materials;
+	Effect->GetUsedMaterials(Materials);
+
+	return Materials.ContainsByPredicate([](UMaterialInterface* Material)
+	{
+		return Material != nullptr && Material->GetBlendMode() != BLEND_Opaque && Material->GetBlendMode() != BLEND_Masked;
+	});
+}
+
+void FPortalEffects::Restore(FEffect& Effect)
+{
+	UNiagaraComponent* Component = Effect.Component.Get();
+
+	if (Component != nullptr)
+	{
+		if (Effect.bCulled)
+		{
+			Component->SetPaused(false);
+			Component->SetVisibility(true);
+		}
+
+		if (Effect.bReducedTick)
+		{
+			Component->SetComponentTickInterval(0.0f);
+		}
+
+		if (Effect.SpawnRateScale != 1.0f && !SpawnRateParameterName.IsNone())
+		{
+			Component->SetNiagaraVariableFloat(SpawnRateParameterName.ToString(), 1.0f);
+		}
+	}
+
+	Effect.bCulled = false;
+	Effect.bReducedTick = false;
+	Effect.bHiddenFromCaptures = false;
+	Effect.SpawnRateScale = 1.0f;
+}
+
+void FPortalEffects::Reset()
+{
+	for (FEffect& Effect : Effects)
+	{
+		Restore(Effect);
+	}
+
+	Effects.Empty();
+	CaptureHiddenEffects.Empty();
+	NumCulled = 0;
+}
+
+const TArray<TWeakObjectPtr<UPrimitiveComponent>>& FPortalEffects::GetCaptureHiddenEffects() const
+{
+	return CaptureHiddenEffects;
+}
+
+int32 FPortalEffects::NumTrackedEffects() const
+{
+	return Effects.Num();
+}
+
+int32 FPortalEffects::NumCulledEffects() const
+{
+	return NumCulled;
+}
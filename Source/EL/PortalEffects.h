@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Forward declaration
+class UNiagaraComponent;
+class UPrimitiveComponent;
+
+// A view an effect can be seen in : a player camera or a portal capture
+struct FPortalEffectView
+{
+    FVector Location;
+    FVector Direction;
+
+    // Projection scale (1 / tan of the half FOV) times half the width in pixels
+    float PixelScale;
+
+    // Cosine of the half FOV, to reject what is outside
+    float CosHalfFOV;
+
+    bool bCapture;
+};
+
+struct FPortalEffectSettings
+{
+    // Paused and hidden below this radius on screen, in pixels
+    float CullPixelRadius = 1.5f;
+
+    // Full spawn rate from this radius, scaled down to MinSpawnRateScale below
+    float FullRatePixelRadius = 64.0f;
+    float MinSpawnRateScale = 0.25f;
+
+    // User parameter of the systems multiplying their spawn rates
+    FName SpawnRateParameterName = TEXT("SpawnRateScale");
+
+    // Simulated every ReducedTickInterval seconds below this radius
+    float ReducedTickPixelRadius = 24.0f;
+    float ReducedTickInterval = 1.0f / 15.0f;
+
+    // Translucent effects smaller than this in every capture are hidden from the captures
+    float CaptureHidePixelRadius = 16.0f;
+};
+
+/**
+ * Significance of the Niagara effects for the local players, shared by
+ * the main views and the portal captures.
+ *
+ * Each effect is scored by the largest radius its bounds have on screen
+ * in any view (the captures count in texture pixels, so a downscaled
+ * capture counts for less). The score then drives :
+ *   - culling : paused and hidden when too small everywhere
+ *   - the spawn rate : the SpawnRateScale user parameter of the system
+ *   - the simulation rate : a tick interval for the small effects
+ *   - the captures : small translucent effects are hidden from them
+ * Every change has some hysteresis, so effects at a threshold do not flicker.
+ */
+class EL_API FPortalEffects
+{
+public:
+    FPortalEffects();
+    ~FPortalEffects();
+
+    void TrackEffect(UNiagaraComponent* Effect);
+    void UntrackEffect(UNiagaraComponent* Effect);
+
+    // Score the effects against the views and apply the result
+    void Update(TArrayView<const FPortalEffectView> Views, const FPortalEffectSettings& Settings);
+
+    // Restore the effects and forget them
+    void Reset();
+
+    // Translucent effects the captures skip (see APortalManager::UpdateHiddenComponents)
+    const TArray<TWeakObjectPtr<UPrimitiveComponent>>& GetCaptureHiddenEffects() const;
+
+    int32 NumTrackedEffects() const;
+    int32 NumCulledEffects() const;
+
+private:
+    struct FEffect
+    {
+        TWeakObjectPtr<UNiagaraComponent> Component;
+
+        // Uses a translucent material (never occludes, expensive to overdraw)
+        bool bTranslucent = false;
+
+        bool bCulled = false;
+        bool bReducedTick = false;
+        bool bHiddenFromCaptures = false;
+        float SpawnRateScale = 1.0f;
+    };
+
+    static bool IsTranslucent(UNiagaraComponent* Effect);
+
+    // Largest radius on screen in the views (captures only or all of them)
+    static float ComputePixelRadius(const FBoxSphereBounds& Bounds, TArrayView<const FPortalEffectView> Views, bool bCapturesOnly);
+
+    // Undo everything we changed on the effect
+    void Restore(FEffect& Effect);
+
+    TArray<FEffect> Effects;
+
+    TArray<TWeakObjectPtr<UPrimitiveComponent>> CaptureHiddenEffects;
+
+    // Parameter last written, to reset it
+    FName SpawnRateParameterName;
+
+    int32 NumCulled;
+};
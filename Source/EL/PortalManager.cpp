@@ -3,27 +3,203 @@
 #include "PortalManager.h"
 #include "Kismet/GameplayStatics.h"
 #include "GameFramework/Actor.h"
-#include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Player_Controller.h"
-#include "Player_Character.h"
+#include "PortalSubsystem.h"
+#include "PortalStats.h"
+#include "PortalScalability.h"
+#include "PortalEffects.h"
 #include "UObject/UObjectGlobals.h"
 #include "EngineUtils.h"
+#include "SceneView.h"
+#include "UnrealClient.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "WorldCollision.h"
 
 // Sets default values
 APortalManager::APortalManager(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
 	PrimaryActorTick.bCanEverTick = false;
-	PortalTexture = nullptr;
-	UpdateDelay = 1.1f;
+	MaxPortalDistance = 4096.0f;
+
+	MaxCaptures = 3;
+	RenderTargetBudgetMB = 64.0f;
+	DistanceWeight = 1.0f;
+	ScreenCoverageWeight = 2.0f;
+	FacingWeight = 1.0f;
+
+	ResolutionBuckets = { 1.0f, 0.5f, 0.25f };
+	ResolutionQualityBias = 1.0f;
+	MinResolutionScale = 0.25f;
+	MaxResolutionScale = 1.0f;
+	MinPortalResolution = 128;
+
+	bCropCaptureToPortal = false; // Needs a portal material using SetRTTUVRect
+	CropMargin = 0.02f;
+
+	CaptureLocationTolerance = 0.1f;
+	CaptureRotationTolerance = 0.01f;
+	TargetSideCheckRadius = 1024.0f;
+	ReducedRateDistance = 2048.0f;
+	ReducedRateInterval = 3;
+	OnDemandScreenCoverage = 0.01f;
+	OnDemandInterval = 30;
+	bReprojectSkippedCaptures = true;
+
+	MaxRecursionDepth = 2;
+	RecursionResolutionScale = 0.5f;
+	RecursionPixelBudget = 1024 * 1024;
+	RecursionTimeBudgetMs = 1.0f;
+	VisibilityChecksPerFrame = 8;
+	bDetectPlayerCrossing = false;
+	bPrewarmCaptures = true;
+	PrewarmFrames = 2;
+	PrewarmLocationTolerance = 25.0f;
+	PrewarmRotationTolerance = 2.0f;
+	PendingPrewarmTexture = nullptr;
+	PrewarmCapture = nullptr;
+	PrewarmSourcePortal = nullptr;
+	PortalSubsystem = nullptr;
+	RecursionPixelsThisFrame = 0;
+	RecursionTimeThisFrame = 0.0;
 
 	PreviousScreenSizeX = 0;
 	PreviousScreenSizeY = 0;
+	PendingScreenSize = FIntPoint::ZeroValue;
+	bHasPendingRenderTargets = false;
+
+	CameraProjectionMatrix = FMatrix::Identity;
+	CameraViewProjectionMatrix = FMatrix::Identity;
+	EyeProjectionMatrices[0] = FMatrix::Identity;
+	EyeProjectionMatrices[1] = FMatrix::Identity;
+	bHasViewProjection = false;
+	bStereoView = false;
+	PlayerIndex = 0;
+
+	// The SceneCaptures are attached to it and follow the
+	// rotation of the PlayerController we are attached to
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootComponent"));
+}
+
+void APortalManager::Init()
+{
+	QualitySettings = FPortalQualitySettings::Get();
+
+	//------------------------------------------------
+	//Create the pool of Cameras
+	//------------------------------------------------
+	CreateSceneCaptures();
+
+	//------------------------------------------------
+	//Create RTT Buffers (buckets from biggest to smallest)
+	//------------------------------------------------
+	ResolutionBuckets.Sort(TGreater<float>());
+
+	GeneratePortalTexture();
+	UpdatePendingRenderTargets(MAX_int32);
+
+	// Rebuild them only when the viewport changes
+	ViewportResizedHandle = FViewport::ViewportResizedEvent.AddUObject(this, &APortalManager::OnViewportResized);
+
+	//------------------------------------------------
+	//The subsystem knows the portals of the world
+	//and updates us after the camera
+	//------------------------------------------------
+	PortalSubsystem = GetWorld()->GetSubsystem<UPortalSubsystem>();
+
+	if (PortalSubsystem != nullptr)
+	{
+		PortalSubsystem->RegisterManager(this);
+	}
+}
+
+void APortalManager::CreateSceneCaptures()
+{
+	for (int32 Index = SceneCaptures.Num(); Index < GetMaxCaptures(); Index++)
+	{
+		SceneCaptures.Add(CreateSceneCapture(TEXT("PortalSceneCapture")));
+	}
+
+	// One per recursion level, each one cheaper than the previous
+	for (int32 Depth = RecursionCaptures.Num() + 1; Depth <= MaxRecursionDepth; Depth++)
+	{
+		USceneCaptureComponent2D* RecursionCapture = CreateSceneCapture(TEXT("PortalRecursionCapture"));
+		ApplyRecursionQuality(RecursionCapture, Depth);
+		RecursionCaptures.Add(RecursionCapture);
+	}
+
+	if (bPrewarmCaptures && PrewarmCapture == nullptr)
+	{
+		PrewarmCapture = CreateSceneCapture(TEXT("PortalPrewarmCapture"));
+	}
+}
+
+void APortalManager::UpdateQualitySettings()
+{
+	FPortalQualitySettings NewSettings = FPortalQualitySettings::Get();
+
+	if (NewSettings == QualitySettings)
+	{
+		return;
+	}
+
+	bool bNewRenderTargets = NewSettings.RequiresNewRenderTargets(QualitySettings);
+	QualitySettings = NewSettings;
+
+	//-----------------------------------
+	// Update the existing captures
+	//-----------------------------------
+	for (USceneCaptureComponent2D* SceneCapture : SceneCaptures)
+	{
+		QualitySettings.ApplyToSceneCapture(SceneCapture);
+	}
+
+	for (int32 Index = 0; Index < RecursionCaptures.Num(); Index++)
+	{
+		QualitySettings.ApplyToSceneCapture(RecursionCaptures[Index]);
+		ApplyRecursionQuality(RecursionCaptures[Index], Index + 1);
+	}
+
+	if (PrewarmCapture != nullptr)
+	{
+		QualitySettings.ApplyToSceneCapture(PrewarmCapture);
+	}
+
+	CreateSceneCaptures();
+
+	//-----------------------------------
+	// Build a new pool, the current one is
+	// used until the new one is complete
+	//-----------------------------------
+	if (bNewRenderTargets)
+	{
+		PreviousScreenSizeX = 0;
+		PreviousScreenSizeY = 0;
+		bHasPendingRenderTargets = false;
+
+		GeneratePortalTexture();
+	}
+}
+
+int32 APortalManager::GetMaxCaptures() const
+{
+	return QualitySettings.MaxCaptures > 0 ? QualitySettings.MaxCaptures : MaxCaptures;
+}
+
+USceneCaptureComponent2D* APortalManager::CreateSceneCapture(FName BaseName)
+{
+	USceneCaptureComponent2D* SceneCapture = NewObject<USceneCaptureComponent2D>(
+		this,
+		USceneCaptureComponent2D::StaticClass(),
+		MakeUniqueObjectName(this, USceneCaptureComponent2D::StaticClass(), BaseName)
+		);
+	check(SceneCapture);
 
-	SceneCapture = CreateDefaultSubobject<USceneCaptureComponent2D>(TEXT("PortalSceneCapture"));
-	SceneCapture->SetWorldLocation(FVector::ZeroVector);
 	SceneCapture->SetupAttachment(GetRootComponent());
-	
+	SceneCapture->SetWorldLocation(FVector::ZeroVector);
 
 	//------------------------------------------------
 	//Create Camera
@@ -31,67 +207,164 @@ APortalManager::APortalManager(const FObjectInitializer& ObjectInitializer)
 
 	SceneCapture->bCaptureEveryFrame = false;
 	SceneCapture->bCaptureOnMovement = false;
-	SceneCapture->LODDistanceFactor = 3; //Force bigger LODs for faster computations
 	SceneCapture->TextureTarget = nullptr;
 	SceneCapture->bEnableClipPlane = true;
 	SceneCapture->bUseCustomProjectionMatrix = true;
 	SceneCapture->CaptureSource = ESceneCaptureSource::SCS_SceneColorHDRNoAlpha;
 
-	//Setup Post-Process of SceneCapture (optimization : disable Motion Blur, etc)
-	FPostProcessSettings CaptureSettings;
+	// LODs, shadows and post-process (sg.PortalQuality)
+	QualitySettings.ApplyToSceneCapture(SceneCapture);
 
-	CaptureSettings.bOverride_AmbientOcclusionQuality = true;
-	CaptureSettings.bOverride_MotionBlurAmount = true;
-	CaptureSettings.bOverride_SceneFringeIntensity = true;
-	CaptureSettings.bOverride_GrainIntensity = true;
-	CaptureSettings.bOverride_ScreenSpaceReflectionQuality = true;
+	SceneCapture->RegisterComponent();
 
-	CaptureSettings.AmbientOcclusionQuality = 0.0f; //0=lowest quality..100=maximum quality
-	CaptureSettings.MotionBlurAmount = 0.0f; //0 = disabled
-	CaptureSettings.SceneFringeIntensity = 0.0f; //0 = disabled
-	CaptureSettings.GrainIntensity = 0.0f; //0 = disabled
-	CaptureSettings.ScreenSpaceReflectionQuality = 0.0f; //0 = disabled
+	return SceneCapture;
+}
+
+void APortalManager::ApplyRecursionQuality(USceneCaptureComponent2D* SceneCapture, int32 Depth)
+{
+	// Deeper views are smaller on screen : lower LODs and less features
+	SceneCapture->LODDistanceFactor = QualitySettings.LODDistanceFactor * (Depth + 1);
 
-	CaptureSettings.bOverride_ScreenPercentage = true;
-	CaptureSettings.ScreenPercentage = 100.0f;
+	SceneCapture->ShowFlags.SetBloom(false);
+	SceneCapture->ShowFlags.SetAmbientOcclusion(false);
+	SceneCapture->ShowFlags.SetScreenSpaceReflections(false);
+	SceneCapture->ShowFlags.SetEyeAdaptation(false);
 
-	SceneCapture->PostProcessSettings = CaptureSettings;
+	if (Depth >= 2)
+	{
+		SceneCapture->ShowFlags.SetDynamicShadows(false);
+		SceneCapture->ShowFlags.SetTranslucency(false);
+	}
 }
 
-void APortalManager::Init()
+void APortalManager::UnregisterPortal(APortal_Actor* Portal)
 {
-	//------------------------------------------------
-	//Create RTT Buffer
-	//------------------------------------------------
-	GeneratePortalTexture();
+	ActivePortals.RemoveAll([Portal](const FPortalView& View)
+	{
+		return View.Portal == Portal;
+	});
+
+	for (FPortalRenderTarget& RenderTarget : RenderTargetPool)
+	{
+		if (RenderTarget.Owner == Portal)
+		{
+			RenderTarget.Owner = nullptr;
+		}
+	}
+
+	if (PrewarmRenderTarget.Owner == Portal)
+	{
+		PrewarmRenderTarget.Owner = nullptr;
+		PrewarmRenderTarget.LastCaptureFrame = 0;
+	}
+
+	if (PrewarmSourcePortal == Portal)
+	{
+		PrewarmSourcePortal = nullptr;
+	}
+}
+
+APawn* APortalManager::GetViewPawn() const
+{
+	return ControllerOwner != nullptr ? ControllerOwner->GetPawn() : nullptr;
+}
+
+bool APortalManager::GetViewPoint(FVector& OutLocation, FRotator& OutRotation) const
+{
+	if (ControllerOwner == nullptr)
+	{
+		return false;
+	}
+
+	//-----------------------------------
+	// What the player sees this frame (the camera manager
+	// was updated before us), whatever pawn is possessed
+	//-----------------------------------
+	if (ControllerOwner->PlayerCameraManager != nullptr)
+	{
+		OutLocation = ControllerOwner->PlayerCameraManager->GetCameraLocation();
+		OutRotation = ControllerOwner->PlayerCameraManager->GetCameraRotation();
+		return true;
+	}
+
+	ControllerOwner->GetPlayerViewPoint(OutLocation, OutRotation);
+	return true;
 }
 
 void APortalManager::Update(float DeltaTime)
 {
+	SCOPE_PORTAL_STAT(Update);
+
+	PlayerIndex = GetPlayerIndex();
+
 	//-----------------------------------
-	// Generate Portal texture ?
+	// Build the render targets for a new viewport
+	// size or quality level, a few per frame
 	//-----------------------------------
-	UpdateDelay += DeltaTime;
+	UpdateQualitySettings();
+	UpdatePendingRenderTargets(1);
 
-	if (UpdateDelay > 1.0f)
+	APawn* ViewPawn = GetViewPawn();
+
+	if (bDetectPlayerCrossing && PortalSubsystem != nullptr && ViewPawn != nullptr
+		&& !PortalSubsystem->GetCrossingTracker().IsTracked(ViewPawn))
 	{
-		UpdateDelay = 0.0f;
-		GeneratePortalTexture();
+		PortalSubsystem->TrackCrossingActor(ViewPawn);
 	}
 
 	//-----------------------------------
-	// Find portals in the level and update them
+	// Find portals around the player and update them
 	//-----------------------------------
-	APortal_Actor* Portal = UpdatePortalsInWorld();
+	UpdateViewProjection();
+	UpdatePortalsInWorld();
+
+	{
+		SCOPE_PORTAL_STAT(Visibility);
+
+		for (const FPortalView& View : ActivePortals)
+		{
+			View.Portal->UpdateTargetVisibilitySet(VisibilityChecksPerFrame);
+		}
+	}
+
+	UpdateCaptures();
+
+	// Once the captures of this frame are done
+	UpdatePrewarmCapture(DeltaTime);
+
+	// Displays created by this update are hidden from the next frame
+	UpdateHiddenComponents();
+}
+
+void APortalManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FViewport::ViewportResizedEvent.Remove(ViewportResizedHandle);
+
+	if (PortalSubsystem != nullptr)
+	{
+		PortalSubsystem->UnregisterManager(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
 
-	if (Portal != nullptr)
+void APortalManager::OnViewportResized(FViewport* Viewport, uint32 Unused)
+{
+	if (ControllerOwner == nullptr
+		|| ControllerOwner->GetLocalPlayer() == nullptr
+		|| ControllerOwner->GetLocalPlayer()->ViewportClient == nullptr
+		|| ControllerOwner->GetLocalPlayer()->ViewportClient->Viewport != Viewport)
 	{
-		UpdateCapture(Portal);
+		return;
 	}
+
+	GeneratePortalTexture();
 }
 
 void APortalManager::GeneratePortalTexture()
 {
+	SCOPE_PORTAL_STAT(GenerateTexture);
+
 	int32 CurrentSizeX = 1920;
 	int32 CurrentSizeY = 1080;
 
@@ -100,184 +373,1617 @@ void APortalManager::GeneratePortalTexture()
 		ControllerOwner->GetViewportSize(CurrentSizeX, CurrentSizeY);
 	}
 
-	// Use a smaller size than the current 
+	// Use a smaller size than the current
 	// screen to reduce the performance impact
-	CurrentSizeX = FMath::Clamp(int(CurrentSizeX / 1.7), 128, 1920); //1920 / 1.5 = 1280
-	CurrentSizeY = FMath::Clamp(int(CurrentSizeY / 1.7), 128, 1080);
+	CurrentSizeX = FMath::Clamp(int(CurrentSizeX * QualitySettings.ResolutionScale), 128, 1920);
+	CurrentSizeY = FMath::Clamp(int(CurrentSizeY * QualitySettings.ResolutionScale), 128, 1080);
 
-	if (CurrentSizeX == PreviousScreenSizeX
-		&& CurrentSizeY == PreviousScreenSizeY)
+	FIntPoint CurrentSize = FIntPoint(CurrentSizeX, CurrentSizeY);
+	FIntPoint ExpectedSize = bHasPendingRenderTargets ? PendingScreenSize : FIntPoint(PreviousScreenSizeX, PreviousScreenSizeY);
+
+	if (CurrentSize == ExpectedSize)
 	{
 		return;
 	}
 
-	PreviousScreenSizeX = CurrentSizeX;
-	PreviousScreenSizeY = CurrentSizeY;
-
-
-	// Create the RenderTarget if it does not exist
-	if (PortalTexture == nullptr)
-	{
-		// Create new RTT
-		PortalTexture = NewObject<UTextureRenderTarget2D>(
-			this,
-			UTextureRenderTarget2D::StaticClass(),
-			*FString("PortalRenderTarget")
-			);
-		check(PortalTexture);
+	//-----------------------------------
+	// Start a new pool : the current one keeps being
+	// used until the new one is complete and swapped in
+	//-----------------------------------
+	PendingScreenSize = CurrentSize;
+	PendingRenderTargetPool.Reset();
+	PendingRecursionRenderTargets.Reset();
+	PendingPrewarmTexture = nullptr;
+	ComputeBucketCounts(PendingScreenSize, PendingBucketCounts);
+	bHasPendingRenderTargets = true;
+}
 
-		PortalTexture->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA16f;
-		PortalTexture->Filter = TextureFilter::TF_Bilinear;
-		PortalTexture->SizeX = CurrentSizeX;
-		PortalTexture->SizeY = CurrentSizeY;
-		PortalTexture->ClearColor = FLinearColor::Black;
-		PortalTexture->TargetGamma = 2.2f;
-		PortalTexture->bNeedsTwoCopies = false;
-		PortalTexture->AddressX = TextureAddress::TA_Clamp;
-		PortalTexture->AddressY = TextureAddress::TA_Clamp;
+void APortalManager::ComputeBucketCounts(const FIntPoint& BaseSize, TArray<int32>& OutBucketCounts) const
+{
+	//-----------------------------------
+	// One target per capture in each bucket, then remove
+	// targets from the biggest buckets until we fit the budget
+	//-----------------------------------
+	OutBucketCounts.Init(FMath::Max(GetMaxCaptures(), 1), ResolutionBuckets.Num());
 
-		// Not needed since the texture is displayed on screen directly
-		// in some engine versions this can even lead to crashes (notably 4.24/4.25)
-		PortalTexture->bAutoGenerateMips = false;
+	float PoolSizeMB = 0.0f;
 
-		// This force the engine to create the render target 
-		// with the parameters we defined just above
-		PortalTexture->UpdateResource();
+	for (int32 Bucket = 0; Bucket < ResolutionBuckets.Num(); Bucket++)
+	{
+		PoolSizeMB += OutBucketCounts[Bucket] * GetRenderTargetSizeMB(GetBucketSize(Bucket, BaseSize));
 	}
-	// Resize the RenderTarget if it already exists
-	else
+
+	for (int32 Bucket = 0; Bucket < ResolutionBuckets.Num() && PoolSizeMB > RenderTargetBudgetMB; Bucket++)
 	{
-		PortalTexture->ResizeTarget(CurrentSizeX, CurrentSizeY);
+		while (OutBucketCounts[Bucket] > 1 && PoolSizeMB > RenderTargetBudgetMB)
+		{
+			OutBucketCounts[Bucket]--;
+			PoolSizeMB -= GetRenderTargetSizeMB(GetBucketSize(Bucket, BaseSize));
+		}
 	}
 }
 
-APortal_Actor* APortalManager::UpdatePortalsInWorld()
+void APortalManager::UpdatePendingRenderTargets(int32 MaxAllocations)
 {
-	if (ControllerOwner == nullptr)
+	if (!bHasPendingRenderTargets)
 	{
-		return nullptr;
+		return;
 	}
 
-	APlayer_Character* Character = nullptr;
-
-	for (TActorIterator<APlayer_Character> ActorItr(GetWorld()); ActorItr; ++ActorItr)
-	{
-		Character = Cast<APlayer_Character>(*ActorItr);
-	}
+	SCOPE_PORTAL_STAT(RenderTargetPool);
 
 	//-----------------------------------
-	// Update Portal actors in the world (and active one if nearby)
+	// Allocate the missing targets of the pending pool
+	// (buckets are filled from the biggest to the smallest)
 	//-----------------------------------
-	APortal_Actor* ActivePortal = nullptr;
-	FVector PlayerLocation = Character->GetActorLocation();
-	float Distance = 4096.0f;
+	int32 Allocations = 0;
 
-	for (TActorIterator<APortal_Actor>ActorItr(GetWorld()); ActorItr; ++ActorItr)
+	for (int32 Bucket = 0; Bucket < PendingBucketCounts.Num() && Allocations < MaxAllocations; Bucket++)
 	{
-		APortal_Actor* Portal = *ActorItr;
-		FVector PortalLocation = Portal->GetActorLocation();
-		FVector PortalNormal = Portal->GetActorForwardVector();
-
-		// Reset Portal
-		Portal->ClearRTT();
-		Portal->SetActive(false);
+		FIntPoint BucketSize = GetBucketSize(Bucket, PendingScreenSize);
 
-		// Find the closest Portal when the player is Standing in front of
-		float NewDistance = FMath::Abs(FVector::Dist(PlayerLocation, PortalLocation));
+		int32 Count = PendingRenderTargetPool.FilterByPredicate([Bucket](const FPortalRenderTarget& RenderTarget)
+		{
+			return RenderTarget.Bucket == Bucket;
+		}).Num();
 
-		if (NewDistance < Distance)
+		for (; Count < PendingBucketCounts[Bucket] && Allocations < MaxAllocations; Count++, Allocations++)
 		{
-			Distance = NewDistance;
-			ActivePortal = Portal;
+			FPortalRenderTarget RenderTarget;
+			RenderTarget.Texture = CreatePortalTexture(BucketSize.X, BucketSize.Y);
+			RenderTarget.Bucket = Bucket;
+			PendingRenderTargetPool.Add(RenderTarget);
 		}
 	}
 
-	return ActivePortal;
-}
+	for (int32 Depth = PendingRecursionRenderTargets.Num() + 1; Depth <= MaxRecursionDepth && Allocations < MaxAllocations; Depth++, Allocations++)
+	{
+		FIntPoint RecursionSize = GetRecursionTargetSize(Depth, PendingScreenSize);
+		PendingRecursionRenderTargets.Add(CreatePortalTexture(RecursionSize.X, RecursionSize.Y));
+	}
 
-void APortalManager::UpdateCapture(APortal_Actor* Portal)
-{
-	if (ControllerOwner == nullptr)
+	// Swapped with the targets of the first bucket
+	if (bPrewarmCaptures && PendingPrewarmTexture == nullptr && Allocations < MaxAllocations)
 	{
-		return;
+		FIntPoint PrewarmSize = GetBucketSize(0, PendingScreenSize);
+		PendingPrewarmTexture = CreatePortalTexture(PrewarmSize.X, PrewarmSize.Y);
+		Allocations++;
 	}
 
-	APlayer_Character* Character = nullptr;
+	int32 ExpectedCount = 0;
+
+	for (int32 Count : PendingBucketCounts)
+	{
+		ExpectedCount += Count;
+	}
 
-	for (TActorIterator<APlayer_Character> ActorItr(GetWorld()); ActorItr; ++ActorItr)
+	if (PendingRenderTargetPool.Num() < ExpectedCount
+		|| PendingRecursionRenderTargets.Num() < MaxRecursionDepth
+		|| (bPrewarmCaptures && PendingPrewarmTexture == nullptr))
 	{
-		Character = Cast<APlayer_Character>(*ActorItr);
+		return;
 	}
+
 	//-----------------------------------
-	// Update SceneCapture (discard if there is no active portal)
+	// Swap the pools, the portals pick their new
+	// targets during their next capture
 	//-----------------------------------
-	if (SceneCapture != nullptr
-		&& PortalTexture != nullptr
-		&& Portal != nullptr
-		&& Character != nullptr)
+	for (const FPortalRenderTarget& RenderTarget : RenderTargetPool)
 	{
+		if (RenderTarget.Owner != nullptr)
+		{
+			RenderTarget.Owner->ClearPlayerRTT(PlayerIndex);
+		}
+	}
 
-		UCameraComponent* PlayerCamera = Character->GetFirstPersonCameraComponent();
-		AActor* Target = Portal->GetTarget();
+	RenderTargetPool = MoveTemp(PendingRenderTargetPool);
+	PendingRenderTargetPool.Reset();
 
-		//Place the SceneCapture to the Target
-		if (Target != nullptr)
-		{
-			//-------------------------------
-			// Compute new location in the space of the target actor
-			// (which may not be aligned to world)
-			//-------------------------------
-			FVector NewLocation = Portal->ConvertLocationToActorSpace(PlayerCamera->GetComponentLocation(),	Portal);
-			NewLocation = NewLocation.MirrorByPlane(FPlane(Target->GetActorLocation(), Target->GetActorForwardVector()));
-			NewLocation = NewLocation.MirrorByPlane(FPlane(Target->GetActorLocation(), Target->GetActorRightVector()));
-			
+	RecursionRenderTargets = MoveTemp(PendingRecursionRenderTargets);
+	PendingRecursionRenderTargets.Reset();
 
+	PrewarmRenderTarget = FPortalRenderTarget();
+	PrewarmRenderTarget.Texture = PendingPrewarmTexture;
+	PendingPrewarmTexture = nullptr;
+	PrewarmSourcePortal = nullptr;
 
-			SceneCapture->SetWorldLocation(NewLocation);
+	PreviousScreenSizeX = PendingScreenSize.X;
+	PreviousScreenSizeY = PendingScreenSize.Y;
 
-			//-------------------------------
-			//Clip Plane : to ignore objects between the
-			//SceneCapture and the Target of the portal
-			//-------------------------------
+	bHasPendingRenderTargets = false;
+}
 
-			SceneCapture->ClipPlaneNormal = Target->GetActorForwardVector();
-			SceneCapture->ClipPlaneBase = Target->GetActorLocation();
+UTextureRenderTarget2D* APortalManager::CreatePortalTexture(int32 SizeX, int32 SizeY)
+{
+	// Create new RTT
+	UTextureRenderTarget2D* PortalTexture = NewObject<UTextureRenderTarget2D>(
+		this,
+		UTextureRenderTarget2D::StaticClass(),
+		MakeUniqueObjectName(this, UTextureRenderTarget2D::StaticClass(), TEXT("PortalRenderTarget"))
+		);
+	check(PortalTexture);
 
-		}
+	PortalTexture->RenderTargetFormat = QualitySettings.TargetFormat;
+	PortalTexture->Filter = TextureFilter::TF_Bilinear;
+	PortalTexture->SizeX = SizeX;
+	PortalTexture->SizeY = SizeY;
+	PortalTexture->ClearColor = FLinearColor::Black;
+	PortalTexture->TargetGamma = 2.2f;
+	PortalTexture->bNeedsTwoCopies = false;
+	PortalTexture->AddressX = TextureAddress::TA_Clamp;
+	PortalTexture->AddressY = TextureAddress::TA_Clamp;
 
-		// Switch on the valid Portal
-		Portal->SetActive(true);
+	// Not needed since the texture is displayed on screen directly
+	// in some engine versions this can even lead to crashes (notably 4.24/4.25)
+	PortalTexture->bAutoGenerateMips = false;
 
-		// Assign the Render Target
-		Portal->SetRTT(PortalTexture);
-		SceneCapture->TextureTarget = PortalTexture;
+	// This force the engine to create the render target 
+	// with the parameters we defined just above
+	PortalTexture->UpdateResource();
+
+	return PortalTexture;
+}
 
-		// Get the Projection Matrix
-		SceneCapture->CustomProjectionMatrix = ControllerOwner->GetCameraProjectionMatrix();
+FIntPoint APortalManager::GetBucketSize(int32 Bucket, const FIntPoint& BaseSize) const
+{
+	float Scale = ResolutionBuckets.IsValidIndex(Bucket) ? ResolutionBuckets[Bucket] : 1.0f;
 
-		// Say Cheeeeese !
-		SceneCapture->CaptureScene();
+	return FIntPoint(
+		FMath::Max(FMath::RoundToInt(BaseSize.X * Scale), MinPortalResolution),
+		FMath::Max(FMath::RoundToInt(BaseSize.Y * Scale), MinPortalResolution));
+}
+
+FIntPoint APortalManager::GetRecursionTargetSize(int32 Depth, const FIntPoint& BaseSize) const
+{
+	// Start from the smallest bucket and shrink at every level
+	float Scale = ResolutionBuckets.Num() > 0 ? ResolutionBuckets.Last() : 1.0f;
+	Scale *= FMath::Pow(RecursionResolutionScale, Depth - 1);
+
+	return FIntPoint(
+		FMath::Max(FMath::RoundToInt(BaseSize.X * Scale), MinPortalResolution),
+		FMath::Max(FMath::RoundToInt(BaseSize.Y * Scale), MinPortalResolution));
+}
+
+float APortalManager::GetRenderTargetSizeMB(const FIntPoint& Size) const
+{
+	return float(Size.X) * float(Size.Y) * QualitySettings.GetBytesPerPixel() / (1024.0f * 1024.0f);
+}
+
+int32 APortalManager::SelectResolutionBucket(const FPortalView& View) const
+{
+	//-----------------------------------
+	// Fraction of the screen the Portal spans on its biggest axis
+	// (NDC are 2 units wide) : a portal spanning half of the screen
+	// gets a half resolution target, which keeps the on-screen pixel
+	// density when the capture is cropped to the portal
+	//-----------------------------------
+	FVector2D RectSize = View.ScreenRect.bIsValid ? View.ScreenRect.GetSize() : FVector2D::ZeroVector;
+	float ScreenFraction = FMath::Max(RectSize.X, RectSize.Y) / 2.0f;
+	float DesiredScale = FMath::Clamp(ScreenFraction * ResolutionQualityBias, MinResolutionScale, MaxResolutionScale);
+
+	// Buckets go from biggest to smallest : keep the smallest one that is big enough
+	int32 Selected = 0;
+
+	for (int32 Bucket = 0; Bucket < ResolutionBuckets.Num(); Bucket++)
+	{
+		if (ResolutionBuckets[Bucket] >= DesiredScale)
+		{
+			Selected = Bucket;
+		}
 	}
+
+	return Selected;
 }
 
+UTextureRenderTarget2D* APortalManager::AcquireRenderTarget(APortal_Actor* Portal, int32 Bucket)
+{
+	if (Portal == nullptr)
+	{
+		return nullptr;
+	}
+
+	FPortalRenderTarget* Selected = SelectRenderTarget(Portal, Bucket, true);
 
-void APortalManager::RequestTeleportByPortal(APortal_Actor* Portal, AActor* TargetToTeleport)
+	if (Selected == nullptr)
+	{
+		return nullptr;
+	}
+
+	ClaimRenderTarget(Portal, Bucket, *Selected);
+
+	return Selected->Texture;
+}
+
+FPortalRenderTarget* APortalManager::SelectRenderTarget(APortal_Actor* Portal, int32 Bucket, bool bOtherBuckets)
 {
-	if (Portal != nullptr && TargetToTeleport != nullptr)
+	const uint64 CurrentFrame = GFrameCounter;
+
+	//-----------------------------------
+	// Keep the target the Portal already displays if it is
+	// of the right size
+	//-----------------------------------
+	for (FPortalRenderTarget& RenderTarget : RenderTargetPool)
 	{
-		Portal->TeleportActor(TargetToTeleport);
+		if (RenderTarget.Owner == Portal && RenderTarget.Bucket == Bucket)
+		{
+			return &RenderTarget;
+		}
+	}
 
-		//-----------------------------------
-		//Force update
-		//-----------------------------------
-		APortal_Actor* FuturePortal = UpdatePortalsInWorld();
+	//-----------------------------------
+	// Otherwise reuse the least recently used one of the bucket
+	// (not rendered this frame and not kept by another active portal)
+	// falling back on smaller buckets, then bigger ones
+	//-----------------------------------
+	TArray<int32> BucketOrder;
+	BucketOrder.Add(Bucket);
+
+	if (bOtherBuckets)
+	{
+		for (int32 Smaller = Bucket + 1; Smaller < ResolutionBuckets.Num(); Smaller++)
+		{
+			BucketOrder.Add(Smaller);
+		}
 
-		if (FuturePortal != nullptr)
+		for (int32 Bigger = Bucket - 1; Bigger >= 0; Bigger--)
 		{
-			FuturePortal->ForceTick(); //Force update before the player render its view since he just teleported
-			UpdateCapture(FuturePortal);
+			BucketOrder.Add(Bigger);
 		}
 	}
+
+	FPortalRenderTarget* Selected = nullptr;
+
+	for (int32 CandidateBucket : BucketOrder)
+	{
+		for (FPortalRenderTarget& RenderTarget : RenderTargetPool)
+		{
+			// The Portal gives up its targets of other sizes when claiming
+			bool bOwnerIsActive = RenderTarget.Owner != nullptr
+				&& RenderTarget.Owner != Portal
+				&& ActivePortals.ContainsByPredicate([&RenderTarget](const FPortalView& View)
+				{
+					return View.Portal == RenderTarget.Owner;
+				});
+
+			if (RenderTarget.Bucket == CandidateBucket
+				&& RenderTarget.LastUsedFrame < CurrentFrame
+				&& !bOwnerIsActive
+				&& (Selected == nullptr || RenderTarget.LastUsedFrame < Selected->LastUsedFrame))
+			{
+				Selected = &RenderTarget;
+			}
+		}
+
+		if (Selected != nullptr)
+		{
+			break;
+		}
+	}
+
+	return Selected;
+}
+
+void APortalManager::ClaimRenderTarget(APortal_Actor* Portal, int32 Bucket, FPortalRenderTarget& Selected)
+{
+	bool bKept = Selected.Owner == Portal && Selected.Bucket == Bucket;
+
+	// Release the targets of the other sizes the Portal had
+	for (FPortalRenderTarget& RenderTarget : RenderTargetPool)
+	{
+		if (RenderTarget.Owner == Portal && &RenderTarget != &Selected)
+		{
+			RenderTarget.Owner = nullptr;
+		}
+	}
+
+	if (!bKept)
+	{
+		// Take it from its previous owner
+		if (Selected.Owner != nullptr && Selected.Owner != Portal)
+		{
+			Selected.Owner->ClearPlayerRTT(PlayerIndex);
+			Selected.Owner->SetPlayerActive(PlayerIndex, false);
+		}
+
+		Selected.Owner = Portal;
+		Selected.LastCaptureFrame = 0;
+	}
+
+	Selected.LastUsedFrame = GFrameCounter;
+}
+
+bool APortalManager::ComputePortalScreenRect(APortal_Actor* Portal, const FMatrix& ViewProjectionMatrix, FBox2D& OutRect) const
+{
+	FVector Origin;
+	FVector Extent;
+	Portal->GetActorBounds(false, Origin, Extent);
+
+	OutRect = FBox2D(ForceInit);
+	int32 CornersBehind = 0;
+
+	for (int32 Index = 0; Index < 8; Index++)
+	{
+		FVector Corner = Origin + Extent * FVector(
+			(Index & 1) ? 1.0f : -1.0f,
+			(Index & 2) ? 1.0f : -1.0f,
+			(Index & 4) ? 1.0f : -1.0f);
+
+		FPlane Projected = ViewProjectionMatrix.TransformFVector4(FVector4(Corner, 1.0f));
+
+		if (Projected.W <= KINDA_SMALL_NUMBER)
+		{
+			CornersBehind++;
+			continue;
+		}
+
+		OutRect += FVector2D(Projected.X / Projected.W, Projected.Y / Projected.W);
+	}
+
+	// Fully behind the camera
+	if (CornersBehind == 8)
+	{
+		return false;
+	}
+
+	// Partially behind the camera : the projection is unbounded,
+	// consider the portal as covering the whole screen
+	if (CornersBehind > 0)
+	{
+		OutRect = FBox2D(FVector2D(-1.0f, -1.0f), FVector2D(1.0f, 1.0f));
+		return true;
+	}
+
+	// Outside of the screen
+	if (OutRect.Max.X < -1.0f || OutRect.Min.X > 1.0f
+		|| OutRect.Max.Y < -1.0f || OutRect.Min.Y > 1.0f)
+	{
+		return false;
+	}
+
+	OutRect.Min = FVector2D(FMath::Max(OutRect.Min.X, -1.0f), FMath::Max(OutRect.Min.Y, -1.0f));
+	OutRect.Max = FVector2D(FMath::Min(OutRect.Max.X, 1.0f), FMath::Min(OutRect.Max.Y, 1.0f));
+
+	return true;
+}
+
+bool APortalManager::ScorePortal(APortal_Actor* Portal, const FVector& ViewLocation, const FMatrix* ViewProjectionMatrix, bool bKeepOffScreen, FPortalView& OutView) const
+{
+	OutView = FPortalView();
+	OutView.Portal = Portal;
+	OutView.Distance = FVector::Dist(ViewLocation, Portal->GetActorLocation());
+
+	if (OutView.Distance > MaxPortalDistance)
+	{
+		return false;
+	}
+
+	bool bOnScreen = ViewProjectionMatrix != nullptr && ComputePortalScreenRect(Portal, *ViewProjectionMatrix, OutView.ScreenRect);
+
+	if (!bOnScreen && !bKeepOffScreen)
+	{
+		return false;
+	}
+
+	if (bOnScreen)
+	{
+		// NDC screen area is 2x2
+		OutView.ScreenCoverage = OutView.ScreenRect.GetArea() / 4.0f;
+	}
+
+	// Standing in front of the Portal and not on its side
+	FVector ToViewer = (ViewLocation - Portal->GetActorLocation()).GetSafeNormal();
+	float Facing = FMath::Max(FVector::DotProduct(ToViewer, Portal->GetActorForwardVector()), 0.0f);
+
+	OutView.Score = DistanceWeight * (1.0f - OutView.Distance / MaxPortalDistance)
+		+ ScreenCoverageWeight * OutView.ScreenCoverage
+		+ FacingWeight * Facing;
+
+	OutView.Score *= Portal->CaptureImportance;
+
+	return true;
+}
+
+APortal_Actor* APortalManager::UpdatePortalsInWorld()
+{
+	SCOPE_PORTAL_STAT(Scan);
+
+	TArray<FPortalView> PreviousPortals = ActivePortals;
+	ActivePortals.Reset();
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+
+	if (PortalSubsystem != nullptr && GetViewPoint(ViewLocation, ViewRotation))
+	{
+		const FPortalRegistry& PortalRegistry = PortalSubsystem->GetRegistry();
+		FVector PlayerLocation = ViewLocation;
+
+		bool bHasView = bHasViewProjection;
+		FMatrix ViewProjectionMatrix = CameraViewProjectionMatrix;
+
+		// The closest Portal is always a candidate, even off-screen,
+		// so that it is ready when the player turns around
+		APortal_Actor* NearestPortal = PortalRegistry.FindNearest(PlayerLocation, MaxPortalDistance);
+
+		TArray<APortal_Actor*> Portals;
+		PortalRegistry.QuerySphere(PlayerLocation, MaxPortalDistance, Portals);
+
+		INC_PORTAL_COUNTER(PortalsConsidered, Portals.Num());
+
+		//-----------------------------------
+		// Score the Portals around the player
+		//-----------------------------------
+		for (APortal_Actor* Portal : Portals)
+		{
+			FPortalView View;
+
+			if (ScorePortal(Portal, PlayerLocation, bHasView ? &ViewProjectionMatrix : nullptr, Portal == NearestPortal, View))
+			{
+				ActivePortals.Add(View);
+			}
+		}
+
+		ActivePortals.Sort([](const FPortalView& A, const FPortalView& B)
+		{
+			return A.Score > B.Score;
+		});
+
+		//-----------------------------------
+		// Only keep what we can capture
+		//-----------------------------------
+		int32 MaxActivePortals = FMath::Min3(GetMaxCaptures(), SceneCaptures.Num(), RenderTargetPool.Num());
+
+		if (ActivePortals.Num() > MaxActivePortals)
+		{
+			ActivePortals.SetNum(MaxActivePortals);
+		}
+
+		for (int32 Index = 0; Index < ActivePortals.Num(); Index++)
+		{
+			ActivePortals[Index].ResolutionBucket = SelectResolutionBucket(ActivePortals[Index]);
+			ActivePortals[Index].UpdateRate = SelectUpdateRate(ActivePortals[Index], Index);
+		}
+	}
+
+	//-----------------------------------
+	// Reset the Portals that are not used anymore
+	//-----------------------------------
+	for (const FPortalView& PreviousView : PreviousPortals)
+	{
+		bool bStillActive = ActivePortals.ContainsByPredicate([&PreviousView](const FPortalView& View)
+		{
+			return View.Portal == PreviousView.Portal;
+		});
+
+		if (!bStillActive && PreviousView.Portal != nullptr)
+		{
+			PreviousView.Portal->ClearPlayerRTT(PlayerIndex);
+			PreviousView.Portal->SetPlayerActive(PlayerIndex, false);
+		}
+	}
+
+	return ActivePortals.Num() > 0 ? ActivePortals[0].Portal : nullptr;
+}
+
+void APortalManager::UpdateCaptures(bool bForceCapture)
+{
+	RecursionPixelsThisFrame = 0;
+	RecursionTimeThisFrame = 0.0;
+
+	for (int32 Index = 0; Index < ActivePortals.Num(); Index++)
+	{
+		UpdateCapture(ActivePortals[Index].Portal, Index, bForceCapture);
+	}
+}
+
+void APortalManager::UpdateCapture(APortal_Actor* Portal, int32 CaptureIndex, bool bForceCapture)
+{
+	SCOPE_PORTAL_STAT(CaptureSetup);
+
+	if (ControllerOwner == nullptr || !bHasViewProjection || !SceneCaptures.IsValidIndex(CaptureIndex))
+	{
+		return;
+	}
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	bool bHasView = GetViewPoint(ViewLocation, ViewRotation);
+
+	if (bHasView && !bForceCapture && UseSharedCapture(Portal, ViewLocation, ViewRotation))
+	{
+		return;
+	}
+
+	USceneCaptureComponent2D* SceneCapture = SceneCaptures[CaptureIndex];
+	const FPortalView* View = ActivePortals.FindByPredicate([Portal](const FPortalView& ActiveView)
+	{
+		return ActiveView.Portal == Portal;
+	});
+
+	int32 Bucket = View != nullptr ? View->ResolutionBucket : 0;
+	UTextureRenderTarget2D* PortalTexture = bHasView ? AcquireRenderTarget(Portal, Bucket) : nullptr;
+	FPortalRenderTarget* RenderTarget = FindRenderTarget(PortalTexture);
+
+	//-----------------------------------
+	// Update SceneCapture (discard if there is no active portal)
+	//-----------------------------------
+	if (SceneCapture != nullptr
+		&& PortalTexture != nullptr
+		&& RenderTarget != nullptr
+		&& Portal != nullptr
+		&& bHasView)
+	{
+
+		AActor* Target = Portal->GetTarget();
+		FVector CaptureLocation = ViewLocation;
+		FRotator CaptureRotation = ViewRotation;
+
+		//Place the SceneCapture to the Target
+		if (Target != nullptr)
+		{
+			CaptureLocation = ComputeCaptureLocation(Portal, ViewLocation);
+		}
+
+		// Get the Projection Matrix (both eyes in stereo)
+		FMatrix ProjectionMatrix = CameraProjectionMatrix;
+		FLinearColor UVRect = FLinearColor(0.0f, 0.0f, 1.0f, 1.0f);
+		FBox2D ScreenRect = View != nullptr ? View->ScreenRect : FBox2D(ForceInit);
+
+		// Only render the part of the view covered by the portal
+		if (bCropCaptureToPortal)
+		{
+			ProjectionMatrix = ComputeCroppedProjection(ProjectionMatrix, ScreenRect, UVRect);
+		}
+
+		// Switch on the valid Portal
+		Portal->SetPlayerActive(PlayerIndex, true);
+
+		// Assign the Render Target
+		Portal->SetPlayerRTT(PlayerIndex, PortalTexture);
+
+		//-----------------------------------
+		// Reuse the previous capture when nothing changed
+		// or when the portal is not due for an update
+		//-----------------------------------
+		EPortalUpdateRate UpdateRate = View != nullptr ? View->UpdateRate : EPortalUpdateRate::EveryFrame;
+		uint32 TargetSideHash = Target != nullptr ? ComputeTargetSideHash(Portal) : 0;
+		bool bUpdateRequested = Portal->ConsumeCaptureUpdateRequest();
+
+		if (!bForceCapture
+			&& !bUpdateRequested
+			&& !ShouldCapture(*RenderTarget, UpdateRate, CaptureLocation, CaptureRotation, ProjectionMatrix, TargetSideHash))
+		{
+			// Map the current screen position of the portal to where it was when captured
+			FLinearColor DisplayedUVRect = bReprojectSkippedCaptures ? ComputeReprojectedUVRect(*RenderTarget, ScreenRect) : RenderTarget->UVRect;
+			SetPortalUVRect(Portal, DisplayedUVRect);
+
+			FPortalRenderTarget DisplayedTarget = *RenderTarget;
+			DisplayedTarget.UVRect = DisplayedUVRect;
+			PublishCapture(Portal, DisplayedTarget);
+
+			INC_PORTAL_COUNTER(PortalsSkipped, 1);
+			return;
+		}
+
+		if (Target != nullptr)
+		{
+			SceneCapture->SetWorldLocationAndRotation(CaptureLocation, CaptureRotation);
+
+			//-------------------------------
+			//Clip Plane : to ignore objects between the
+			//SceneCapture and the Target of the portal
+			//-------------------------------
+
+			SceneCapture->ClipPlaneNormal = Target->GetActorForwardVector();
+			SceneCapture->ClipPlaneBase = Target->GetActorLocation();
+		}
+
+		SceneCapture->TextureTarget = PortalTexture;
+		SceneCapture->CustomProjectionMatrix = ProjectionMatrix;
+		ApplyTargetVisibility(SceneCapture, Portal);
+		SetPortalUVRect(Portal, UVRect);
+
+		// Remember what was captured
+		RenderTarget->UVRect = UVRect;
+		RenderTarget->CapturedScreenRect = ScreenRect;
+		RenderTarget->CaptureLocation = CaptureLocation;
+		RenderTarget->CaptureRotation = CaptureRotation;
+		RenderTarget->CaptureProjectionMatrix = ProjectionMatrix;
+		RenderTarget->TargetSideHash = TargetSideHash;
+		RenderTarget->LastCaptureFrame = GFrameCounter;
+
+		// Render the portals visible through this one first
+		APortal_Actor* RecursivePortal = nullptr;
+
+		if (Target != nullptr)
+		{
+			SCOPE_PORTAL_STAT(Recursion);
+			RecursivePortal = UpdateRecursiveCapture(Portal, CaptureLocation, ProjectionMatrix, 1);
+		}
+
+		// Say Cheeeeese !
+		RenderCapture(SceneCapture);
+
+		INC_PORTAL_COUNTER(PortalsCaptured, 1);
+
+		RestorePortalTexture(RecursivePortal);
+		PublishCapture(Portal, *RenderTarget);
+	}
+}
+
+bool APortalManager::ShouldCapture(const FPortalRenderTarget& RenderTarget, EPortalUpdateRate UpdateRate, const FVector& CaptureLocation, const FRotator& CaptureRotation, const FMatrix& ProjectionMatrix, uint32 TargetSideHash) const
+{
+	// Never captured since it was given to this portal
+	if (RenderTarget.LastCaptureFrame == 0)
+	{
+		return true;
+	}
+
+	bool bDirty = !RenderTarget.CaptureLocation.Equals(CaptureLocation, CaptureLocationTolerance)
+		|| !RenderTarget.CaptureRotation.Equals(CaptureRotation, CaptureRotationTolerance)
+		|| !RenderTarget.CaptureProjectionMatrix.Equals(ProjectionMatrix, KINDA_SMALL_NUMBER)
+		|| RenderTarget.TargetSideHash != TargetSideHash;
+
+	if (!bDirty)
+	{
+		return false;
+	}
+
+	// The quality level can lower the capture rate of every portal
+	uint64 FramesSinceCapture = GFrameCounter - RenderTarget.LastCaptureFrame;
+	uint64 CaptureInterval = uint64(QualitySettings.CaptureInterval);
+
+	switch (UpdateRate)
+	{
+	case EPortalUpdateRate::EveryNthFrame:
+		return FramesSinceCapture >= uint64(FMath::Max(ReducedRateInterval, 1)) * CaptureInterval;
+
+	case EPortalUpdateRate::OnDemand:
+		return FramesSinceCapture >= uint64(FMath::Max(OnDemandInterval, 1)) * CaptureInterval;
+
+	default:
+		return FramesSinceCapture >= CaptureInterval;
+	}
+}
+
+uint32 APortalManager::ComputeTargetSideHash(APortal_Actor* Portal) const
+{
+	AActor* Target = Portal->GetTarget();
+
+	if (Target == nullptr || TargetSideCheckRadius <= 0.0f)
+	{
+		return 0;
+	}
+
+	//-----------------------------------
+	// Movable things around the target, combined in
+	// an order independent way (overlaps are not sorted)
+	//-----------------------------------
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_Pawn);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+
+	TArray<FOverlapResult> Overlaps;
+	GetWorld()->OverlapMultiByObjectType(Overlaps,
+		Target->GetActorLocation(),
+		FQuat::Identity,
+		ObjectParams,
+		FCollisionShape::MakeSphere(TargetSideCheckRadius),
+		FCollisionQueryParams(SCENE_QUERY_STAT(PortalTargetSide), false));
+
+	uint32 Hash = 0;
+
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		UPrimitiveComponent* Component = Overlap.GetComponent();
+
+		if (Component == nullptr || Component->Mobility != EComponentMobility::Movable)
+		{
+			continue;
+		}
+
+		FVector Location = Component->GetComponentLocation();
+		FVector Direction = Component->GetForwardVector() * 100.0f;
+
+		uint32 ComponentHash = GetTypeHash(Component);
+		ComponentHash = HashCombine(ComponentHash, GetTypeHash(FIntVector(FMath::RoundToInt(Location.X), FMath::RoundToInt(Location.Y), FMath::RoundToInt(Location.Z))));
+		ComponentHash = HashCombine(ComponentHash, GetTypeHash(FIntVector(FMath::RoundToInt(Direction.X), FMath::RoundToInt(Direction.Y), FMath::RoundToInt(Direction.Z))));
+
+		Hash += ComponentHash;
+	}
+
+	return Hash;
+}
+
+FLinearColor APortalManager::ComputeReprojectedUVRect(const FPortalRenderTarget& RenderTarget, const FBox2D& ScreenRect) const
+{
+	if (!ScreenRect.bIsValid || !RenderTarget.CapturedScreenRect.bIsValid)
+	{
+		return RenderTarget.UVRect;
+	}
+
+	FVector2D NowSize = ScreenRect.GetSize();
+	FVector2D ThenSize = RenderTarget.CapturedScreenRect.GetSize();
+
+	if (NowSize.X <= KINDA_SMALL_NUMBER || NowSize.Y <= KINDA_SMALL_NUMBER)
+	{
+		return RenderTarget.UVRect;
+	}
+
+	//-----------------------------------
+	// Screen UV now -> screen UV at capture time (portal rect onto portal rect)
+	// -> texture UV through the UVRect used for the capture.
+	// Everything is affine per axis : Sampled = ScreenUV * A + B
+	// and the material computes (ScreenUV - RG) / BA, so BA = 1 / A and RG = -B / A
+	//-----------------------------------
+	FVector2D NowMinUV = FVector2D((ScreenRect.Min.X + 1.0f) * 0.5f, (1.0f - ScreenRect.Max.Y) * 0.5f);
+	FVector2D ThenMinUV = FVector2D((RenderTarget.CapturedScreenRect.Min.X + 1.0f) * 0.5f, (1.0f - RenderTarget.CapturedScreenRect.Max.Y) * 0.5f);
+	FVector2D Ratio = FVector2D(ThenSize.X / NowSize.X, ThenSize.Y / NowSize.Y);
+
+	FVector2D A = FVector2D(Ratio.X / RenderTarget.UVRect.B, Ratio.Y / RenderTarget.UVRect.A);
+	FVector2D B = FVector2D(
+		(ThenMinUV.X - NowMinUV.X * Ratio.X - RenderTarget.UVRect.R) / RenderTarget.UVRect.B,
+		(ThenMinUV.Y - NowMinUV.Y * Ratio.Y - RenderTarget.UVRect.G) / RenderTarget.UVRect.A);
+
+	return FLinearColor(-B.X / A.X, -B.Y / A.Y, 1.0f / A.X, 1.0f / A.Y);
+}
+
+EPortalUpdateRate APortalManager::SelectUpdateRate(const FPortalView& View, int32 Rank) const
+{
+	// The most important portal is always kept up to date
+	if (Rank == 0)
+	{
+		return EPortalUpdateRate::EveryFrame;
+	}
+
+	if (View.ScreenCoverage < OnDemandScreenCoverage)
+	{
+		return EPortalUpdateRate::OnDemand;
+	}
+
+	if (View.Distance > ReducedRateDistance)
+	{
+		return EPortalUpdateRate::EveryNthFrame;
+	}
+
+	return EPortalUpdateRate::EveryFrame;
+}
+
+FVector APortalManager::ComputeCaptureLocation(APortal_Actor* Portal, const FVector& ViewLocation) const
+{
+	//-------------------------------
+	// Compute new location in the space of the target actor
+	// (which may not be aligned to world), mirrored by its
+	// forward and right planes (cached by the portal)
+	//-------------------------------
+	return Portal->GetViewLinkMatrix().TransformPosition(ViewLocation);
+}
+
+FMatrix APortalManager::ComputeCroppedProjection(const FMatrix& ProjectionMatrix, const FBox2D& ScreenRect, FLinearColor& OutUVRect) const
+{
+	OutUVRect = FLinearColor(0.0f, 0.0f, 1.0f, 1.0f);
+
+	if (!ScreenRect.bIsValid)
+	{
+		return ProjectionMatrix;
+	}
+
+	// Grow the rect a bit so bilinear filtering does not read outside of it
+	FVector2D RectMin = FVector2D(
+		FMath::Max(ScreenRect.Min.X - CropMargin, -1.0f),
+		FMath::Max(ScreenRect.Min.Y - CropMargin, -1.0f));
+	FVector2D RectMax = FVector2D(
+		FMath::Min(ScreenRect.Max.X + CropMargin, 1.0f),
+		FMath::Min(ScreenRect.Max.Y + CropMargin, 1.0f));
+	FVector2D RectSize = RectMax - RectMin;
+
+	if (RectSize.X <= KINDA_SMALL_NUMBER || RectSize.Y <= KINDA_SMALL_NUMBER)
+	{
+		return ProjectionMatrix;
+	}
+
+	//-----------------------------------
+	// Scale and offset the clip space so the rect
+	// fills the whole render target :
+	// NDC' = (NDC - RectCenter) * 2 / RectSize
+	//-----------------------------------
+	FVector2D Scale = FVector2D(2.0f / RectSize.X, 2.0f / RectSize.Y);
+	FVector2D Center = (RectMin + RectMax) * 0.5f;
+
+	FMatrix CropMatrix = FMatrix(
+		FPlane(Scale.X, 0.0f, 0.0f, 0.0f),
+		FPlane(0.0f, Scale.Y, 0.0f, 0.0f),
+		FPlane(0.0f, 0.0f, 1.0f, 0.0f),
+		FPlane(-Center.X * Scale.X, -Center.Y * Scale.Y, 0.0f, 1.0f));
+
+	// Screen UVs have Y pointing down : R,G = top-left corner, B,A = size
+	OutUVRect = FLinearColor(
+		(RectMin.X + 1.0f) * 0.5f,
+		(1.0f - RectMax.Y) * 0.5f,
+		RectSize.X * 0.5f,
+		RectSize.Y * 0.5f);
+
+	return ProjectionMatrix * CropMatrix;
+}
+
+APortal_Actor* APortalManager::UpdateRecursiveCapture(APortal_Actor* ParentPortal, const FVector& ViewLocation, const FMatrix& ProjectionMatrix, int32 Depth)
+{
+	if (Depth > MaxRecursionDepth
+		|| PortalSubsystem == nullptr
+		|| !RecursionCaptures.IsValidIndex(Depth - 1)
+		|| !RecursionRenderTargets.IsValidIndex(Depth - 1)
+		|| RecursionPixelsThisFrame >= RecursionPixelBudget
+		|| RecursionTimeThisFrame * 1000.0 >= RecursionTimeBudgetMs)
+	{
+		return nullptr;
+	}
+
+	double StartTime = FPlatformTime::Seconds();
+
+	AActor* ParentTarget = ParentPortal->GetTarget();
+
+	//-----------------------------------
+	// View used by the parent capture, the recursion renders
+	// with the same (possibly cropped) projection so that it lines
+	// up with where the portal is drawn in the parent target
+	//-----------------------------------
+	FVector CameraLocation;
+	FRotator ViewRotation;
+	GetViewPoint(CameraLocation, ViewRotation);
+
+	FMatrix ViewProjectionMatrix = MakeViewMatrix(ViewLocation, ViewRotation) * ProjectionMatrix;
+
+	//-----------------------------------
+	// Find the biggest portal on screen in front of the parent target
+	// (only one branch per level to keep the cost bounded)
+	//-----------------------------------
+	TArray<APortal_Actor*> Portals;
+	PortalSubsystem->GetRegistry().QuerySphere(ViewLocation, MaxPortalDistance, Portals);
+
+	APortal_Actor* RecursivePortal = nullptr;
+	float RecursiveCoverage = 0.0f;
+
+	for (APortal_Actor* Portal : Portals)
+	{
+		FVector PortalLocation = Portal->GetActorLocation();
+
+		// Clipped by the parent capture
+		if (FVector::DotProduct(PortalLocation - ParentTarget->GetActorLocation(), ParentTarget->GetActorForwardVector()) <= 0.0f)
+		{
+			continue;
+		}
+
+		// Seen from behind
+		if (FVector::DotProduct(ViewLocation - PortalLocation, Portal->GetActorForwardVector()) <= 0.0f)
+		{
+			continue;
+		}
+
+		FBox2D ScreenRect;
+
+		if (Portal->GetTarget() == nullptr || !ComputePortalScreenRect(Portal, ViewProjectionMatrix, ScreenRect))
+		{
+			continue;
+		}
+
+		float Coverage = ScreenRect.GetArea() / 4.0f;
+
+		if (Coverage > RecursiveCoverage)
+		{
+			RecursiveCoverage = Coverage;
+			RecursivePortal = Portal;
+		}
+	}
+
+	if (RecursivePortal == nullptr)
+	{
+		RecursionTimeThisFrame += FPlatformTime::Seconds() - StartTime;
+		return nullptr;
+	}
+
+	USceneCaptureComponent2D* RecursionCapture = RecursionCaptures[Depth - 1];
+	UTextureRenderTarget2D* RecursionTexture = RecursionRenderTargets[Depth - 1];
+	AActor* Target = RecursivePortal->GetTarget();
+	FVector CaptureLocation = ComputeCaptureLocation(RecursivePortal, ViewLocation);
+
+	RecursionCapture->SetWorldLocationAndRotation(CaptureLocation, ViewRotation);
+	RecursionCapture->ClipPlaneNormal = Target->GetActorForwardVector();
+	RecursionCapture->ClipPlaneBase = Target->GetActorLocation();
+	RecursionCapture->TextureTarget = RecursionTexture;
+	RecursionCapture->CustomProjectionMatrix = ProjectionMatrix;
+	ApplyTargetVisibility(RecursionCapture, RecursivePortal);
+
+	RecursionPixelsThisFrame += RecursionTexture->SizeX * RecursionTexture->SizeY;
+	RecursionTimeThisFrame += FPlatformTime::Seconds() - StartTime;
+
+	// Deepest level first
+	APortal_Actor* DeeperPortal = UpdateRecursiveCapture(RecursivePortal, CaptureLocation, ProjectionMatrix, Depth + 1);
+
+	StartTime = FPlatformTime::Seconds();
+
+	RenderCapture(RecursionCapture);
+
+	INC_PORTAL_COUNTER(PortalRecursiveCaptures, 1);
+
+	RestorePortalTexture(DeeperPortal);
+
+	// The parent capture sees this level (mono view)
+	RecursivePortal->SetPlayerRTT(PlayerIndex, RecursionTexture);
+	RecursivePortal->SetPlayerUVRects(PlayerIndex, FLinearColor(0.0f, 0.0f, 1.0f, 1.0f), FLinearColor(0.0f, 0.0f, 1.0f, 1.0f));
+
+	RecursionTimeThisFrame += FPlatformTime::Seconds() - StartTime;
+
+	return RecursivePortal;
+}
+
+FMatrix APortalManager::MakeViewMatrix(const FVector& ViewLocation, const FRotator& ViewRotation)
+{
+	// Same axes as FSceneView : X right, Y up, Z forward
+	return FTranslationMatrix(-ViewLocation)
+		* FInverseRotationMatrix(ViewRotation)
+		* FMatrix(
+			FPlane(0, 0, 1, 0),
+			FPlane(1, 0, 0, 0),
+			FPlane(0, 1, 0, 0),
+			FPlane(0, 0, 0, 1));
+}
+
+void APortalManager::UpdateViewProjection()
+{
+	bHasViewProjection = false;
+	bStereoView = false;
+
+	if (ControllerOwner == nullptr)
+	{
+		return;
+	}
+
+	FSceneViewProjectionData ProjectionData;
+
+	if (!ControllerOwner->GetCameraProjectionData(ProjectionData))
+	{
+		return;
+	}
+
+	CameraProjectionMatrix = ProjectionData.ProjectionMatrix;
+
+	//-----------------------------------
+	// Stereo : keep the center view and widen the
+	// projection so that the capture covers both eyes
+	//-----------------------------------
+	FSceneViewProjectionData LeftProjectionData;
+	FSceneViewProjectionData RightProjectionData;
+
+	if (ControllerOwner->IsStereoRendering()
+		&& ControllerOwner->GetCameraProjectionData(LeftProjectionData, eSSP_LEFT_EYE)
+		&& ControllerOwner->GetCameraProjectionData(RightProjectionData, eSSP_RIGHT_EYE))
+	{
+		EyeProjectionMatrices[0] = LeftProjectionData.ProjectionMatrix;
+		EyeProjectionMatrices[1] = RightProjectionData.ProjectionMatrix;
+		CameraProjectionMatrix = CombineEyeProjections(EyeProjectionMatrices[0], EyeProjectionMatrices[1]);
+		ProjectionData.ProjectionMatrix = CameraProjectionMatrix;
+		bStereoView = true;
+	}
+
+	CameraViewProjectionMatrix = ProjectionData.ComputeViewProjectionMatrix();
+	bHasViewProjection = true;
+}
+
+FMatrix APortalManager::CombineEyeProjections(const FMatrix& LeftProjection, const FMatrix& RightProjection)
+{
+	//-----------------------------------
+	// NDC.X = M[0][0] * X/Z + M[2][0] (same for Y with M[1][1] and M[2][1])
+	// so each frustum spans the tangents (+-1 - M[2][i]) / M[i][i],
+	// keep the union of both (the depth part is shared)
+	//-----------------------------------
+	FMatrix Combined = LeftProjection;
+
+	for (int32 Axis = 0; Axis < 2; Axis++)
+	{
+		float Min = FMath::Min(
+			(-1.0f - LeftProjection.M[2][Axis]) / LeftProjection.M[Axis][Axis],
+			(-1.0f - RightProjection.M[2][Axis]) / RightProjection.M[Axis][Axis]);
+		float Max = FMath::Max(
+			(1.0f - LeftProjection.M[2][Axis]) / LeftProjection.M[Axis][Axis],
+			(1.0f - RightProjection.M[2][Axis]) / RightProjection.M[Axis][Axis]);
+
+		Combined.M[Axis][Axis] = 2.0f / (Max - Min);
+		Combined.M[2][Axis] = -(Max + Min) / (Max - Min);
+	}
+
+	return Combined;
+}
+
+FLinearColor APortalManager::ConvertUVRectToEye(const FLinearColor& UVRect, const FMatrix& ViewProjection, const FMatrix& EyeProjection)
+{
+	//-----------------------------------
+	// Both projections look at the same tangents : per axis
+	// ViewUV = EyeUV * Scale + Offset, and the material computes
+	// (ViewUV - RG) / BA = (EyeUV - (RG - Offset) / Scale) / (BA / Scale)
+	//-----------------------------------
+	float ScaleX = ViewProjection.M[0][0] / EyeProjection.M[0][0];
+	float ScaleY = ViewProjection.M[1][1] / EyeProjection.M[1][1];
+	float OffsetX = (ViewProjection.M[2][0] + 1.0f - ScaleX * (EyeProjection.M[2][0] + 1.0f)) * 0.5f;
+
+	// Screen UVs have Y pointing down
+	float OffsetY = (1.0f - ViewProjection.M[2][1] - ScaleY * (1.0f - EyeProjection.M[2][1])) * 0.5f;
+
+	return FLinearColor(
+		(UVRect.R - OffsetX) / ScaleX,
+		(UVRect.G - OffsetY) / ScaleY,
+		UVRect.B / ScaleX,
+		UVRect.A / ScaleY);
+}
+
+void APortalManager::SetPortalUVRect(APortal_Actor* Portal, const FLinearColor& UVRect) const
+{
+	if (!bStereoView)
+	{
+		Portal->SetPlayerUVRects(PlayerIndex, UVRect, UVRect);
+		return;
+	}
+
+	Portal->SetPlayerUVRects(PlayerIndex,
+		ConvertUVRectToEye(UVRect, CameraProjectionMatrix, EyeProjectionMatrices[0]),
+		ConvertUVRectToEye(UVRect, CameraProjectionMatrix, EyeProjectionMatrices[1]));
+}
+
+int32 APortalManager::GetPlayerIndex() const
+{
+	ULocalPlayer* LocalPlayer = ControllerOwner != nullptr ? ControllerOwner->GetLocalPlayer() : nullptr;
+	UGameInstance* GameInstance = GetGameInstance();
+
+	if (LocalPlayer == nullptr || GameInstance == nullptr)
+	{
+		return 0;
+	}
+
+	return FMath::Max(GameInstance->GetLocalPlayers().IndexOfByKey(LocalPlayer), 0);
+}
+
+const TArray<TWeakObjectPtr<UPrimitiveComponent>>& APortalManager::GetHiddenPortalDisplays() const
+{
+	return HiddenPortalDisplays;
+}
+
+void APortalManager::UpdateHiddenComponents()
+{
+	if (PortalSubsystem == nullptr)
+	{
+		return;
+	}
+
+	const TArray<TWeakObjectPtr<UPrimitiveComponent>>& HiddenEffects = PortalSubsystem->GetCaptureHiddenEffects();
+	bool bSplitscreen = PortalSubsystem->IsSplitscreen();
+
+	// Nothing hidden, before or now
+	if (!bSplitscreen && HiddenEffects.Num() == 0 && CaptureHiddenComponents.Num() == 0)
+	{
+		return;
+	}
+
+	if (bSplitscreen || HiddenPortalDisplays.Num() > 0)
+	{
+		TArray<APortal_Actor*> Portals;
+		TArray<UPrimitiveComponent*> Displays;
+		PortalSubsystem->GetRegistry().GetPortals(Portals);
+
+		for (APortal_Actor* Portal : Portals)
+		{
+			Portal->GetHiddenDisplays(PlayerIndex, Displays);
+		}
+
+		HiddenPortalDisplays.Reset();
+
+		for (UPrimitiveComponent* Display : Displays)
+		{
+			HiddenPortalDisplays.Add(Display);
+		}
+	}
+
+	// Each player renders the portals seen in its captures with its own textures
+	CaptureHiddenComponents = HiddenPortalDisplays;
+	CaptureHiddenComponents.Append(HiddenEffects);
+
+	for (USceneCaptureComponent2D* SceneCapture : SceneCaptures)
+	{
+		SceneCapture->HiddenComponents = CaptureHiddenComponents;
+	}
+
+	for (USceneCaptureComponent2D* RecursionCapture : RecursionCaptures)
+	{
+		RecursionCapture->HiddenComponents = CaptureHiddenComponents;
+	}
+
+	if (PrewarmCapture != nullptr)
+	{
+		PrewarmCapture->HiddenComponents = CaptureHiddenComponents;
+	}
+}
+
+// View for FPortalEffects, PixelScale from the projection that rendered the
+// pixels, the cone from the full camera (a cropped capture is inside it)
+static FPortalEffectView MakeEffectView(const FVector& Location, const FRotator& Rotation, const FMatrix& ProjectionMatrix, const FMatrix& ConeProjectionMatrix, int32 Width, bool bCapture)
+{
+	FPortalEffectView View;
+	View.Location = Location;
+	View.Direction = Rotation.Vector();
+	View.PixelScale = ProjectionMatrix.M[0][0] * Width * 0.5f;
+	View.CosHalfFOV = FMath::Cos(FMath::Atan(1.0f / FMath::Max(ConeProjectionMatrix.M[0][0], KINDA_SMALL_NUMBER)));
+	View.bCapture = bCapture;
+
+	return View;
+}
+
+void APortalManager::GetEffectViews(TArray<FPortalEffectView>& OutViews) const
+{
+	FVector ViewLocation;
+	FRotator ViewRotation;
+
+	if (!bHasViewProjection || PreviousScreenSizeX <= 0 || !GetViewPoint(ViewLocation, ViewRotation))
+	{
+		return;
+	}
+
+	OutViews.Add(MakeEffectView(ViewLocation, ViewRotation, CameraProjectionMatrix, CameraProjectionMatrix, PreviousScreenSizeX, false));
+
+	// The captures displayed this frame, in texture pixels
+	for (const FPortalRenderTarget& RenderTarget : RenderTargetPool)
+	{
+		if (RenderTarget.Owner != nullptr
+			&& RenderTarget.Texture != nullptr
+			&& RenderTarget.LastCaptureFrame != 0
+			&& RenderTarget.LastUsedFrame == GFrameCounter)
+		{
+			OutViews.Add(MakeEffectView(RenderTarget.CaptureLocation, RenderTarget.CaptureRotation, RenderTarget.CaptureProjectionMatrix, CameraProjectionMatrix, RenderTarget.Texture->SizeX, true));
+		}
+	}
+}
+
+bool APortalManager::UseSharedCapture(APortal_Actor* Portal, const FVector& ViewLocation, const FRotator& ViewRotation)
+{
+	if (Portal == nullptr || Portal->GetTarget() == nullptr || PortalSubsystem == nullptr || !PortalSubsystem->IsSplitscreen())
+	{
+		return false;
+	}
+
+	const FPortalSharedCapture* SharedCapture = PortalSubsystem->FindSharedCapture(Portal,
+		this,
+		ComputeCaptureLocation(Portal, ViewLocation),
+		ViewRotation,
+		CameraProjectionMatrix);
+
+	if (SharedCapture == nullptr)
+	{
+		return false;
+	}
+
+	Portal->SetPlayerActive(PlayerIndex, true);
+	Portal->SetPlayerRTT(PlayerIndex, SharedCapture->Texture);
+	SetPortalUVRect(Portal, SharedCapture->UVRect);
+
+	INC_PORTAL_COUNTER(PortalsShared, 1);
+
+	return true;
+}
+
+void APortalManager::PublishCapture(APortal_Actor* Portal, const FPortalRenderTarget& RenderTarget)
+{
+	if (PortalSubsystem == nullptr || !PortalSubsystem->IsSplitscreen())
+	{
+		return;
+	}
+
+	FPortalSharedCapture Capture;
+	Capture.Portal = Portal;
+	Capture.Manager = this;
+	Capture.Texture = RenderTarget.Texture;
+	Capture.CaptureLocation = RenderTarget.CaptureLocation;
+	Capture.CaptureRotation = RenderTarget.CaptureRotation;
+	Capture.ProjectionMatrix = CameraProjectionMatrix;
+	Capture.UVRect = RenderTarget.UVRect;
+
+	PortalSubsystem->PublishCapture(Capture);
+}
+
+void APortalManager::RenderCapture(USceneCaptureComponent2D* SceneCapture)
+{
+	SCOPE_PORTAL_STAT(CaptureScene);
+
+	FPortalGpuTimer* GpuTimer = PortalSubsystem != nullptr ? &PortalSubsystem->GetGpuTimer() : nullptr;
+
+	if (GpuTimer != nullptr)
+	{
+		GpuTimer->BeginCapture();
+	}
+
+	SceneCapture->CaptureScene();
+
+	if (GpuTimer != nullptr)
+	{
+		GpuTimer->EndCapture();
+	}
+}
+
+float APortalManager::GetRenderTargetMemoryMB() const
+{
+	TArray<UTextureRenderTarget2D*> Textures = RecursionRenderTargets;
+	Textures.Append(PendingRecursionRenderTargets);
+	Textures.Add(PrewarmRenderTarget.Texture);
+	Textures.Add(PendingPrewarmTexture);
+
+	for (const FPortalRenderTarget& RenderTarget : RenderTargetPool)
+	{
+		Textures.Add(RenderTarget.Texture);
+	}
+
+	for (const FPortalRenderTarget& RenderTarget : PendingRenderTargetPool)
+	{
+		Textures.Add(RenderTarget.Texture);
+	}
+
+	float MemoryMB = 0.0f;
+
+	for (UTextureRenderTarget2D* Texture : Textures)
+	{
+		if (Texture != nullptr)
+		{
+			MemoryMB += GetRenderTargetSizeMB(FIntPoint(Texture->SizeX, Texture->SizeY));
+		}
+	}
+
+	return MemoryMB;
+}
+
+void APortalManager::ApplyTargetVisibility(USceneCaptureComponent2D* SceneCapture, APortal_Actor* Portal)
+{
+	FCaptureVisibilityState& State = CaptureVisibilityStates.FindOrAdd(SceneCapture);
+	int32 Version = Portal->GetTargetVisibilityVersion();
+
+	// Same lists as the last capture, nothing to copy
+	if (State.Portal == Portal && State.Version == Version)
+	{
+		return;
+	}
+
+	State.Portal = Portal;
+	State.Version = Version;
+
+	//-----------------------------------
+	// Render only what is on the target side
+	// instead of the whole scene
+	//-----------------------------------
+	if (Portal->bUseTargetVisibilitySet)
+	{
+		SceneCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
+		SceneCapture->ShowOnlyActors = Portal->TargetVisibleActors;
+	}
+	else
+	{
+		SceneCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_RenderScenePrimitives;
+		SceneCapture->ShowOnlyActors.Reset();
+	}
+
+	SceneCapture->HiddenActors = Portal->TargetHiddenActors;
+}
+
+FPortalRenderTarget* APortalManager::FindRenderTarget(UTextureRenderTarget2D* Texture)
+{
+	if (Texture == nullptr)
+	{
+		return nullptr;
+	}
+
+	return RenderTargetPool.FindByPredicate([Texture](const FPortalRenderTarget& RenderTarget)
+	{
+		return RenderTarget.Texture == Texture;
+	});
+}
+
+void APortalManager::RestorePortalTexture(APortal_Actor* Portal)
+{
+	if (Portal == nullptr)
+	{
+		return;
+	}
+
+	for (const FPortalRenderTarget& RenderTarget : RenderTargetPool)
+	{
+		if (RenderTarget.Owner == Portal)
+		{
+			Portal->SetPlayerRTT(PlayerIndex, RenderTarget.Texture);
+			SetPortalUVRect(Portal, RenderTarget.UVRect);
+			return;
+		}
+	}
+
+	Portal->ClearPlayerRTT(PlayerIndex);
+}
+
+
+void APortalManager::RequestTeleportByPortal(APortal_Actor* Portal, AActor* TargetToTeleport)
+{
+	TeleportByPortal(Portal, TargetToTeleport, true);
+}
+
+void APortalManager::TeleportByPortal(APortal_Actor* Portal, AActor* TargetToTeleport, bool bForceCaptures)
+{
+	if (Portal != nullptr && TargetToTeleport != nullptr)
+	{
+		Portal->TeleportActor(TargetToTeleport);
+
+		bool bViewPawn = TargetToTeleport == GetViewPawn();
+
+		// The camera was already updated this frame, move it with the player
+		if (ControllerOwner != nullptr && bViewPawn)
+		{
+			ControllerOwner->UpdateCameraManager(0.0f);
+		}
+
+		//-----------------------------------
+		//The portal in front of the player was rendered
+		//ahead : show it, the update of this frame does
+		//the rest at the usual rates
+		//-----------------------------------
+		if (bViewPawn && SwapInPrewarmCapture(Portal))
+		{
+			return;
+		}
+
+		// The next Update() captures from the new view
+		if (!bForceCaptures)
+		{
+			return;
+		}
+
+		//-----------------------------------
+		//Force update
+		//-----------------------------------
+		UpdatePortalsInWorld();
+
+		for (const FPortalView& View : ActivePortals)
+		{
+			View.Portal->ForceTick(); //Force update before the player render its view since he just teleported
+		}
+
+		UpdateCaptures(true);
+	}
+}
+
+void APortalManager::UpdatePrewarmCapture(float DeltaTime)
+{
+	PrewarmSourcePortal = nullptr;
+
+	APawn* ViewPawn = GetViewPawn();
+	FVector ViewLocation;
+	FRotator ViewRotation;
+
+	if (!bPrewarmCaptures
+		|| PrewarmCapture == nullptr
+		|| PrewarmRenderTarget.Texture == nullptr
+		|| PortalSubsystem == nullptr
+		|| ViewPawn == nullptr
+		|| DeltaTime <= KINDA_SMALL_NUMBER
+		|| !bHasViewProjection
+		|| !GetViewPoint(ViewLocation, ViewRotation))
+	{
+		return;
+	}
+
+	SCOPE_PORTAL_STAT(Prewarm);
+
+	//-----------------------------------
+	// Active portal the pawn crosses within the
+	// next frames at its current velocity
+	//-----------------------------------
+	FVector PawnLocation = ViewPawn->GetActorLocation();
+	FVector Velocity = ViewPawn->GetVelocity();
+
+	APortal_Actor* CrossedPortal = nullptr;
+	float CrossingTime = DeltaTime * FMath::Max(PrewarmFrames, 1);
+
+	for (const FPortalView& View : ActivePortals)
+	{
+		APortal_Actor* Portal = View.Portal;
+
+		if (Portal == nullptr || Portal->GetTarget() == nullptr)
+		{
+			continue;
+		}
+
+		// In front and moving toward the plane (crossing forward only)
+		FVector Normal = Portal->GetActorForwardVector();
+		float PlaneDistance = FVector::DotProduct(PawnLocation - Portal->GetActorLocation(), Normal);
+		float ClosingSpeed = -FVector::DotProduct(Velocity, Normal);
+
+		if (PlaneDistance < 0.0f || ClosingSpeed <= KINDA_SMALL_NUMBER || PlaneDistance > ClosingSpeed * CrossingTime)
+		{
+			continue;
+		}
+
+		float Time = PlaneDistance / ClosingSpeed;
+
+		// Through the opening and not next to it
+		const FBox& Opening = Portal->GetLocalOpeningBounds();
+		FVector LocalCrossing = Portal->GetActorTransform().InverseTransformPosition(PawnLocation + Velocity * Time);
+		FVector OpeningCenter = Opening.GetCenter();
+		FVector OpeningExtent = Opening.GetExtent();
+
+		if (Opening.IsValid
+			&& OpeningExtent.Y > KINDA_SMALL_NUMBER
+			&& OpeningExtent.Z > KINDA_SMALL_NUMBER
+			&& (FMath::Abs(LocalCrossing.Y - OpeningCenter.Y) > OpeningExtent.Y || FMath::Abs(LocalCrossing.Z - OpeningCenter.Z) > OpeningExtent.Z))
+		{
+			continue;
+		}
+
+		CrossedPortal = Portal;
+		CrossingTime = Time;
+	}
+
+	if (CrossedPortal == nullptr)
+	{
+		return;
+	}
+
+	//-----------------------------------
+	// View after the teleport : the pawn is moved at the
+	// end of the frame crossing the plane (see TeleportActor)
+	//-----------------------------------
+	float FramesAhead = FMath::Max(FMath::CeilToFloat(CrossingTime / DeltaTime), 1.0f);
+	FVector PredictedLocation = CrossedPortal->TransformLocationToTarget(ViewLocation + Velocity * DeltaTime * FramesAhead);
+	FRotator PredictedRotation = CrossedPortal->GetTeleportedControlRotation(ViewRotation);
+	FMatrix PredictedViewProjection = MakeViewMatrix(PredictedLocation, PredictedRotation) * CameraProjectionMatrix;
+
+	//-----------------------------------
+	// Best portal on screen from there,
+	// ranked like UpdatePortalsInWorld()
+	//-----------------------------------
+	TArray<APortal_Actor*> Portals;
+	PortalSubsystem->GetRegistry().QuerySphere(PredictedLocation, MaxPortalDistance, Portals);
+
+	FPortalView PredictedView;
+
+	for (APortal_Actor* Portal : Portals)
+	{
+		FPortalView View;
+
+		if (Portal->GetTarget() != nullptr
+			&& ScorePortal(Portal, PredictedLocation, &PredictedViewProjection, false, View)
+			&& (PredictedView.Portal == nullptr || View.Score > PredictedView.Score))
+		{
+			PredictedView = View;
+		}
+	}
+
+	APortal_Actor* Portal = PredictedView.Portal;
+
+	if (Portal == nullptr)
+	{
+		return;
+	}
+
+	PrewarmSourcePortal = CrossedPortal;
+
+	AActor* Target = Portal->GetTarget();
+	FVector CaptureLocation = ComputeCaptureLocation(Portal, PredictedLocation);
+	FRotator CaptureRotation = PredictedRotation;
+	FMatrix ProjectionMatrix = CameraProjectionMatrix;
+	FLinearColor UVRect = FLinearColor(0.0f, 0.0f, 1.0f, 1.0f);
+
+	if (bCropCaptureToPortal)
+	{
+		ProjectionMatrix = ComputeCroppedProjection(ProjectionMatrix, PredictedView.ScreenRect, UVRect);
+	}
+
+	// Rendered once per crossing, the reprojection covers small errors
+	if (PrewarmRenderTarget.Owner == Portal
+		&& PrewarmRenderTarget.LastCaptureFrame != 0
+		&& PrewarmRenderTarget.CaptureLocation.Equals(CaptureLocation, PrewarmLocationTolerance)
+		&& PrewarmRenderTarget.CaptureRotation.Equals(CaptureRotation, PrewarmRotationTolerance))
+	{
+		return;
+	}
+
+	//-----------------------------------
+	// Render it into the second buffer
+	// (without recursion, added by the next capture)
+	//-----------------------------------
+	PrewarmCapture->SetWorldLocationAndRotation(CaptureLocation, CaptureRotation);
+	PrewarmCapture->ClipPlaneNormal = Target->GetActorForwardVector();
+	PrewarmCapture->ClipPlaneBase = Target->GetActorLocation();
+	PrewarmCapture->TextureTarget = PrewarmRenderTarget.Texture;
+	PrewarmCapture->CustomProjectionMatrix = ProjectionMatrix;
+	ApplyTargetVisibility(PrewarmCapture, Portal);
+
+	RenderCapture(PrewarmCapture);
+
+	INC_PORTAL_COUNTER(PortalsPrewarmed, 1);
+
+	PrewarmRenderTarget.Owner = Portal;
+	PrewarmRenderTarget.Bucket = 0;
+	PrewarmRenderTarget.UVRect = UVRect;
+	PrewarmRenderTarget.CapturedScreenRect = PredictedView.ScreenRect;
+	PrewarmRenderTarget.CaptureLocation = CaptureLocation;
+	PrewarmRenderTarget.CaptureRotation = CaptureRotation;
+	PrewarmRenderTarget.CaptureProjectionMatrix = ProjectionMatrix;
+	PrewarmRenderTarget.TargetSideHash = ComputeTargetSideHash(Portal);
+	PrewarmRenderTarget.LastCaptureFrame = GFrameCounter;
+}
+
+bool APortalManager::SwapInPrewarmCapture(APortal_Actor* CrossedPortal)
+{
+	APortal_Actor* Portal = PrewarmRenderTarget.Owner;
+
+	if (CrossedPortal == nullptr
+		|| CrossedPortal != PrewarmSourcePortal
+		|| Portal == nullptr
+		|| PrewarmRenderTarget.Texture == nullptr
+		|| PrewarmRenderTarget.LastCaptureFrame == 0
+		|| GFrameCounter - PrewarmRenderTarget.LastCaptureFrame > uint64(FMath::Max(PrewarmFrames, 1)))
+	{
+		return false;
+	}
+
+	// Only a target of the same size can be swapped, nothing changes hands before that
+	FPortalRenderTarget* RenderTarget = SelectRenderTarget(Portal, PrewarmRenderTarget.Bucket, false);
+
+	if (RenderTarget == nullptr)
+	{
+		return false;
+	}
+
+	ClaimRenderTarget(Portal, PrewarmRenderTarget.Bucket, *RenderTarget);
+
+	//-----------------------------------
+	// The pool gets the prewarmed texture and the
+	// second buffer the one it replaces
+	//-----------------------------------
+	Swap(RenderTarget->Texture, PrewarmRenderTarget.Texture);
+
+	RenderTarget->UVRect = PrewarmRenderTarget.UVRect;
+	RenderTarget->CapturedScreenRect = PrewarmRenderTarget.CapturedScreenRect;
+	RenderTarget->CaptureLocation = PrewarmRenderTarget.CaptureLocation;
+	RenderTarget->CaptureRotation = PrewarmRenderTarget.CaptureRotation;
+	RenderTarget->CaptureProjectionMatrix = PrewarmRenderTarget.CaptureProjectionMatrix;
+	RenderTarget->TargetSideHash = PrewarmRenderTarget.TargetSideHash;
+
+	// Counts as captured this frame, the update of this frame reprojects it
+	RenderTarget->LastCaptureFrame = GFrameCounter;
+
+	PrewarmRenderTarget.Owner = nullptr;
+	PrewarmRenderTarget.LastCaptureFrame = 0;
+	PrewarmSourcePortal = nullptr;
+
+	Portal->SetPlayerActive(PlayerIndex, true);
+	Portal->SetPlayerRTT(PlayerIndex, RenderTarget->Texture);
+	SetPortalUVRect(Portal, RenderTarget->UVRect);
+	Portal->ForceTick();
+
+	INC_PORTAL_COUNTER(PortalPrewarmHits, 1);
+
+	return true;
 }
 
 void APortalManager::SetControllerOwner(APlayer_Controller* NewOwner)
@@ -7,18 +7,88 @@
 #include "Components/SceneCaptureComponent2D.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "Components/SceneComponent.h"
+#include "PortalScalability.h"
 #include "PortalManager.generated.h"
 
 //Forward declaration
 class APlayer_Controller;
+class UPortalSubsystem;
 class APortal_Actor;
+class FViewport;
+struct FPortalEffectView;
+
+// How often the capture of a portal is refreshed
+UENUM()
+enum class EPortalUpdateRate : uint8
+{
+    EveryFrame,
+    EveryNthFrame,
+    // Only when requested by the portal, or rarely when something changed
+    OnDemand
+};
+
+// How the player sees a portal this frame
+USTRUCT()
+struct FPortalView
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+        APortal_Actor* Portal = nullptr;
+
+    // Bounds of the portal on screen, in normalized device coordinates [-1..1]
+    FBox2D ScreenRect = FBox2D(ForceInit);
+
+    // Fraction of the screen covered by ScreenRect [0..1]
+    float ScreenCoverage = 0.0f;
+
+    float Distance = 0.0f;
+
+    float Score = 0.0f;
+
+    // Index in APortalManager::ResolutionBuckets of the target to render into
+    int32 ResolutionBucket = 0;
+
+    EPortalUpdateRate UpdateRate = EPortalUpdateRate::EveryFrame;
+};
+
+// Render target of the pool and the portal that used it last
+USTRUCT()
+struct FPortalRenderTarget
+{
+    GENERATED_BODY()
+
+    UPROPERTY(transient)
+        UTextureRenderTarget2D* Texture = nullptr;
+
+    UPROPERTY()
+        APortal_Actor* Owner = nullptr;
+
+    // Index in APortalManager::ResolutionBuckets
+    int32 Bucket = 0;
+
+    // Screen region rendered into the texture (see APortal_Actor::SetRTTUVRect)
+    FLinearColor UVRect = FLinearColor(0.0f, 0.0f, 1.0f, 1.0f);
+
+    // Inputs of the last capture, to skip it when nothing changed
+    FBox2D CapturedScreenRect = FBox2D(ForceInit);
+    FVector CaptureLocation = FVector::ZeroVector;
+    FRotator CaptureRotation = FRotator::ZeroRotator;
+    FMatrix CaptureProjectionMatrix = FMatrix::Identity;
+    uint32 TargetSideHash = 0;
+
+    // 0 when the texture does not hold a capture of its Owner
+    uint64 LastCaptureFrame = 0;
+
+    uint64 LastUsedFrame = 0;
+};
 
 UCLASS()
 class EL_API APortalManager : public AActor
 {
     GENERATED_UCLASS_BODY()
-	
-public:	
+
+public:
 	// Sets default values for this actor's properties
 	APortalManager();
 
@@ -26,38 +96,387 @@ public:
     UFUNCTION(BlueprintCallable, Category = "Portal")
         void RequestTeleportByPortal(APortal_Actor* Portal, AActor* TargetToTeleport);
 
+    // Same, without updating the captures right away : for the subsystem,
+    // whose tick runs the update of the manager right after
+    void TeleportByPortal(APortal_Actor* Portal, AActor* TargetToTeleport, bool bForceCaptures);
+
     // Save a reference to the PlayerControler
     void SetControllerOwner(APlayer_Controller* NewOwner);
 
     // Various setup that happens during spawn
     void Init();
 
-    // Manual Tick
+    // Called by the PortalSubsystem when a portal leaves the world
+    void UnregisterPortal(APortal_Actor* Portal);
+
+    // Pawn possessed by the ControllerOwner (if any)
+    APawn* GetViewPawn() const;
+
+    // Final camera view of the ControllerOwner for this frame
+    bool GetViewPoint(FVector& OutLocation, FRotator& OutRotation) const;
+
+    // GPU memory used by the render targets of this manager (both pools)
+    float GetRenderTargetMemoryMB() const;
+
+    // Index of the local player owning this manager (0 without split-screen)
+    int32 GetPlayerIndex() const;
+
+    // Portal displays of the other local players, hidden from our views
+    const TArray<TWeakObjectPtr<UPrimitiveComponent>>& GetHiddenPortalDisplays() const;
+
+    // Camera of the player and the captures it displays this frame, for the effect significance
+    void GetEffectViews(TArray<FPortalEffectView>& OutViews) const;
+
+    // Manual Tick, called by the PortalSubsystem after the camera update
     void Update(float DeltaTime);
 
-    // Find all the portals in world and update them
+    // Score the registered portals around the Player and keep the best ones
     // returns the most valid/usable one for the Player
     APortal_Actor* UpdatePortalsInWorld();
 
-    // Update SceneCapture
-    void UpdateCapture(APortal_Actor* Portal);
+    // Capture every portal selected by UpdatePortalsInWorld()
+    // bForceCapture ignores the update rates and change tracking
+    void UpdateCaptures(bool bForceCapture = false);
+
+    // Update the SceneCapture of the given slot for a Portal
+    void UpdateCapture(APortal_Actor* Portal, int32 CaptureIndex = 0, bool bForceCapture = false);
+
+    // Maximum amount of portals captured in the same frame
+    // (r.Portal.MaxCaptures overrides it when set)
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        int32 MaxCaptures;
+
+    // GPU memory the pooled render targets are allowed to use
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        float RenderTargetBudgetMB;
+
+    // Weights used to rank the portals competing for a capture
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        float DistanceWeight;
+
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        float ScreenCoverageWeight;
+
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        float FacingWeight;
+
+    // Render target sizes (fractions of the base size) allocated up front,
+    // portals pick one depending on their size on screen
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        TArray<float> ResolutionBuckets;
+
+    // Multiplies the resolution derived from the screen coverage
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        float ResolutionQualityBias;
+
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        float MinResolutionScale;
+
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        float MaxResolutionScale;
+
+    // Smallest side of a render target, in pixels
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        int32 MinPortalResolution;
+
+    // Render only the screen region covered by the portal with an
+    // off-axis projection (the portal material remaps its UVs)
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        bool bCropCaptureToPortal;
+
+    // Extra border around the cropped region, in NDC
+    UPROPERTY(EditAnywhere, Category = "Portal")
+        float CropMargin;
+
+    // Below these the capture inputs are considered unchanged
+    UPROPERTY(EditAnywhere, Category = "Portal|Update")
+        float CaptureLocationTolerance;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Update")
+        float CaptureRotationTolerance;
+
+    // Movable objects within this radius of a portal target invalidate its capture
+    UPROPERTY(EditAnywhere, Category = "Portal|Update")
+        float TargetSideCheckRadius;
+
+    // Portals further than this are updated every ReducedRateInterval frames
+    UPROPERTY(EditAnywhere, Category = "Portal|Update")
+        float ReducedRateDistance;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Update")
+        int32 ReducedRateInterval;
+
+    // Portals smaller than this on screen are updated on demand
+    UPROPERTY(EditAnywhere, Category = "Portal|Update")
+        float OnDemandScreenCoverage;
+
+    // Frames between two updates of an on demand portal that changed
+    UPROPERTY(EditAnywhere, Category = "Portal|Update")
+        int32 OnDemandInterval;
+
+    // Shift the UVs of portals that were not captured this frame to follow the camera
+    UPROPERTY(EditAnywhere, Category = "Portal|Update")
+        bool bReprojectSkippedCaptures;
+
+    // How many portals deep a portal seen through a portal is rendered
+    UPROPERTY(EditAnywhere, Category = "Portal|Recursion")
+        int32 MaxRecursionDepth;
+
+    // Size of each recursion level relative to the previous one
+    UPROPERTY(EditAnywhere, Category = "Portal|Recursion")
+        float RecursionResolutionScale;
+
+    // Recursion stops for the frame once these are spent
+    UPROPERTY(EditAnywhere, Category = "Portal|Recursion")
+        int32 RecursionPixelBudget;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Recursion")
+        float RecursionTimeBudgetMs;
+
+    // Detect the crossings of the player pawn in the PortalSubsystem
+    // instead of relying on the portal blueprint calling IsPointCrossingPortal
+    UPROPERTY(EditAnywhere, Category = "Portal|Crossing")
+        bool bDetectPlayerCrossing;
+
+    // Movable actors checked against the target side of each active portal per frame
+    UPROPERTY(EditAnywhere, Category = "Portal|Visibility")
+        int32 VisibilityChecksPerFrame;
+
+    // Render the portal seen right after a teleport a few frames ahead,
+    // into a render target swapped into the pool when the teleport happens
+    UPROPERTY(EditAnywhere, Category = "Portal|Prewarm")
+        bool bPrewarmCaptures;
+
+    // How many frames before the crossing the capture is rendered
+    UPROPERTY(EditAnywhere, Category = "Portal|Prewarm")
+        int32 PrewarmFrames;
+
+    // The prediction moved further than this since the capture : render it again
+    UPROPERTY(EditAnywhere, Category = "Portal|Prewarm")
+        float PrewarmLocationTolerance;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Prewarm")
+        float PrewarmRotationTolerance;
+
+protected:
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
-    //Function to create the Portal render target
+    void OnViewportResized(FViewport* Viewport, uint32 Unused);
+
+    //Function to compute the Portal render targets size
+    //and start building a new pool when it changed
     void GeneratePortalTexture();
 
+    // Amount of render targets of each bucket that fit in the budget
+    void ComputeBucketCounts(const FIntPoint& BaseSize, TArray<int32>& OutBucketCounts) const;
+
+    // Create some targets of the pending pool, swap it in once complete
+    void UpdatePendingRenderTargets(int32 MaxAllocations);
+
+    UTextureRenderTarget2D* CreatePortalTexture(int32 SizeX, int32 SizeY);
+
+    USceneCaptureComponent2D* CreateSceneCapture(FName BaseName);
+
+    // Create the missing captures of the pool and of the recursion levels
+    void CreateSceneCaptures();
+
+    // Follow the changes of the r.Portal.* console variables (sg.PortalQuality)
+    void UpdateQualitySettings();
+
+    int32 GetMaxCaptures() const;
+
+    // Cheaper settings for the captures of the recursion levels
+    void ApplyRecursionQuality(USceneCaptureComponent2D* SceneCapture, int32 Depth);
+
+    // Location of the SceneCapture looking through the Portal from ViewLocation
+    FVector ComputeCaptureLocation(APortal_Actor* Portal, const FVector& ViewLocation) const;
+
+    // Render the portal visible through ParentPortal (and the ones behind it)
+    // returns the portal whose texture was replaced for the parent capture
+    APortal_Actor* UpdateRecursiveCapture(APortal_Actor* ParentPortal, const FVector& ViewLocation, const FMatrix& ProjectionMatrix, int32 Depth);
+
+    // Projection restricted to the ScreenRect (NDC), OutUVRect is the matching region in screen UVs
+    FMatrix ComputeCroppedProjection(const FMatrix& ProjectionMatrix, const FBox2D& ScreenRect, FLinearColor& OutUVRect) const;
+
+    // CaptureScene() with its CPU/GPU stats
+    void RenderCapture(USceneCaptureComponent2D* SceneCapture);
+
+    // Restrict what the SceneCapture renders to the target side of the Portal
+    void ApplyTargetVisibility(USceneCaptureComponent2D* SceneCapture, APortal_Actor* Portal);
+
+    // Hide from our captures the displays of the other players (split-screen)
+    // and the effects too small to be worth it in a capture (see FPortalEffects)
+    void UpdateHiddenComponents();
+
+    // Split-screen : show the capture of another player with about the same view instead of ours
+    bool UseSharedCapture(APortal_Actor* Portal, const FVector& ViewLocation, const FRotator& ViewRotation);
+
+    void PublishCapture(APortal_Actor* Portal, const FPortalRenderTarget& RenderTarget);
+
+    // Projection of the player view for this frame. In stereo it is the frustum
+    // covering both eyes seen from their center : one capture is shared by the
+    // eyes (half the cost, no parallax inside the portal)
+    void UpdateViewProjection();
+
+    // Give the Portal the UVRect of a capture made with CameraProjectionMatrix, per eye in stereo
+    void SetPortalUVRect(APortal_Actor* Portal, const FLinearColor& UVRect) const;
+
+    // Off-axis projection containing both eye frustums
+    static FMatrix CombineEyeProjections(const FMatrix& LeftProjection, const FMatrix& RightProjection);
+
+    // UVRect in the screen UVs of ViewProjection expressed in the screen UVs of EyeProjection
+    static FLinearColor ConvertUVRectToEye(const FLinearColor& UVRect, const FMatrix& ViewProjection, const FMatrix& EyeProjection);
+
+    FPortalRenderTarget* FindRenderTarget(UTextureRenderTarget2D* Texture);
+
+    // Did the inputs of the capture change enough, and is the portal due for an update
+    bool ShouldCapture(const FPortalRenderTarget& RenderTarget, EPortalUpdateRate UpdateRate, const FVector& CaptureLocation, const FRotator& CaptureRotation, const FMatrix& ProjectionMatrix, uint32 TargetSideHash) const;
+
+    // Hash of the movable objects around the target of the Portal
+    uint32 ComputeTargetSideHash(APortal_Actor* Portal) const;
+
+    // UVRect mapping the portal where it is now on screen to where it was when captured
+    FLinearColor ComputeReprojectedUVRect(const FPortalRenderTarget& RenderTarget, const FBox2D& ScreenRect) const;
+
+    EPortalUpdateRate SelectUpdateRate(const FPortalView& View, int32 Rank) const;
+
+    // Give back its own render target to a portal used by the recursion
+    void RestorePortalTexture(APortal_Actor* Portal);
+
+    // Get a render target of the bucket for the Portal, reusing the least recently used one
+    UTextureRenderTarget2D* AcquireRenderTarget(APortal_Actor* Portal, int32 Bucket);
+
+    // Target AcquireRenderTarget() would give, without taking it (nullptr if none)
+    FPortalRenderTarget* SelectRenderTarget(APortal_Actor* Portal, int32 Bucket, bool bOtherBuckets);
+
+    // Give a selected target to the Portal, releasing what it had of other sizes
+    void ClaimRenderTarget(APortal_Actor* Portal, int32 Bucket, FPortalRenderTarget& RenderTarget);
+
+    // Size of the render targets of a bucket
+    FIntPoint GetBucketSize(int32 Bucket, const FIntPoint& BaseSize) const;
+
+    FIntPoint GetRecursionTargetSize(int32 Depth, const FIntPoint& BaseSize) const;
+
+    float GetRenderTargetSizeMB(const FIntPoint& Size) const;
+
+    // Smallest bucket big enough for the portal on screen
+    int32 SelectResolutionBucket(const FPortalView& View) const;
+
+    // Project the Portal bounds on screen, false if it is not visible
+    bool ComputePortalScreenRect(APortal_Actor* Portal, const FMatrix& ViewProjectionMatrix, FBox2D& OutRect) const;
+
+    // Rank a Portal seen from ViewLocation (no ViewProjectionMatrix : off-screen),
+    // false if it is too far, or off-screen and not bKeepOffScreen
+    bool ScorePortal(APortal_Actor* Portal, const FVector& ViewLocation, const FMatrix* ViewProjectionMatrix, bool bKeepOffScreen, FPortalView& OutView) const;
+
+    // World to view space of a camera (same axes as FSceneView)
+    static FMatrix MakeViewMatrix(const FVector& ViewLocation, const FRotator& ViewRotation);
+
+    //-----------------------------------
+    // Prewarm : predict the crossing of the view pawn and render the
+    // portal seen on the other side before the teleport happens
+    //-----------------------------------
+    void UpdatePrewarmCapture(float DeltaTime);
+
+    // Give the prewarmed capture to its portal after a teleport through CrossedPortal,
+    // false if there is none for this crossing
+    bool SwapInPrewarmCapture(APortal_Actor* CrossedPortal);
+
+    UPROPERTY()
+        TArray<USceneCaptureComponent2D*> SceneCaptures;
+
     UPROPERTY()
-        USceneCaptureComponent2D* SceneCapture;
+        TArray<FPortalRenderTarget> RenderTargetPool;
+
+    // Pool being built for a new viewport size (double buffer of RenderTargetPool)
+    UPROPERTY()
+        TArray<FPortalRenderTarget> PendingRenderTargetPool;
+
+    TArray<int32> PendingBucketCounts;
+
+    // One target per recursion level
+    UPROPERTY(transient)
+        TArray<UTextureRenderTarget2D*> RecursionRenderTargets;
+
+    UPROPERTY(transient)
+        TArray<UTextureRenderTarget2D*> PendingRecursionRenderTargets;
+
+    UPROPERTY()
+        TArray<USceneCaptureComponent2D*> RecursionCaptures;
+
+    // Second buffer of the portal seen after the next teleport, same size as the first bucket
+    UPROPERTY()
+        FPortalRenderTarget PrewarmRenderTarget;
 
     UPROPERTY(transient)
-        UTextureRenderTarget2D* PortalTexture;
+        UTextureRenderTarget2D* PendingPrewarmTexture;
+
+    UPROPERTY()
+        USceneCaptureComponent2D* PrewarmCapture;
+
+    // Portal the view pawn is about to cross, PrewarmRenderTarget shows its other side
+    UPROPERTY()
+        APortal_Actor* PrewarmSourcePortal;
+
+    // Visibility set last copied into each capture, to avoid copying the lists every frame
+    struct FCaptureVisibilityState
+    {
+        const APortal_Actor* Portal = nullptr;
+        int32 Version = INDEX_NONE;
+    };
+
+    TMap<const USceneCaptureComponent2D*, FCaptureVisibilityState> CaptureVisibilityStates;
+
+    int32 RecursionPixelsThisFrame;
+
+    double RecursionTimeThisFrame;
+
+    FIntPoint PendingScreenSize;
+
+    bool bHasPendingRenderTargets;
+
+    FDelegateHandle ViewportResizedHandle;
 
     UPROPERTY()
         APlayer_Controller* ControllerOwner;
 
+    // Portals captured during the last update, best first
+    UPROPERTY()
+        TArray<FPortalView> ActivePortals;
+
+    // Portals further than this are never activated
+    float MaxPortalDistance;
+
+    UPROPERTY()
+        UPortalSubsystem* PortalSubsystem;
+
     int32 PreviousScreenSizeX;
     int32 PreviousScreenSizeY;
 
-    float UpdateDelay;
+    // Quality used by the captures and render targets
+    FPortalQualitySettings QualitySettings;
+
+    //-----------------------------------
+    // Player view of this frame (see UpdateViewProjection)
+    //-----------------------------------
+    FMatrix CameraProjectionMatrix;
+
+    FMatrix CameraViewProjectionMatrix;
+
+    // Left and right eye, when bStereoView
+    FMatrix EyeProjectionMatrices[2];
+
+    bool bHasViewProjection;
+
+    bool bStereoView;
+
+    // See GetPlayerIndex(), refreshed every update
+    int32 PlayerIndex;
+
+    TArray<TWeakObjectPtr<UPrimitiveComponent>> HiddenPortalDisplays;
+
+    // HiddenPortalDisplays and the hidden effects, given to every capture
+    TArray<TWeakObjectPtr<UPrimitiveComponent>> CaptureHiddenComponents;
 
 };
@@ -0,0 +1,245 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalMath.h"
+
+bool FPortalMath::IsPointInFrontOfPlane(const FVector& Point, const FVector& PlaneLocation, const FVector& PlaneNormal)
+{
+	FPlane PortalPlane = FPlane(PlaneLocation, PlaneNormal);
+
+	//If < 0 means we are behind the Plane
+	return PortalPlane.PlaneDot(Point) >= 0.0f;
+}
+
+bool FPortalMath::IsSegmentCrossingPlane(const FVector& Start, const FVector& End, const FVector& PlaneLocation, const FVector& PlaneNormal)
+{
+	FVector IntersectionPoint;
+	FPlane PortalPlane = FPlane(PlaneLocation, PlaneNormal);
+
+	bool bIntersect = FMath::SegmentPlaneIntersection(Start, End, PortalPlane, IntersectionPoint);
+
+	return bIntersect && PortalPlane.PlaneDot(Start) >= 0.0f && PortalPlane.PlaneDot(End) < 0.0f;
+}
+
+bool FPortalMath::IsPointInsideBox(const FVector& Point, const FVector& Center, const FVector& HalfExtent, const FVector& AxisX, const FVector& AxisY, const FVector& AxisZ)
+{
+	// From :
+	// https://stackoverflow.com/questions/52673935/check-if-3d-point-inside-a-box/52674010
+	FVector Direction = Point - Center;
+
+	return FMath::Abs(FVector::DotProduct(Direction, AxisX)) <= HalfExtent.X
+		&& FMath::Abs(FVector::DotProduct(Direction, AxisY)) <= HalfExtent.Y
+		&& FMath::Abs(FVector::DotProduct(Direction, AxisZ)) <= HalfExtent.Z;
+}
+
+FVector FPortalMath::ConvertLocation(const FVector& Location, const FVector& SourceLocation, const FQuat& SourceRotation, const FVector& TargetLocation, const FQuat& TargetRotation)
+{
+	// Coordinates along the source axes, applied to the target axes
+	FVector LocalDirection = SourceRotation.UnrotateVector(Location - SourceLocation);
+
+	return TargetLocation + TargetRotation.RotateVector(LocalDirection);
+}
+
+FQuat FPortalMath::ConvertRotation(const FQuat& Rotation, const FQuat& SourceRotation, const FQuat& TargetRotation)
+{
+	FQuat LocalQuat = SourceRotation.Inverse() * Rotation;
+
+	return TargetRotation * LocalQuat;
+}
+
+FMatrix FPortalMath::MakeLinkMatrix(const FVector& SourceLocation, const FQuat& SourceRotation, const FVector& TargetLocation, const FQuat& TargetRotation, bool bMirrored)
+{
+	// Mirroring by the forward and right planes
+	// of the target is a half turn around its up axis
+	FQuat Mirror = bMirrored ? FQuat(FVector::UpVector, PI) : FQuat::Identity;
+	FQuat LinkRotation = TargetRotation * Mirror * SourceRotation.Inverse();
+
+	return FTranslationMatrix(-SourceLocation)
+		* FQuatRotationMatrix(LinkRotation)
+		* FTranslationMatrix(TargetLocation);
+}
+
+void FPortalMath::PointsInFrontOfPlaneScalar(const float* X, const float* Y, const float* Z, int32 Num, const FVector& PlaneLocation, const FVector& PlaneNormal, bool* OutInFront)
+{
+	for (int32 Index = 0; Index < Num; Index++)
+	{
+		OutInFront[Index] = IsPointInFrontOfPlane(FVector(X[Index], Y[Index], Z[Index]), PlaneLocation, PlaneNormal);
+	}
+}
+
+void FPortalMath::PointsInFrontOfPlane(const float* X, const float* Y, const float* Z, int32 Num, const FVector& PlaneLocation, const FVector& PlaneNormal, bool* OutInFront)
+{
+	const VectorRegister NX = VectorSetFloat1(PlaneNormal.X);
+	const VectorRegister NY = VectorSetFloat1(PlaneNormal.Y);
+	const VectorRegister NZ = VectorSetFloat1(PlaneNormal.Z);
+	const VectorRegister W = VectorSetFloat1(FVector::DotProduct(PlaneLocation, PlaneNormal));
+	const int32 VectorCount = Num & ~3;
+	int32 Index = 0;
+
+	for (; Index < VectorCount; Index += 4)
+	{
+		VectorRegister Dot = VectorMultiplyAdd(VectorLoad(&X[Index]), NX,
+			VectorMultiplyAdd(VectorLoad(&Y[Index]), NY, VectorMultiply(VectorLoad(&Z[Index]), NZ)));
+
+		int32 Mask = VectorMaskBits(VectorCompareGE(Dot, W));
+
+		OutInFront[Index + 0] = (Mask & 1) != 0;
+		OutInFront[Index + 1] = (Mask & 2) != 0;
+		OutInFront[Index + 2] = (Mask & 4) != 0;
+		OutInFront[Index + 3] = (Mask & 8) != 0;
+	}
+
+	PointsInFrontOfPlaneScalar(X + Index, Y + Index, Z + Index, Num - Index, PlaneLocation, PlaneNormal, OutInFront + Index);
+}
+
+void FPortalMath::TransformPositionsScalar(const FMatrix& Matrix, float* X, float* Y, float* Z, int32 Num)
+{
+	for (int32 Index = 0; Index < Num; Index++)
+	{
+		FVector Position = Matrix.TransformPosition(FVector(X[Index], Y[Index], Z[Index]));
+
+		X[Index] = Position.X;
+		Y[Index] = Position.Y;
+		Z[Index] = Position.Z;
+	}
+}
+
+void FPortalMath::TransformPositions(const FMatrix& Matrix, float* X, float* Y, float* Z, int32 Num)
+{
+	// One register per matrix element, four positions per iteration
+	VectorRegister M[4][3];
+
+	for (int32 Row = 0; Row < 4; Row++)
+	{
+		for (int32 Column = 0; Column < 3; Column++)
+		{
+			M[Row][Column] = VectorSetFloat1(Matrix.M[Row][Column]);
+		}
+	}
+
+	const int32 VectorCount = Num & ~3;
+	int32 Index = 0;
+
+	for (; Index < VectorCount; Index += 4)
+	{
+		VectorRegister PX = VectorLoad(&X[Index]);
+		VectorRegister PY = VectorLoad(&Y[Index]);
+		VectorRegister PZ = VectorLoad(&Z[Index]);
+
+		VectorRegister OutX = VectorMultiplyAdd(PX, M[0][0], VectorMultiplyAdd(PY, M[1][0], VectorMultiplyAdd(PZ, M[2][0], M[3][0])));
+		VectorRegister OutY = VectorMultiplyAdd(PX, M[0][1], VectorMultiplyAdd(PY, M[1][1], VectorMultiplyAdd(PZ, M[2][1], M[3][1])));
+		VectorRegister OutZ = VectorMultiplyAdd(PX, M[0][2], VectorMultiplyAdd(PY, M[1][2], VectorMultiplyAdd(PZ, M[2][2], M[3][2])));
+
+		VectorStore(OutX, &X[Index]);
+		VectorStore(OutY, &Y[Index]);
+		VectorStore(OutZ, &Z[Index]);
+	}
+
+	TransformPositionsScalar(Matrix, X + Index, Y + Index, Z + Index, Num - Index);
+}
+
+// Segment/opening test of one entry of the batch
+static bool IsCrossingOpening(const FPortalCrossingBatch& Batch, int32 Index)
+{
+	FVector Center = FVector(Batch.CenterX[Index], Batch.CenterY[Index], Batch.CenterZ[Index]);
+	FVector Normal = FVector(Batch.NormalX[Index], Batch.NormalY[Index], Batch.NormalZ[Index]);
+	FVector Prev = FVector(Batch.PrevX[Index], Batch.PrevY[Index], Batch.PrevZ[Index]) - Center;
+	FVector Cur = FVector(Batch.CurX[Index], Batch.CurY[Index], Batch.CurZ[Index]) - Center;
+
+	float PrevDot = FVector::DotProduct(Prev, Normal);
+	float CurDot = FVector::DotProduct(Cur, Normal);
+
+	if (!(PrevDot >= 0.0f && CurDot < 0.0f))
+	{
+		return false;
+	}
+
+	FVector Intersection = Prev + (Cur - Prev) * (PrevDot / (PrevDot - CurDot));
+	float AlongRight = FVector::DotProduct(Intersection, FVector(Batch.RightX[Index], Batch.RightY[Index], Batch.RightZ[Index]));
+	float AlongUp = FVector::DotProduct(Intersection, FVector(Batch.UpX[Index], Batch.UpY[Index], Batch.UpZ[Index]));
+
+	return FMath::Abs(AlongRight) <= Batch.HalfWidths[Index] && FMath::Abs(AlongUp) <= Batch.HalfHeights[Index];
+}
+
+void FPortalMath::FindCrossingsScalar(const FPortalCrossingBatch& Batch, TArray<int32>& OutIndices)
+{
+	for (int32 Index = 0; Index < Batch.Num; Index++)
+	{
+		if (IsCrossingOpening(Batch, Index))
+		{
+			OutIndices.Add(Index);
+		}
+	}
+}
+
+void FPortalMath::FindCrossings(const FPortalCrossingBatch& Batch, TArray<int32>& OutIndices)
+{
+	//-----------------------------------
+	// Four segments at a time : from the front to the back of the
+	// plane, and hitting the plane inside the portal opening
+	//-----------------------------------
+	const VectorRegister Zero = VectorZero();
+	const int32 VectorCount = Batch.Num & ~3;
+	int32 Index = 0;
+
+	for (; Index < VectorCount; Index += 4)
+	{
+		VectorRegister CenterX = VectorLoad(&Batch.CenterX[Index]);
+		VectorRegister CenterY = VectorLoad(&Batch.CenterY[Index]);
+		VectorRegister CenterZ = VectorLoad(&Batch.CenterZ[Index]);
+
+		VectorRegister PX = VectorSubtract(VectorLoad(&Batch.PrevX[Index]), CenterX);
+		VectorRegister PY = VectorSubtract(VectorLoad(&Batch.PrevY[Index]), CenterY);
+		VectorRegister PZ = VectorSubtract(VectorLoad(&Batch.PrevZ[Index]), CenterZ);
+		VectorRegister CX = VectorSubtract(VectorLoad(&Batch.CurX[Index]), CenterX);
+		VectorRegister CY = VectorSubtract(VectorLoad(&Batch.CurY[Index]), CenterY);
+		VectorRegister CZ = VectorSubtract(VectorLoad(&Batch.CurZ[Index]), CenterZ);
+
+		VectorRegister NX = VectorLoad(&Batch.NormalX[Index]);
+		VectorRegister NY = VectorLoad(&Batch.NormalY[Index]);
+		VectorRegister NZ = VectorLoad(&Batch.NormalZ[Index]);
+
+		// Signed distances to the plane
+		VectorRegister PrevDot = VectorMultiplyAdd(PX, NX, VectorMultiplyAdd(PY, NY, VectorMultiply(PZ, NZ)));
+		VectorRegister CurDot = VectorMultiplyAdd(CX, NX, VectorMultiplyAdd(CY, NY, VectorMultiply(CZ, NZ)));
+
+		VectorRegister Crossing = VectorBitwiseAnd(VectorCompareGE(PrevDot, Zero), VectorCompareGT(Zero, CurDot));
+
+		if (VectorMaskBits(Crossing) == 0)
+		{
+			continue;
+		}
+
+		// Intersection with the plane, relative to the opening center
+		VectorRegister Alpha = VectorDivide(PrevDot, VectorSubtract(PrevDot, CurDot));
+		VectorRegister IX = VectorMultiplyAdd(Alpha, VectorSubtract(CX, PX), PX);
+		VectorRegister IY = VectorMultiplyAdd(Alpha, VectorSubtract(CY, PY), PY);
+		VectorRegister IZ = VectorMultiplyAdd(Alpha, VectorSubtract(CZ, PZ), PZ);
+
+		VectorRegister AlongRight = VectorMultiplyAdd(IX, VectorLoad(&Batch.RightX[Index]),
+			VectorMultiplyAdd(IY, VectorLoad(&Batch.RightY[Index]), VectorMultiply(IZ, VectorLoad(&Batch.RightZ[Index]))));
+		VectorRegister AlongUp = VectorMultiplyAdd(IX, VectorLoad(&Batch.UpX[Index]),
+			VectorMultiplyAdd(IY, VectorLoad(&Batch.UpY[Index]), VectorMultiply(IZ, VectorLoad(&Batch.UpZ[Index]))));
+
+		Crossing = VectorBitwiseAnd(Crossing, VectorCompareGE(VectorLoad(&Batch.HalfWidths[Index]), VectorAbs(AlongRight)));
+		Crossing = VectorBitwiseAnd(Crossing, VectorCompareGE(VectorLoad(&Batch.HalfHeights[Index]), VectorAbs(AlongUp)));
+
+		int32 Mask = VectorMaskBits(Crossing);
+
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			if (Mask & (1 << Lane))
+			{
+				OutIndices.Add(Index + Lane);
+			}
+		}
+	}
+
+	// Remaining segments, same test
+	for (; Index < Batch.Num; Index++)
+	{
+		if (IsCrossingOpening(Batch, Index))
+		{
+			OutIndices.Add(Index);
+		}
+	}
+}
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Segments tested against portal openings, one entry per index (structure of arrays)
+struct FPortalCrossingBatch
+{
+    // Previous and current positions
+    const float* PrevX = nullptr;
+    const float* PrevY = nullptr;
+    const float* PrevZ = nullptr;
+    const float* CurX = nullptr;
+    const float* CurY = nullptr;
+    const float* CurZ = nullptr;
+
+    // Opening : center, plane normal (front side), in plane axes and half size
+    const float* CenterX = nullptr;
+    const float* CenterY = nullptr;
+    const float* CenterZ = nullptr;
+    const float* NormalX = nullptr;
+    const float* NormalY = nullptr;
+    const float* NormalZ = nullptr;
+    const float* RightX = nullptr;
+    const float* RightY = nullptr;
+    const float* RightZ = nullptr;
+    const float* UpX = nullptr;
+    const float* UpY = nullptr;
+    const float* UpZ = nullptr;
+    const float* HalfWidths = nullptr;
+    const float* HalfHeights = nullptr;
+
+    int32 Num = 0;
+};
+
+/**
+ * Stateless geometry used by the portals, usable without an actor or a world.
+ * Array functions come in two versions : the default one processes four
+ * elements at a time with VectorRegister, the Scalar one is the reference.
+ *
+ * The "EL.Portal.Math" automation tests check both against each other,
+ * "Portal.MathBenchmark [Count] [Iterations]" logs the time per element.
+ */
+struct EL_API FPortalMath
+{
+    // Point on the front side of the plane (or on it)
+    static bool IsPointInFrontOfPlane(const FVector& Point, const FVector& PlaneLocation, const FVector& PlaneNormal);
+
+    // The segment goes from the front to the back of the plane
+    // (crossing backward is ignored, similar to Prey 2006)
+    static bool IsSegmentCrossingPlane(const FVector& Start, const FVector& End, const FVector& PlaneLocation, const FVector& PlaneNormal);
+
+    // Oriented box given by its center, half size and axes
+    static bool IsPointInsideBox(const FVector& Point, const FVector& Center, const FVector& HalfExtent, const FVector& AxisX, const FVector& AxisY, const FVector& AxisZ);
+
+    // Location relative to the source expressed relative to the target
+    static FVector ConvertLocation(const FVector& Location, const FVector& SourceLocation, const FQuat& SourceRotation, const FVector& TargetLocation, const FQuat& TargetRotation);
+
+    static FQuat ConvertRotation(const FQuat& Rotation, const FQuat& SourceRotation, const FQuat& TargetRotation);
+
+    // Matrix doing ConvertLocation, with bMirrored also mirrored by the target
+    // forward and right planes (where a view through the portal ends up)
+    static FMatrix MakeLinkMatrix(const FVector& SourceLocation, const FQuat& SourceRotation, const FVector& TargetLocation, const FQuat& TargetRotation, bool bMirrored);
+
+    //-----------------------------------
+    // Arrays
+    //-----------------------------------
+    static void PointsInFrontOfPlane(const float* X, const float* Y, const float* Z, int32 Num, const FVector& PlaneLocation, const FVector& PlaneNormal, bool* OutInFront);
+    static void PointsInFrontOfPlaneScalar(const float* X, const float* Y, const float* Z, int32 Num, const FVector& PlaneLocation, const FVector& PlaneNormal, bool* OutInFront);
+
+    // In place, row vector convention (same as FMatrix::TransformPosition)
+    static void TransformPositions(const FMatrix& Matrix, float* X, float* Y, float* Z, int32 Num);
+    static void TransformPositionsScalar(const FMatrix& Matrix, float* X, float* Y, float* Z, int32 Num);
+
+    // Indices of the segments going forward through their opening
+    static void FindCrossings(const FPortalCrossingBatch& Batch, TArray<int32>& OutIndices);
+    static void FindCrossingsScalar(const FPortalCrossingBatch& Batch, TArray<int32>& OutIndices);
+};
@@ -0,0 +1,389 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalProxies.h"
+#include "PortalRegistry.h"
+#include "Portal_Actor.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Components/StaticMeshComponent.h"
+
+FPortalProxies::FPortalProxies()
+{
+	NumActive = 0;
+	NumMissed = 0;
+}
+
+FPortalProxies::~FPortalProxies()
+{
+}
+
+void FPortalProxies::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObjects(Pool);
+}
+
+FString FPortalProxies::GetReferencerName() const
+{
+	return TEXT("FPortalProxies");
+}
+
+void FPortalProxies::TrackActor(AActor* Actor)
+{
+	if (Actor == nullptr)
+	{
+		return;
+	}
+
+	bool bTracked = Proxied.ContainsByPredicate([Actor](const FProxied& Tracked)
+	{
+		return Tracked.Actor == Actor;
+	});
+
+	if (!bTracked)
+	{
+		FProxied& Tracked = Proxied.AddDefaulted_GetRef();
+		Tracked.Actor = Actor;
+	}
+}
+
+void FPortalProxies::UntrackActor(AActor* Actor)
+{
+	int32 Index = Proxied.IndexOfByPredicate([Actor](const FProxied& Tracked)
+	{
+		return Tracked.Actor == Actor;
+	});
+
+	if (Index != INDEX_NONE)
+	{
+		ReleaseProxy(Proxied[Index]);
+		Proxied.RemoveAtSwap(Index);
+	}
+}
+
+void FPortalProxies::Update(UWorld* World, const FPortalRegistry& Registry, float QueryRadius, int32 PoolSize)
+{
+	NumActive = 0;
+	NumMissed = 0;
+
+	if (World == nullptr || Proxied.Num() == 0)
+	{
+		return;
+	}
+
+	// Spawned up front, never in the middle of a crossing
+	FillPool(World, PoolSize);
+
+	for (int32 Index = Proxied.Num() - 1; Index >= 0; Index--)
+	{
+		FProxied& Tracked = Proxied[Index];
+		AActor* Actor = Tracked.Actor.Get();
+
+		if (Actor == nullptr)
+		{
+			ReleaseProxy(Tracked);
+			Proxied.RemoveAtSwap(Index);
+			continue;
+		}
+
+		// Only the physics objects, characters have their own teleport
+		UStaticMeshComponent* Source = Cast<UStaticMeshComponent>(Actor->GetRootComponent());
+
+		if (Source == nullptr || Source->GetStaticMesh() == nullptr || !Source->IsSimulatingPhysics())
+		{
+			ReleaseProxy(Tracked);
+			continue;
+		}
+
+		bool bThrough = false;
+		APortal_Actor* Portal = FindStraddledPortal(Tracked, Registry, QueryRadius, Source->Bounds.Origin, Source->Bounds.SphereRadius, bThrough);
+
+		if (Portal == nullptr)
+		{
+			ReleaseProxy(Tracked);
+			continue;
+		}
+
+		//-----------------------------------
+		// Teleported with the physics state when it jumps
+		// to the other side, moved kinematically otherwise
+		//-----------------------------------
+		ETeleportType Teleport = ETeleportType::None;
+
+		if (Tracked.Proxy == nullptr)
+		{
+			Tracked.Proxy = AcquireProxy(Tracked, Source);
+			Teleport = ETeleportType::TeleportPhysics;
+		}
+		else if (Tracked.Portal != Portal || Tracked.bThrough != bThrough)
+		{
+			Teleport = ETeleportType::TeleportPhysics;
+		}
+
+		if (Tracked.Proxy == nullptr)
+		{
+			NumMissed++;
+			continue;
+		}
+
+		Tracked.Portal = Portal;
+		Tracked.bThrough = bThrough;
+
+		//-----------------------------------
+		// Where the captures show it (view link), or the
+		// inverse once the actor went through
+		//-----------------------------------
+		const FMatrix& LinkMatrix = Portal->GetViewLinkMatrix();
+		FQuat LinkRotation = Portal->TransformRotationToTarget(FQuat::Identity);
+
+		FVector Location = Actor->GetActorLocation();
+		FQuat Rotation = Actor->GetActorQuat();
+
+		FVector ProxyLocation = bThrough ? LinkMatrix.InverseTransformPosition(Location) : LinkMatrix.TransformPosition(Location);
+		FQuat ProxyRotation = bThrough ? LinkRotation.Inverse() * Rotation : LinkRotation * Rotation;
+
+		UStaticMeshComponent* ProxyMesh = Tracked.Proxy->GetStaticMeshComponent();
+		ProxyMesh->SetWorldScale3D(Source->GetComponentScale());
+		ProxyMesh->SetWorldLocationAndRotation(ProxyLocation, ProxyRotation, false, nullptr, Teleport);
+
+		NumActive++;
+	}
+}
+
+bool FPortalProxies::GetPlaneDistance(APortal_Actor* Portal, const FVector& Location, float& OutDistance)
+{
+	//-----------------------------------
+	// Same plane and opening as the crossing tracker :
+	// through the actor location, facing forward, as
+	// large as the portal components
+	//-----------------------------------
+	FVector Normal = Portal->GetActorForwardVector();
+	FVector Right = Portal->GetActorRightVector();
+	FVector Up = Portal->GetActorUpVector();
+	FVector Center = Portal->GetActorLocation();
+
+	const FBox& LocalBox = Portal->GetLocalOpeningBounds();
+
+	if (LocalBox.IsValid)
+	{
+		FVector Scale = Portal->GetActorScale3D();
+		FVector LocalCenter = LocalBox.GetCenter() * Scale;
+		FVector LocalExtent = LocalBox.GetExtent() * Scale;
+
+		// No visible opening, accept the whole plane
+		if (LocalExtent.Y > KINDA_SMALL_NUMBER && LocalExtent.Z > KINDA_SMALL_NUMBER)
+		{
+			Center += Right * LocalCenter.Y + Up * LocalCenter.Z;
+
+			FVector Offset = Location - Center;
+
+			// Only what goes through the opening needs a proxy
+			if (FMath::Abs(FVector::DotProduct(Offset, Right)) > LocalExtent.Y
+				|| FMath::Abs(FVector::DotProduct(Offset, Up)) > LocalExtent.Z)
+			{
+				return false;
+			}
+		}
+	}
+
+	OutDistance = FVector::DotProduct(Location - Center, Normal);
+
+	return true;
+}
+
+APortal_Actor* FPortalProxies::FindStraddledPortal(const FProxied& Tracked, const FPortalRegistry& Registry, float QueryRadius, const FVector& Origin, float Radius, bool& bOutThrough)
+{
+	float Distance = 0.0f;
+	bOutThrough = false;
+
+	//-----------------------------------
+	// The portal of last frame first : once teleported the
+	// actor is only near it through the link
+	//-----------------------------------
+	APortal_Actor* Portal = Tracked.Portal;
+
+	if (Portal != nullptr && Portal->GetTarget() != nullptr)
+	{
+		if (GetPlaneDistance(Portal, Origin, Distance) && FMath::Abs(Distance) < Radius)
+		{
+			return Portal;
+		}
+
+		FVector PortalSideOrigin = Portal->GetViewLinkMatrix().InverseTransformPosition(Origin);
+
+		if (GetPlaneDistance(Portal, PortalSideOrigin, Distance) && FMath::Abs(Distance) < Radius)
+		{
+			bOutThrough = true;
+			return Portal;
+		}
+	}
+
+	// Closest plane among the portals around
+	NearbyPortals.Reset();
+	Registry.QuerySphere(Origin, QueryRadius + Radius, NearbyPortals);
+
+	APortal_Actor* Straddled = nullptr;
+	float ClosestDistance = Radius;
+
+	for (APortal_Actor* Nearby : NearbyPortals)
+	{
+		if (Nearby->GetTarget() == nullptr)
+		{
+			continue;
+		}
+
+		if (GetPlaneDistance(Nearby, Origin, Distance) && FMath::Abs(Distance) < ClosestDistance)
+		{
+			Straddled = Nearby;
+			ClosestDistance = FMath::Abs(Distance);
+		}
+	}
+
+	return Straddled;
+}
+
+void FPortalProxies::FillPool(UWorld* World, int32 PoolSize)
+{
+	while (Pool.Num() < PoolSize)
+	{
+		FActorSpawnParameters SpawnParameters;
+		SpawnParameters.ObjectFlags |= RF_Transient;
+		SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+		AStaticMeshActor* Proxy = World->SpawnActor<AStaticMeshActor>(SpawnParameters);
+
+		if (Proxy == nullptr)
+		{
+			return;
+		}
+
+		UStaticMeshComponent* ProxyMesh = Proxy->GetStaticMeshComponent();
+		ProxyMesh->SetMobility(EComponentMobility::Movable);
+		ProxyMesh->SetSimulatePhysics(false);
+		ProxyMesh->SetCanEverAffectNavigation(false);
+		ProxyMesh->SetGenerateOverlapEvents(false);
+
+		Proxy->SetActorHiddenInGame(true);
+		Proxy->SetActorEnableCollision(false);
+
+		Pool.Add(Proxy);
+		FreeProxies.Add(Proxy);
+	}
+}
+
+AStaticMeshActor* FPortalProxies::AcquireProxy(FProxied& Tracked, UStaticMeshComponent* Source)
+{
+	AStaticMeshActor* Proxy = nullptr;
+
+	while (Proxy == nullptr && FreeProxies.Num() > 0)
+	{
+		Proxy = FreeProxies.Pop(false);
+
+		if (Proxy != nullptr && Proxy->IsPendingKill())
+		{
+			Proxy = nullptr;
+		}
+	}
+
+	if (Proxy == nullptr)
+	{
+		return nullptr;
+	}
+
+	//-----------------------------------
+	// Looks and collides like the source, its
+	// physics state stays kinematic
+	//-----------------------------------
+	UStaticMeshComponent* ProxyMesh = Proxy->GetStaticMeshComponent();
+	ProxyMesh->SetStaticMesh(Source->GetStaticMesh());
+	ProxyMesh->EmptyOverrideMaterials();
+
+	for (int32 MaterialIndex = 0; MaterialIndex < Source->GetNumMaterials(); MaterialIndex++)
+	{
+		ProxyMesh->SetMaterial(MaterialIndex, Source->GetMaterial(MaterialIndex));
+	}
+
+	ProxyMesh->SetCastShadow(Source->CastShadow);
+	ProxyMesh->SetCollisionResponseToChannels(Source->GetCollisionResponseToChannels());
+	ProxyMesh->SetCollisionEnabled(Source->GetCollisionEnabled());
+
+	//-----------------------------------
+	// Back to back portals : the two halves must not push
+	// each other. Contacts need both sides to block, the
+	// source ignoring the proxy type is enough.
+	//-----------------------------------
+	ProxyMesh->SetCollisionObjectType(ECC_PortalProxy);
+	ProxyMesh->SetCollisionResponseToChannel(ECC_PortalProxy, ECR_Ignore);
+
+	Tracked.SourceProxyResponse = Source->GetCollisionResponseToChannel(ECC_PortalProxy);
+	Source->SetCollisionResponseToChannel(ECC_PortalProxy, ECR_Ignore);
+
+	Proxy->SetActorHiddenInGame(false);
+	Proxy->SetActorEnableCollision(true);
+
+	return Proxy;
+}
+
+void FPortalProxies::ReleaseProxy(FProxied& Tracked)
+{
+	if (Tracked.Proxy != nullptr && !Tracked.Proxy->IsPendingKill())
+	{
+		Tracked.Proxy->SetActorHiddenInGame(true);
+		Tracked.Proxy->SetActorEnableCollision(false);
+
+		UPrimitiveComponent* Source = Tracked.Actor.IsValid() ? Cast<UPrimitiveComponent>(Tracked.Actor->GetRootComponent()) : nullptr;
+
+		if (Source != nullptr)
+		{
+			Source->SetCollisionResponseToChannel(ECC_PortalProxy, Tracked.SourceProxyResponse);
+		}
+
+		FreeProxies.Add(Tracked.Proxy);
+	}
+
+	Tracked.Proxy = nullptr;
+	Tracked.Portal = nullptr;
+	Tracked.bThrough = false;
+}
+
+void FPortalProxies::RemovePortal(APortal_Actor* Portal)
+{
+	for (FProxied& Tracked : Proxied)
+	{
+		if (Tracked.Portal == Portal)
+		{
+			ReleaseProxy(Tracked);
+		}
+	}
+}
+
+void FPortalProxies::ReleaseAll()
+{
+	for (FProxied& Tracked : Proxied)
+	{
+		ReleaseProxy(Tracked);
+	}
+
+	NumActive = 0;
+	NumMissed = 0;
+}
+
+void FPortalProxies::Reset()
+{
+	ReleaseAll();
+
+	// Transient actors, they go away with the world
+	Proxied.Empty();
+	Pool.Empty();
+	FreeProxies.Empty();
+}
+
+int32 FPortalProxies::NumActiveProxies() const
+{
+	return NumActive;
+}
+
+int32 FPortalProxies::NumMissedProxies() const
+{
+	return NumMissed;
+}
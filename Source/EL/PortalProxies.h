@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/GCObject.h"
+#include "Engine/EngineTypes.h"
+
+// Object channel of the proxies (see DefaultEngine.ini), ignored by their source
+#define ECC_PortalProxy ECC_GameTraceChannel1
+
+//Forward declaration
+class AActor;
+class APortal_Actor;
+class AStaticMeshActor;
+class FPortalRegistry;
+class UStaticMeshComponent;
+class UWorld;
+
+/**
+ * Physics objects halfway through a portal exist on both sides.
+ *
+ * While the bounds of a tracked actor (a simulating static mesh root)
+ * straddle the opening of a portal, a proxy with the same mesh, materials
+ * and collision stands where the captures show it (view link of the
+ * portal, half turned around the target up axis), so that the part
+ * through the portal is seen and collides on the target side. The proxy is kinematic : it follows the actor, it is pushed by
+ * nothing. It is of the ECC_PortalProxy object type, which the actor
+ * ignores while it has a proxy, so that the two never touch (back to
+ * back portals) ; proxies of other actors are ignored as well meanwhile.
+ *
+ * The actor keeps the authority until its center crosses and the crossing
+ * tracker teleports it. The proxy then goes back to the portal side
+ * (inverse view link) to stand for the part not yet through, until the actor
+ * leaves the opening.
+ *
+ * Proxies are static mesh actors spawned once, hidden and without
+ * collision when unused, so that busy portals spawn and destroy nothing.
+ */
+class EL_API FPortalProxies : public FGCObject
+{
+public:
+    FPortalProxies();
+    virtual ~FPortalProxies();
+
+    //FGCObject, keeps the pool
+    virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+    virtual FString GetReferencerName() const override;
+
+    void TrackActor(AActor* Actor);
+    void UntrackActor(AActor* Actor);
+
+    // Grow the pool to PoolSize proxies, then place them. Portals
+    // are looked for within QueryRadius of the tracked actors.
+    void Update(UWorld* World, const FPortalRegistry& Registry, float QueryRadius, int32 PoolSize);
+
+    // Give back the proxies mirrored by the portal
+    void RemovePortal(APortal_Actor* Portal);
+
+    // Give back every proxy, the pool stays
+    void ReleaseAll();
+
+    // Forget everything, pool included (the world is going away)
+    void Reset();
+
+    int32 NumActiveProxies() const;
+
+    // Straddling actors left without a proxy last update (pool too small)
+    int32 NumMissedProxies() const;
+
+private:
+    struct FProxied
+    {
+        TWeakObjectPtr<AActor> Actor;
+
+        AStaticMeshActor* Proxy = nullptr;
+        APortal_Actor* Portal = nullptr;
+
+        // The actor went through, the proxy is on the portal side
+        bool bThrough = false;
+
+        // Response of the actor to the proxies before it had one
+        ECollisionResponse SourceProxyResponse = ECR_Block;
+    };
+
+    // Signed distance of Location to the portal plane, false outside the opening
+    static bool GetPlaneDistance(APortal_Actor* Portal, const FVector& Location, float& OutDistance);
+
+    // Portal whose opening the bounds straddle, on either side of the link
+    APortal_Actor* FindStraddledPortal(const FProxied& Tracked, const FPortalRegistry& Registry, float QueryRadius, const FVector& Origin, float Radius, bool& bOutThrough);
+
+    void FillPool(UWorld* World, int32 PoolSize);
+
+    AStaticMeshActor* AcquireProxy(FProxied& Tracked, UStaticMeshComponent* Source);
+    void ReleaseProxy(FProxied& Tracked);
+
+    TArray<FProxied> Proxied;
+
+    // Every proxy spawned, and the unused ones
+    TArray<AStaticMeshActor*> Pool;
+    TArray<AStaticMeshActor*> FreeProxies;
+
+    int32 NumActive;
+    int32 NumMissed;
+
+    // Scratch, reused every query
+    TArray<APortal_Actor*> NearbyPortals;
+};
@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalRegistry.h"
+#include "Portal_Actor.h"
+
+FPortalRegistry::FPortalRegistry(float InCellSize)
+	: CellSize(FMath::Max(InCellSize, 1.0f))
+{
+}
+
+FIntVector FPortalRegistry::GetCell(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / CellSize),
+		FMath::FloorToInt(Location.Y / CellSize),
+		FMath::FloorToInt(Location.Z / CellSize));
+}
+
+void FPortalRegistry::Register(APortal_Actor* Portal)
+{
+	if (Portal == nullptr || EntryIndices.Contains(Portal))
+	{
+		return;
+	}
+
+	FEntry Entry;
+	Entry.Portal = Portal;
+	Entry.Bounds = FBox(ForceInit);
+	Entry.MinCell = FIntVector(0, 0, 0);
+	Entry.MaxCell = FIntVector(-1, -1, -1); // Empty range until bucketed
+
+	int32 EntryIndex = Entries.Add(Entry);
+	EntryIndices.Add(Portal, EntryIndex);
+
+	AddToCells(EntryIndex);
+}
+
+void FPortalRegistry::Unregister(APortal_Actor* Portal)
+{
+	int32 EntryIndex = INDEX_NONE;
+
+	if (!EntryIndices.RemoveAndCopyValue(Portal, EntryIndex))
+	{
+		return;
+	}
+
+	RemoveFromCells(EntryIndex);
+	Entries.RemoveAt(EntryIndex);
+}
+
+void FPortalRegistry::Refresh(APortal_Actor* Portal)
+{
+	const int32* EntryIndex = EntryIndices.Find(Portal);
+
+	if (EntryIndex != nullptr)
+	{
+		RemoveFromCells(*EntryIndex);
+		AddToCells(*EntryIndex);
+	}
+}
+
+void FPortalRegistry::Reset()
+{
+	Entries.Empty();
+	EntryIndices.Empty();
+	Cells.Empty();
+}
+
+void FPortalRegistry::AddToCells(int32 EntryIndex)
+{
+	FEntry& Entry = Entries[EntryIndex];
+	APortal_Actor* Portal = Entry.Portal.Get();
+
+	if (Portal == nullptr)
+	{
+		return;
+	}
+
+	//-----------------------------------
+	// Bucket the portal bounds, the actor location is always
+	// included so that distance queries can rely on it
+	//-----------------------------------
+	FVector Origin;
+	FVector Extent;
+	Portal->GetActorBounds(false, Origin, Extent);
+
+	Entry.Bounds = FBox(Origin - Extent, Origin + Extent);
+	Entry.Bounds += Portal->GetActorLocation();
+
+	Entry.MinCell = GetCell(Entry.Bounds.Min);
+	Entry.MaxCell = GetCell(Entry.Bounds.Max);
+
+	for (int32 X = Entry.MinCell.X; X <= Entry.MaxCell.X; X++)
+	{
+		for (int32 Y = Entry.MinCell.Y; Y <= Entry.MaxCell.Y; Y++)
+		{
+			for (int32 Z = Entry.MinCell.Z; Z <= Entry.MaxCell.Z; Z++)
+			{
+				Cells.FindOrAdd(FIntVector(X, Y, Z)).Add(EntryIndex);
+			}
+		}
+	}
+}
+
+void FPortalRegistry::RemoveFromCells(int32 EntryIndex)
+{
+	const FEntry& Entry = Entries[EntryIndex];
+
+	for (int32 X = Entry.MinCell.X; X <= Entry.MaxCell.X; X++)
+	{
+		for (int32 Y = Entry.MinCell.Y; Y <= Entry.MaxCell.Y; Y++)
+		{
+			for (int32 Z = Entry.MinCell.Z; Z <= Entry.MaxCell.Z; Z++)
+			{
+				FIntVector Cell = FIntVector(X, Y, Z);
+				TArray<int32>* CellEntries = Cells.Find(Cell);
+
+				if (CellEntries != nullptr)
+				{
+					CellEntries->RemoveSingleSwap(EntryIndex);
+
+					if (CellEntries->Num() == 0)
+					{
+						Cells.Remove(Cell);
+					}
+				}
+			}
+		}
+	}
+}
+
+APortal_Actor* FPortalRegistry::FindNearest(const FVector& Location, float MaxDistance) const
+{
+	APortal_Actor* Nearest = nullptr;
+	float NearestDistSquared = FMath::Square(MaxDistance);
+
+	FIntVector Center = GetCell(Location);
+	int32 MaxRing = FMath::CeilToInt(MaxDistance / CellSize);
+
+	//-----------------------------------
+	// Walk shells of cells around the query point, stop as soon as
+	// the next shell cannot contain anything closer than what we have
+	//-----------------------------------
+	for (int32 Ring = 0; Ring <= MaxRing; Ring++)
+	{
+		for (int32 X = -Ring; X <= Ring; X++)
+		{
+			for (int32 Y = -Ring; Y <= Ring; Y++)
+			{
+				for (int32 Z = -Ring; Z <= Ring; Z++)
+				{
+					// Only the surface of the shell, the inside was visited already
+					if (FMath::Max3(FMath::Abs(X), FMath::Abs(Y), FMath::Abs(Z)) != Ring)
+					{
+						continue;
+					}
+
+					const TArray<int32>* CellEntries = Cells.Find(Center + FIntVector(X, Y, Z));
+
+					if (CellEntries == nullptr)
+					{
+						continue;
+					}
+
+					for (int32 EntryIndex : *CellEntries)
+					{
+						APortal_Actor* Portal = Entries[EntryIndex].Portal.Get();
+
+						if (Portal == nullptr)
+						{
+							continue;
+						}
+
+						float DistSquared = FVector::DistSquared(Location, Portal->GetActorLocation());
+
+						if (DistSquared < NearestDistSquared)
+						{
+							NearestDistSquared = DistSquared;
+							Nearest = Portal;
+						}
+					}
+				}
+			}
+		}
+
+		if (Nearest != nullptr && NearestDistSquared <= FMath::Square(Ring * CellSize))
+		{
+			break;
+		}
+	}
+
+	return Nearest;
+}
+
+void FPortalRegistry::QuerySphere(const FVector& Location, float Radius, TArray<APortal_Actor*>& OutPortals) const
+{
+	FIntVector MinCell = GetCell(Location - FVector(Radius));
+	FIntVector MaxCell = GetCell(Location + FVector(Radius));
+	float RadiusSquared = FMath::Square(Radius);
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+			{
+				const TArray<int32>* CellEntries = Cells.Find(FIntVector(X, Y, Z));
+
+				if (CellEntries == nullptr)
+				{
+					continue;
+				}
+
+				for (int32 EntryIndex : *CellEntries)
+				{
+					const FEntry& Entry = Entries[EntryIndex];
+					APortal_Actor* Portal = Entry.Portal.Get();
+
+					if (Portal == nullptr || OutPortals.Contains(Portal))
+					{
+						continue;
+					}
+
+					if (Entry.Bounds.ComputeSquaredDistanceToPoint(Location) <= RadiusSquared)
+					{
+						OutPortals.Add(Portal);
+					}
+				}
+			}
+		}
+	}
+}
+
+bool FPortalRegistry::Contains(const APortal_Actor* Portal) const
+{
+	return EntryIndices.Contains(Portal);
+}
+
+int32 FPortalRegistry::Num() const
+{
+	return Entries.Num();
+}
+
+void FPortalRegistry::GetPortals(TArray<APortal_Actor*>& OutPortals) const
+{
+	for (const FEntry& Entry : Entries)
+	{
+		APortal_Actor* Portal = Entry.Portal.Get();
+
+		if (Portal != nullptr)
+		{
+			OutPortals.Add(Portal);
+		}
+	}
+}
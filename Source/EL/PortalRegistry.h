@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Forward declaration
+class APortal_Actor;
+
+/**
+ * Persistent list of the portals alive in the world, bucketed into
+ * a uniform hash grid over their bounds so that nearest/visible
+ * queries only touch the cells around the query point.
+ */
+class EL_API FPortalRegistry
+{
+public:
+    FPortalRegistry(float InCellSize = 1024.0f);
+
+    // Add a portal (does nothing if already registered)
+    void Register(APortal_Actor* Portal);
+
+    // Remove a portal from the registry and the grid
+    void Unregister(APortal_Actor* Portal);
+
+    // Re-bucket a portal after it moved
+    void Refresh(APortal_Actor* Portal);
+
+    // Remove everything
+    void Reset();
+
+    // Closest portal (by actor location) within MaxDistance, nullptr if none
+    APortal_Actor* FindNearest(const FVector& Location, float MaxDistance) const;
+
+    // All portals whose bounds overlap the sphere
+    void QuerySphere(const FVector& Location, float Radius, TArray<APortal_Actor*>& OutPortals) const;
+
+    bool Contains(const APortal_Actor* Portal) const;
+
+    int32 Num() const;
+
+    // Registered portals, in registration order
+    void GetPortals(TArray<APortal_Actor*>& OutPortals) const;
+
+private:
+    struct FEntry
+    {
+        TWeakObjectPtr<APortal_Actor> Portal;
+        FBox Bounds;
+        FIntVector MinCell;
+        FIntVector MaxCell;
+    };
+
+    FIntVector GetCell(const FVector& Location) const;
+
+    void AddToCells(int32 EntryIndex);
+    void RemoveFromCells(int32 EntryIndex);
+
+    float CellSize;
+
+    TSparseArray<FEntry> Entries;
+
+    TMap<const APortal_Actor*, int32> EntryIndices;
+
+    TMap<FIntVector, TArray<int32>> Cells;
+};
@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalScalability.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ConfigCacheIni.h"
+
+static TAutoConsoleVariable<int32> CVarPortalQuality(
+	TEXT("sg.PortalQuality"),
+	-1,
+	TEXT("Scalability group of the portal captures, applies [PortalQuality@N] from Scalability.ini.\n")
+	TEXT("-1: follow sg.EffectsQuality (default)\n")
+	TEXT(" 0: low, 1: medium, 2: high, 3: epic, 4: cinematic"),
+	ECVF_ScalabilityGroup);
+
+static TAutoConsoleVariable<int32> CVarPortalTargetFormat(
+	TEXT("r.Portal.TargetFormat"),
+	0,
+	TEXT("Format of the portal render targets.\n")
+	TEXT(" 0: RGBA16f, 8 bytes per pixel (default)\n")
+	TEXT(" 1: RGB10A2, 4 bytes per pixel, highlights above 1 are clamped\n")
+	TEXT(" 2: RGBA8, 4 bytes per pixel, highlights above 1 are clamped"),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarPortalResolutionScale(
+	TEXT("r.Portal.ResolutionScale"),
+	1.0f / 1.7f,
+	TEXT("Size of the portal render targets relative to the viewport."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<float> CVarPortalLODDistanceFactor(
+	TEXT("r.Portal.LODDistanceFactor"),
+	3.0f,
+	TEXT("LOD distance factor of the portal captures, higher values use lower LODs."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalCaptureInterval(
+	TEXT("r.Portal.CaptureInterval"),
+	1,
+	TEXT("Frames between two captures of the same portal, 1 captures every frame."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalShadows(
+	TEXT("r.Portal.Shadows"),
+	1,
+	TEXT("Render dynamic shadows in the portal captures."),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalPostProcessQuality(
+	TEXT("r.Portal.PostProcessQuality"),
+	1,
+	TEXT("Post-process of the portal captures (motion blur, fringe and grain are always disabled).\n")
+	TEXT(" 0: no ambient occlusion, reflections or bloom\n")
+	TEXT(" 1: no ambient occlusion or reflections (default)\n")
+	TEXT(" 2: ambient occlusion and reflections enabled"),
+	ECVF_Scalability);
+
+static TAutoConsoleVariable<int32> CVarPortalMaxCaptures(
+	TEXT("r.Portal.MaxCaptures"),
+	0,
+	TEXT("Maximum amount of portals captured in the same frame, 0 uses the value of the PortalManager."),
+	ECVF_Scalability);
+
+//-----------------------------------
+// sg.PortalQuality
+//-----------------------------------
+static int32 GetPortalQualityLevel()
+{
+	int32 Level = CVarPortalQuality.GetValueOnGameThread();
+
+	if (Level < 0)
+	{
+		static IConsoleVariable* CVarEffectsQuality = IConsoleManager::Get().FindConsoleVariable(TEXT("sg.EffectsQuality"));
+		Level = CVarEffectsQuality != nullptr ? CVarEffectsQuality->GetInt() : 3;
+	}
+
+	return FMath::Clamp(Level, 0, 4);
+}
+
+// Console variables sink : apply the group once its level changed
+static void OnPortalQualityChanged()
+{
+	static int32 AppliedLevel = INDEX_NONE;
+
+	int32 Level = GetPortalQualityLevel();
+
+	if (Level == AppliedLevel || GScalabilityIni.IsEmpty())
+	{
+		return;
+	}
+
+	AppliedLevel = Level;
+
+	// Cinematic uses the "Cine" section, like the engine groups
+	if (Level == 4)
+	{
+		ApplyCVarSettingsFromIni(TEXT("PortalQuality@Cine"), *GScalabilityIni, ECVF_SetByScalability);
+	}
+	else
+	{
+		ApplyCVarSettingsGroupFromIni(TEXT("PortalQuality"), Level, *GScalabilityIni, ECVF_SetByScalability);
+	}
+}
+
+static FAutoConsoleVariableSink PortalQualitySink(FConsoleCommandDelegate::CreateStatic(&OnPortalQualityChanged));
+
+//-----------------------------------
+// FPortalQualitySettings
+//-----------------------------------
+FPortalQualitySettings FPortalQualitySettings::Get()
+{
+	FPortalQualitySettings Settings;
+
+	switch (CVarPortalTargetFormat.GetValueOnGameThread())
+	{
+	case 1:
+		Settings.TargetFormat = RTF_RGB10A2;
+		break;
+
+	case 2:
+		Settings.TargetFormat = RTF_RGBA8;
+		break;
+
+	default:
+		Settings.TargetFormat = RTF_RGBA16f;
+		break;
+	}
+
+	Settings.ResolutionScale = FMath::Clamp(CVarPortalResolutionScale.GetValueOnGameThread(), 0.1f, 1.0f);
+	Settings.LODDistanceFactor = FMath::Max(CVarPortalLODDistanceFactor.GetValueOnGameThread(), 0.1f);
+	Settings.CaptureInterval = FMath::Max(CVarPortalCaptureInterval.GetValueOnGameThread(), 1);
+	Settings.bDynamicShadows = CVarPortalShadows.GetValueOnGameThread() != 0;
+	Settings.PostProcessQuality = FMath::Clamp(CVarPortalPostProcessQuality.GetValueOnGameThread(), 0, 2);
+	Settings.MaxCaptures = FMath::Max(CVarPortalMaxCaptures.GetValueOnGameThread(), 0);
+
+	return Settings;
+}
+
+bool FPortalQualitySettings::RequiresNewRenderTargets(const FPortalQualitySettings& Other) const
+{
+	return TargetFormat != Other.TargetFormat
+		|| ResolutionScale != Other.ResolutionScale
+		|| MaxCaptures != Other.MaxCaptures;
+}
+
+bool FPortalQualitySettings::operator==(const FPortalQualitySettings& Other) const
+{
+	return !RequiresNewRenderTargets(Other)
+		&& LODDistanceFactor == Other.LODDistanceFactor
+		&& CaptureInterval == Other.CaptureInterval
+		&& bDynamicShadows == Other.bDynamicShadows
+		&& PostProcessQuality == Other.PostProcessQuality;
+}
+
+bool FPortalQualitySettings::operator!=(const FPortalQualitySettings& Other) const
+{
+	return !(*this == Other);
+}
+
+float FPortalQualitySettings::GetBytesPerPixel() const
+{
+	return TargetFormat == RTF_RGBA16f ? 8.0f : 4.0f;
+}
+
+void FPortalQualitySettings::ApplyToSceneCapture(USceneCaptureComponent2D* SceneCapture) const
+{
+	SceneCapture->LODDistanceFactor = LODDistanceFactor;
+
+	SceneCapture->ShowFlags.SetDynamicShadows(bDynamicShadows);
+	SceneCapture->ShowFlags.SetBloom(PostProcessQuality >= 1);
+	SceneCapture->ShowFlags.SetAmbientOcclusion(PostProcessQuality >= 2);
+	SceneCapture->ShowFlags.SetScreenSpaceReflections(PostProcessQuality >= 2);
+
+	//Setup Post-Process of SceneCapture (optimization : disable Motion Blur, etc)
+	FPostProcessSettings& CaptureSettings = SceneCapture->PostProcessSettings;
+
+	CaptureSettings.bOverride_AmbientOcclusionQuality = PostProcessQuality < 2;
+	CaptureSettings.bOverride_ScreenSpaceReflectionQuality = PostProcessQuality < 2;
+	CaptureSettings.bOverride_MotionBlurAmount = true;
+	CaptureSettings.bOverride_SceneFringeIntensity = true;
+	CaptureSettings.bOverride_GrainIntensity = true;
+
+	CaptureSettings.AmbientOcclusionQuality = 0.0f; //0=lowest quality..100=maximum quality
+	CaptureSettings.ScreenSpaceReflectionQuality = 0.0f; //0 = disabled
+	CaptureSettings.MotionBlurAmount = 0.0f; //0 = disabled
+	CaptureSettings.SceneFringeIntensity = 0.0f; //0 = disabled
+	CaptureSettings.GrainIntensity = 0.0f; //0 = disabled
+
+	CaptureSettings.bOverride_ScreenPercentage = true;
+	CaptureSettings.ScreenPercentage = 100.0f;
+}
@@ -0,0 +1,53 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/TextureRenderTarget2D.h"
+
+//Forward declaration
+class USceneCaptureComponent2D;
+
+/**
+ * Capture quality of the portals, read from the r.Portal.* console variables.
+ *
+ * The variables are set by the "sg.PortalQuality" scalability group
+ * (0 = low .. 3 = epic, 4 = cinematic) from the [PortalQuality@N] sections
+ * of Config/DefaultScalability.ini. When sg.PortalQuality is -1 the group
+ * follows sg.EffectsQuality, so the engine quality presets drive it too.
+ * Changes are picked up by the PortalManagers on their next update.
+ */
+struct EL_API FPortalQualitySettings
+{
+    ETextureRenderTargetFormat TargetFormat = RTF_RGBA16f;
+
+    // Size of the render targets relative to the viewport
+    float ResolutionScale = 1.0f;
+
+    float LODDistanceFactor = 3.0f;
+
+    // Frames between two captures of the same portal (multiplies the update rates)
+    int32 CaptureInterval = 1;
+
+    bool bDynamicShadows = true;
+
+    // 0 = no AO/SSR/bloom, 1 = no AO/SSR, 2 = AO and SSR enabled
+    int32 PostProcessQuality = 1;
+
+    // 0 = use APortalManager::MaxCaptures
+    int32 MaxCaptures = 0;
+
+    // Current values of the console variables (game thread)
+    static FPortalQualitySettings Get();
+
+    // Format, size or amount of the render targets changed
+    bool RequiresNewRenderTargets(const FPortalQualitySettings& Other) const;
+
+    bool operator==(const FPortalQualitySettings& Other) const;
+    bool operator!=(const FPortalQualitySettings& Other) const;
+
+    float GetBytesPerPixel() const;
+
+    // LOD, shadows and post-process of a capture
+    void ApplyToSceneCapture(USceneCaptureComponent2D* SceneCapture) const;
+};
@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalStats.h"
+#include "RenderingThread.h"
+#include "RHI.h"
+#include "RHICommandList.h"
+
+DEFINE_STAT(STAT_PortalTick);
+DEFINE_STAT(STAT_PortalCrossings);
+DEFINE_STAT(STAT_PortalTeleport);
+DEFINE_STAT(STAT_PortalProxies);
+DEFINE_STAT(STAT_PortalStreaming);
+DEFINE_STAT(STAT_PortalAudio);
+DEFINE_STAT(STAT_PortalEffects);
+DEFINE_STAT(STAT_PortalUpdate);
+DEFINE_STAT(STAT_PortalScan);
+DEFINE_STAT(STAT_PortalVisibility);
+DEFINE_STAT(STAT_PortalGenerateTexture);
+DEFINE_STAT(STAT_PortalRenderTargetPool);
+DEFINE_STAT(STAT_PortalCaptureSetup);
+DEFINE_STAT(STAT_PortalCaptureScene);
+DEFINE_STAT(STAT_PortalRecursion);
+DEFINE_STAT(STAT_PortalPrewarm);
+
+DEFINE_STAT(STAT_PortalsConsidered);
+DEFINE_STAT(STAT_PortalsCaptured);
+DEFINE_STAT(STAT_PortalsSkipped);
+DEFINE_STAT(STAT_PortalsShared);
+DEFINE_STAT(STAT_PortalRecursiveCaptures);
+DEFINE_STAT(STAT_PortalsPrewarmed);
+DEFINE_STAT(STAT_PortalPrewarmHits);
+DEFINE_STAT(STAT_PortalCrossingPairs);
+DEFINE_STAT(STAT_PortalActiveProxies);
+DEFINE_STAT(STAT_PortalMissedProxies);
+DEFINE_STAT(STAT_PortalStreamingRequests);
+DEFINE_STAT(STAT_PortalAudioVirtual);
+DEFINE_STAT(STAT_PortalAudioCulled);
+DEFINE_STAT(STAT_PortalEffectsTracked);
+DEFINE_STAT(STAT_PortalEffectsCulled);
+DEFINE_STAT(STAT_PortalEffectsHiddenFromCaptures);
+DEFINE_STAT(STAT_PortalNetTeleports);
+DEFINE_STAT(STAT_PortalNetRejected);
+DEFINE_STAT(STAT_PortalNetCorrections);
+
+DEFINE_STAT(STAT_PortalRenderTargetMemory);
+DEFINE_STAT(STAT_PortalCaptureGpuTime);
+
+CSV_DEFINE_CATEGORY_MODULE(EL_API, Portal, true);
+
+struct FPortalGpuTimer::FState
+{
+	// Declared first : the queries must go back to it before it is released
+	FRenderQueryPoolRHIRef QueryPool;
+
+	struct FCapture
+	{
+		FRHIPooledRenderQuery Begin;
+		FRHIPooledRenderQuery End;
+		uint64 Frame;
+	};
+
+	TArray<FCapture> PendingCaptures;
+
+	FRHIPooledRenderQuery OpenQuery;
+
+	// Frame being summed up
+	uint64 ResolvingFrame = 0;
+	double ResolvingTimeMs = 0.0;
+};
+
+// More than this in flight means the results are not read, drop the oldest
+static const int32 MaxPendingCaptures = 64;
+
+FPortalGpuTimer::FPortalGpuTimer()
+	: State(MakeShared<FState, ESPMode::ThreadSafe>())
+{
+}
+
+FPortalGpuTimer::~FPortalGpuTimer()
+{
+	// Release the queries where they are used
+	TSharedPtr<FState, ESPMode::ThreadSafe> OldState = MoveTemp(State);
+
+	ENQUEUE_RENDER_COMMAND(PortalGpuTimerRelease)(
+		[OldState](FRHICommandListImmediate& RHICmdList) mutable
+	{
+		OldState.Reset();
+	});
+}
+
+void FPortalGpuTimer::BeginCapture()
+{
+	ENQUEUE_RENDER_COMMAND(PortalGpuTimerBegin)(
+		[State = State](FRHICommandListImmediate& RHICmdList)
+	{
+		if (!GSupportsTimestampRenderQueries)
+		{
+			return;
+		}
+
+		if (!State->QueryPool.IsValid())
+		{
+			State->QueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime);
+		}
+
+		State->OpenQuery = State->QueryPool->AllocateQuery();
+		RHICmdList.EndRenderQuery(State->OpenQuery.GetQuery());
+	});
+}
+
+void FPortalGpuTimer::EndCapture()
+{
+	ENQUEUE_RENDER_COMMAND(PortalGpuTimerEnd)(
+		[State = State, Frame = GFrameCounter](FRHICommandListImmediate& RHICmdList)
+	{
+		if (!State->OpenQuery.IsValid())
+		{
+			return;
+		}
+
+		FState::FCapture& Capture = State->PendingCaptures.AddDefaulted_GetRef();
+		Capture.Begin = MoveTemp(State->OpenQuery);
+		Capture.End = State->QueryPool->AllocateQuery();
+		Capture.Frame = Frame;
+
+		RHICmdList.EndRenderQuery(Capture.End.GetQuery());
+	});
+}
+
+void FPortalGpuTimer::Update()
+{
+	ENQUEUE_RENDER_COMMAND(PortalGpuTimerResolve)(
+		[State = State](FRHICommandListImmediate& RHICmdList)
+	{
+		int32 Resolved = 0;
+
+		//-----------------------------------
+		// Oldest first, stop at the first one still in flight
+		// (never wait for the GPU)
+		//-----------------------------------
+		for (FState::FCapture& Capture : State->PendingCaptures)
+		{
+			uint64 BeginTime = 0;
+			uint64 EndTime = 0;
+
+			if (!RHIGetRenderQueryResult(Capture.Begin.GetQuery(), BeginTime, false)
+				|| !RHIGetRenderQueryResult(Capture.End.GetQuery(), EndTime, false))
+			{
+				break;
+			}
+
+			// Every capture of the previous frame is known, publish it
+			if (Capture.Frame != State->ResolvingFrame)
+			{
+				if (State->ResolvingFrame != 0)
+				{
+					SET_FLOAT_STAT(STAT_PortalCaptureGpuTime, State->ResolvingTimeMs);
+					CSV_CUSTOM_STAT(Portal, CaptureGpuTime, float(State->ResolvingTimeMs), ECsvCustomStatOp::Set);
+				}
+
+				State->ResolvingFrame = Capture.Frame;
+				State->ResolvingTimeMs = 0.0;
+			}
+
+			// Timestamps are in microseconds
+			State->ResolvingTimeMs += (EndTime - BeginTime) / 1000.0;
+			Resolved++;
+		}
+
+		if (State->PendingCaptures.Num() - Resolved > MaxPendingCaptures)
+		{
+			Resolved = State->PendingCaptures.Num() - MaxPendingCaptures;
+		}
+
+		State->PendingCaptures.RemoveAt(0, Resolved);
+	});
+}
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+// "stat portal"
+DECLARE_STATS_GROUP(TEXT("Portal"), STATGROUP_Portal, STATCAT_Advanced);
+
+// Game thread time per stage
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Subsystem Tick"), STAT_PortalTick, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Crossings"), STAT_PortalCrossings, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Teleport"), STAT_PortalTeleport, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Physics Proxies"), STAT_PortalProxies, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Streaming"), STAT_PortalStreaming, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Audio"), STAT_PortalAudio, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Effect Significance"), STAT_PortalEffects, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Manager Update"), STAT_PortalUpdate, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Portal Scan"), STAT_PortalScan, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Visibility Sets"), STAT_PortalVisibility, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Portal Texture"), STAT_PortalGenerateTexture, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Render Target Pool"), STAT_PortalRenderTargetPool, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Capture Setup"), STAT_PortalCaptureSetup, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Capture Scene"), STAT_PortalCaptureScene, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Recursion"), STAT_PortalRecursion, STATGROUP_Portal, EL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Prewarm"), STAT_PortalPrewarm, STATGROUP_Portal, EL_API);
+
+// Per frame counts
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Portals Considered"), STAT_PortalsConsidered, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Portals Captured"), STAT_PortalsCaptured, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Portals Skipped"), STAT_PortalsSkipped, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Portals Shared"), STAT_PortalsShared, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Recursive Captures"), STAT_PortalRecursiveCaptures, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Portals Prewarmed"), STAT_PortalsPrewarmed, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Prewarm Hits"), STAT_PortalPrewarmHits, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Crossing Pairs"), STAT_PortalCrossingPairs, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Active Proxies"), STAT_PortalActiveProxies, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Missed Proxies"), STAT_PortalMissedProxies, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Streaming Requests"), STAT_PortalStreamingRequests, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Virtual Emitters"), STAT_PortalAudioVirtual, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Culled Emitters"), STAT_PortalAudioCulled, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effects Tracked"), STAT_PortalEffectsTracked, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effects Culled"), STAT_PortalEffectsCulled, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effects Hidden From Captures"), STAT_PortalEffectsHiddenFromCaptures, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Predicted Teleports"), STAT_PortalNetTeleports, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rejected Teleports"), STAT_PortalNetRejected, STATGROUP_Portal, EL_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Movement Corrections"), STAT_PortalNetCorrections, STATGROUP_Portal, EL_API);
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Render Target Memory"), STAT_PortalRenderTargetMemory, STATGROUP_Portal, EL_API);
+
+// Resolved a few frames late
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Capture GPU Time (ms)"), STAT_PortalCaptureGpuTime, STATGROUP_Portal, EL_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(EL_API, Portal);
+
+// Cycle stat, CSV timing and Insights CPU event of one stage
+#define SCOPE_PORTAL_STAT(StageName) \
+	SCOPE_CYCLE_COUNTER(STAT_Portal##StageName); \
+	CSV_SCOPED_TIMING_STAT(Portal, StageName); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(Portal_##StageName)
+
+// Stat and CSV counter of the frame
+#define INC_PORTAL_COUNTER(StatName, Amount) \
+	INC_DWORD_STAT_BY(STAT_##StatName, Amount); \
+	CSV_CUSTOM_STAT(Portal, StatName, int32(Amount), ECsvCustomStatOp::Accumulate)
+
+/**
+ * GPU time spent in the portal captures, measured with timestamp
+ * queries around each CaptureScene() and read back without stalling
+ * once the GPU is done with them.
+ */
+class EL_API FPortalGpuTimer
+{
+public:
+    FPortalGpuTimer();
+    ~FPortalGpuTimer();
+
+    // Bracket a CaptureScene() call (game thread)
+    void BeginCapture();
+    void EndCapture();
+
+    // Publish the captures the GPU finished (game thread, once per frame)
+    void Update();
+
+private:
+    struct FState;
+
+    // Only touched on the render thread
+    TSharedPtr<FState, ESPMode::ThreadSafe> State;
+};
@@ -0,0 +1,247 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalStreaming.h"
+#include "PortalRegistry.h"
+#include "Portal_Actor.h"
+#include "Engine/AssetManager.h"
+#include "Engine/LevelBounds.h"
+#include "Engine/LevelStreaming.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+
+FPortalStreamer::FPortalStreamer()
+{
+}
+
+FPortalStreamer::~FPortalStreamer()
+{
+	Reset();
+}
+
+void FPortalStreamer::Update(UWorld* World, const FPortalRegistry& Registry, TArrayView<const FPortalStreamingViewer> Viewers, const FPortalStreamingSettings& Settings)
+{
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	// Real time, a paused game keeps its requests
+	double Time = World->GetRealTimeSeconds();
+
+	for (const FPortalStreamingViewer& Viewer : Viewers)
+	{
+		//-----------------------------------
+		// The way ahead of the player, so that a fast
+		// player starts streaming sooner
+		//-----------------------------------
+		FVector Ahead = Viewer.Location + Viewer.Velocity * Settings.LookAheadTime;
+		float QueryRadius = Settings.ReleaseDistance + FVector::Dist(Viewer.Location, Ahead);
+
+		NearbyPortals.Reset();
+		Registry.QuerySphere(Viewer.Location, QueryRadius, NearbyPortals);
+
+		for (APortal_Actor* Portal : NearbyPortals)
+		{
+			FRequest* Request = Requests.Find(Portal);
+
+			if (Request == nullptr && !Portal->HasTargetStreaming())
+			{
+				continue;
+			}
+
+			float Distance = FMath::PointDistToSegment(Portal->GetActorLocation(), Viewer.Location, Ahead);
+
+			if (Request != nullptr)
+			{
+				if (Distance <= Settings.ReleaseDistance)
+				{
+					Request->LastWantedTime = Time;
+				}
+			}
+			else if (Distance <= Settings.RequestDistance)
+			{
+				AddRequest(World, Portal, Time);
+			}
+		}
+	}
+
+	//-----------------------------------
+	// Release the portals every player
+	// left for long enough
+	//-----------------------------------
+	ExpiredPortals.Reset();
+
+	for (const TPair<APortal_Actor*, FRequest>& Pair : Requests)
+	{
+		if (Time - Pair.Value.LastWantedTime > Settings.ReleaseDelay)
+		{
+			ExpiredPortals.Add(Pair.Key);
+		}
+	}
+
+	for (APortal_Actor* Portal : ExpiredPortals)
+	{
+		RemovePortal(Portal);
+	}
+
+	UpdateLevels(Viewers);
+}
+
+void FPortalStreamer::AddRequest(UWorld* World, APortal_Actor* Portal, double Time)
+{
+	FRequest& Request = Requests.Add(Portal);
+	Request.LastWantedTime = Time;
+
+	//-----------------------------------
+	// Levels : loaded and made visible so that
+	// the capture already shows them
+	//-----------------------------------
+	for (const TSoftObjectPtr<UWorld>& LevelAsset : Portal->TargetStreamingLevels)
+	{
+		if (LevelAsset.IsNull())
+		{
+			continue;
+		}
+
+		ULevelStreaming* Level = UGameplayStatics::GetStreamingLevel(World, FName(*LevelAsset.GetLongPackageName()));
+
+		if (Level == nullptr)
+		{
+			continue;
+		}
+
+		Request.Levels.Add(Level);
+
+		FLevelState& State = Levels.FindOrAdd(Level);
+
+		// Leave alone what something else loaded
+		if (State.RefCount++ == 0 && !State.bOwned && !Level->ShouldBeLoaded())
+		{
+			State.bOwned = true;
+		}
+
+		if (State.bOwned)
+		{
+			Level->SetShouldBeLoaded(true);
+			Level->SetShouldBeVisible(true);
+		}
+	}
+
+	//-----------------------------------
+	// Assets : kept loaded by the handles
+	//-----------------------------------
+	if (!UAssetManager::IsValid())
+	{
+		return;
+	}
+
+	if (Portal->TargetAssets.Num() > 0)
+	{
+		Request.AssetHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(Portal->TargetAssets, FStreamableDelegate(), FStreamableManager::AsyncLoadHighPriority);
+	}
+
+	// Preloading doesn't change the bundle state of the assets
+	if (Portal->TargetPrimaryAssets.Num() > 0)
+	{
+		Request.PrimaryAssetHandle = UAssetManager::Get().PreloadPrimaryAssets(Portal->TargetPrimaryAssets, Portal->TargetAssetBundles, false);
+	}
+}
+
+void FPortalStreamer::ReleaseRequest(FRequest& Request)
+{
+	if (Request.AssetHandle.IsValid())
+	{
+		Request.AssetHandle->ReleaseHandle();
+	}
+
+	if (Request.PrimaryAssetHandle.IsValid())
+	{
+		Request.PrimaryAssetHandle->ReleaseHandle();
+	}
+
+	// Unloaded by UpdateLevels() once unused
+	for (const TWeakObjectPtr<ULevelStreaming>& Level : Request.Levels)
+	{
+		FLevelState* State = Levels.Find(Level);
+
+		if (State != nullptr)
+		{
+			State->RefCount = FMath::Max(State->RefCount - 1, 0);
+		}
+	}
+}
+
+void FPortalStreamer::UpdateLevels(TArrayView<const FPortalStreamingViewer> Viewers)
+{
+	for (auto It = Levels.CreateIterator(); It; ++It)
+	{
+		ULevelStreaming* Level = It.Key().Get();
+		FLevelState& State = It.Value();
+
+		if (Level == nullptr)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		if (!State.bBoundsValid && Level->GetLoadedLevel() != nullptr && Level->IsLevelVisible())
+		{
+			State.Bounds = ALevelBounds::CalculateLevelBounds(Level->GetLoadedLevel());
+			State.bBoundsValid = true;
+		}
+
+		if (State.RefCount > 0)
+		{
+			continue;
+		}
+
+		if (State.bOwned)
+		{
+			//-----------------------------------
+			// A player that went through stands in the
+			// target level, keep it until they leave it
+			//-----------------------------------
+			bool bViewerInside = State.bBoundsValid && Viewers.ContainsByPredicate([&State](const FPortalStreamingViewer& Viewer)
+			{
+				return State.Bounds.IsInsideOrOn(Viewer.Location);
+			});
+
+			if (bViewerInside)
+			{
+				continue;
+			}
+
+			Level->SetShouldBeLoaded(false);
+			Level->SetShouldBeVisible(false);
+		}
+
+		It.RemoveCurrent();
+	}
+}
+
+void FPortalStreamer::RemovePortal(APortal_Actor* Portal)
+{
+	FRequest Request;
+
+	if (Requests.RemoveAndCopyValue(Portal, Request))
+	{
+		ReleaseRequest(Request);
+	}
+}
+
+void FPortalStreamer::Reset()
+{
+	for (TPair<APortal_Actor*, FRequest>& Pair : Requests)
+	{
+		ReleaseRequest(Pair.Value);
+	}
+
+	Requests.Empty();
+	Levels.Empty();
+}
+
+int32 FPortalStreamer::NumRequests() const
+{
+	return Requests.Num();
+}
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Forward declaration
+class APortal_Actor;
+class FPortalRegistry;
+class ULevelStreaming;
+class UWorld;
+struct FStreamableHandle;
+
+// Where a player is and where it is heading
+struct FPortalStreamingViewer
+{
+    FVector Location;
+    FVector Velocity;
+};
+
+struct FPortalStreamingSettings
+{
+    // Stream in when a player is (or will be) this close to the portal
+    float RequestDistance = 3000.0f;
+
+    // Release when every player is further away than this (hysteresis)
+    float ReleaseDistance = 4500.0f;
+
+    // Seconds of the current velocity added ahead of the players
+    float LookAheadTime = 2.0f;
+
+    // Seconds out of range before releasing
+    float ReleaseDelay = 3.0f;
+};
+
+/**
+ * Streams in the target side of the portals (APortal_Actor::TargetStreamingLevels,
+ * TargetAssets and TargetPrimaryAssets) before the players reach them, so that
+ * a teleport never waits on a level or an asset.
+ *
+ * Levels are reference counted between the portals sharing them, and only
+ * the levels this streamer turned on are turned off again (never the level
+ * a player is standing in). Assets are kept by their streamable handles.
+ */
+class EL_API FPortalStreamer
+{
+public:
+    FPortalStreamer();
+    ~FPortalStreamer();
+
+    // Request/release the portals around the viewers
+    void Update(UWorld* World, const FPortalRegistry& Registry, TArrayView<const FPortalStreamingViewer> Viewers, const FPortalStreamingSettings& Settings);
+
+    // Release what the portal requested
+    void RemovePortal(APortal_Actor* Portal);
+
+    // Release the assets and forget the levels (the world is going away)
+    void Reset();
+
+    // Portals with their target side requested
+    int32 NumRequests() const;
+
+private:
+    struct FRequest
+    {
+        TArray<TWeakObjectPtr<ULevelStreaming>> Levels;
+        TSharedPtr<FStreamableHandle> AssetHandle;
+        TSharedPtr<FStreamableHandle> PrimaryAssetHandle;
+        double LastWantedTime = 0.0;
+    };
+
+    struct FLevelState
+    {
+        int32 RefCount = 0;
+
+        // Loaded by us, unloaded once unused
+        bool bOwned = false;
+
+        // Computed once loaded, to keep the level of a player
+        FBox Bounds = FBox(ForceInit);
+        bool bBoundsValid = false;
+    };
+
+    void AddRequest(UWorld* World, APortal_Actor* Portal, double Time);
+    void ReleaseRequest(FRequest& Request);
+
+    // Unload the unused levels that no viewer stands in
+    void UpdateLevels(TArrayView<const FPortalStreamingViewer> Viewers);
+
+    TMap<APortal_Actor*, FRequest> Requests;
+
+    TMap<TWeakObjectPtr<ULevelStreaming>, FLevelState> Levels;
+
+    // Scratch, reused every update
+    TArray<APortal_Actor*> NearbyPortals;
+    TArray<APortal_Actor*> ExpiredPortals;
+};
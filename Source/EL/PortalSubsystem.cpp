@@ -0,0 +1,610 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalSubsystem.h"
+#include "PortalManager.h"
+#include "Portal_Actor.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Level.h"
+#include "GameFramework/Pawn.h"
+#include "Misc/CommandLine.h"
+#include "Kismet/GameplayStatics.h"
+#include "NiagaraComponent.h"
+#include "EngineUtils.h"
+
+UPortalSubsystem::UPortalSubsystem()
+{
+	CrossingQueryRadius = 512.0f;
+	bPhysicsProxies = true;
+	ProxyPoolSize = 8;
+	bShareSplitscreenCaptures = true;
+	SharedCaptureDistance = 20.0f;
+	SharedCaptureAngle = 2.0f;
+	bStreamPortalTargets = true;
+	StreamingRequestDistance = 3000.0f;
+	StreamingReleaseDistance = 4500.0f;
+	StreamingLookAheadTime = 2.0f;
+	StreamingReleaseDelay = 3.0f;
+	bPortalAudio = true;
+	PortalAudioDistance = 3000.0f;
+	PortalAudioMinAngleGain = 0.25f;
+	bCullInaudibleSounds = true;
+	bEffectSignificance = true;
+	bTrackAllEffects = true;
+	EffectCullPixelRadius = 1.5f;
+	EffectFullRatePixelRadius = 64.0f;
+	EffectMinSpawnRateScale = 0.25f;
+	EffectSpawnRateParameter = TEXT("SpawnRateScale");
+	EffectReducedTickPixelRadius = 24.0f;
+	EffectReducedTickRate = 15.0f;
+	EffectCaptureHidePixelRadius = 16.0f;
+	bBenchmarkRequested = false;
+	LastTickTimeMs = 0.0;
+}
+
+void UPortalSubsystem::Deinitialize()
+{
+	TickFunction.Unregister();
+
+	PortalRegistry.Reset();
+	CrossingTracker.Reset();
+	Proxies.Reset();
+	Streamer.Reset();
+	PortalAudio.Reset();
+	StopTrackingAllEffects();
+	Effects.Reset();
+	StopTrackingMovableActors();
+	VisibilitySetPortals.Empty();
+	Managers.Empty();
+	SharedCaptures.Empty();
+
+	Super::Deinitialize();
+}
+
+void UPortalSubsystem::RegisterPortal(APortal_Actor* Portal)
+{
+	PortalRegistry.Register(Portal);
+
+	if (Portal != nullptr && Portal->bUseTargetVisibilitySet)
+	{
+		VisibilitySetPortals.AddUnique(Portal);
+		StartTrackingMovableActors();
+	}
+}
+
+void UPortalSubsystem::UnregisterPortal(APortal_Actor* Portal)
+{
+	PortalRegistry.Unregister(Portal);
+	CrossingTracker.RemovePortal(Portal);
+	Proxies.RemovePortal(Portal);
+	Streamer.RemovePortal(Portal);
+	PortalAudio.RemovePortal(Portal);
+
+	VisibilitySetPortals.Remove(Portal);
+
+	if (VisibilitySetPortals.Num() == 0)
+	{
+		StopTrackingMovableActors();
+	}
+
+	for (APortalManager* Manager : Managers)
+	{
+		Manager->UnregisterPortal(Portal);
+	}
+}
+
+void UPortalSubsystem::RegisterManager(APortalManager* Manager)
+{
+	if (Manager != nullptr)
+	{
+		Managers.AddUnique(Manager);
+
+		// Build agents run the benchmark from the command line
+		if (Managers.Num() == 1 && FParse::Param(FCommandLine::Get(), TEXT("PortalBenchmark")))
+		{
+			bBenchmarkRequested = true;
+		}
+
+		// Only tick worlds that have players
+		TickFunction.Register(this);
+
+		if (bTrackAllEffects)
+		{
+			StartTrackingAllEffects();
+		}
+	}
+}
+
+void UPortalSubsystem::UnregisterManager(APortalManager* Manager)
+{
+	Managers.Remove(Manager);
+}
+
+bool UPortalSubsystem::IsSplitscreen() const
+{
+	UGameInstance* GameInstance = GetWorld()->GetGameInstance();
+
+	return GameInstance != nullptr && GameInstance->GetNumLocalPlayers() > 1;
+}
+
+void UPortalSubsystem::PublishCapture(const FPortalSharedCapture& Capture)
+{
+	if (bShareSplitscreenCaptures && IsSplitscreen() && Capture.Texture != nullptr)
+	{
+		SharedCaptures.Add(Capture);
+	}
+}
+
+const FPortalSharedCapture* UPortalSubsystem::FindSharedCapture(const APortal_Actor* Portal, const APortalManager* Manager, const FVector& CaptureLocation, const FRotator& CaptureRotation, const FMatrix& ProjectionMatrix) const
+{
+	if (!bShareSplitscreenCaptures)
+	{
+		return nullptr;
+	}
+
+	for (const FPortalSharedCapture& Capture : SharedCaptures)
+	{
+		if (Capture.Portal == Portal
+			&& Capture.Manager != Manager
+			&& FVector::DistSquared(Capture.CaptureLocation, CaptureLocation) <= FMath::Square(SharedCaptureDistance)
+			&& Capture.CaptureRotation.Equals(CaptureRotation, SharedCaptureAngle)
+			&& Capture.ProjectionMatrix.Equals(ProjectionMatrix, KINDA_SMALL_NUMBER))
+		{
+			return &Capture;
+		}
+	}
+
+	return nullptr;
+}
+
+void UPortalSubsystem::TrackCrossingActor(AActor* Actor)
+{
+	CrossingTracker.TrackActor(Actor);
+	Proxies.TrackActor(Actor);
+}
+
+void UPortalSubsystem::UntrackCrossingActor(AActor* Actor)
+{
+	CrossingTracker.UntrackActor(Actor);
+	Proxies.UntrackActor(Actor);
+}
+
+void UPortalSubsystem::TrackPortalAudio(UAudioComponent* AudioComponent)
+{
+	PortalAudio.TrackEmitter(AudioComponent);
+}
+
+void UPortalSubsystem::UntrackPortalAudio(UAudioComponent* AudioComponent)
+{
+	PortalAudio.UntrackEmitter(AudioComponent);
+}
+
+bool UPortalSubsystem::PlayPortalSoundAtLocation(USoundBase* Sound, FVector Location, float VolumeMultiplier)
+{
+	if (!bPortalAudio)
+	{
+		UGameplayStatics::PlaySoundAtLocation(this, Sound, Location, VolumeMultiplier);
+		return Sound != nullptr;
+	}
+
+	GatherAudioListeners();
+
+	return PortalAudio.PlaySoundAtLocation(GetWorld(), PortalRegistry, AudioListeners, GetAudioSettings(), Sound, Location, VolumeMultiplier);
+}
+
+void UPortalSubsystem::TrackEffect(UNiagaraComponent* Effect)
+{
+	Effects.TrackEffect(Effect);
+}
+
+void UPortalSubsystem::UntrackEffect(UNiagaraComponent* Effect)
+{
+	Effects.UntrackEffect(Effect);
+}
+
+const TArray<TWeakObjectPtr<UPrimitiveComponent>>& UPortalSubsystem::GetCaptureHiddenEffects() const
+{
+	return Effects.GetCaptureHiddenEffects();
+}
+
+TArray<TWeakObjectPtr<AActor>>& UPortalSubsystem::GetMovableActors()
+{
+	return MovableActors;
+}
+
+const FPortalRegistry& UPortalSubsystem::GetRegistry() const
+{
+	return PortalRegistry;
+}
+
+FPortalCrossingTracker& UPortalSubsystem::GetCrossingTracker()
+{
+	return CrossingTracker;
+}
+
+FPortalGpuTimer& UPortalSubsystem::GetGpuTimer()
+{
+	return GpuTimer;
+}
+
+bool UPortalSubsystem::StartBenchmark(bool bExitWhenDone)
+{
+	APawn* Pawn = Managers.Num() > 0 ? Managers[0]->GetViewPawn() : nullptr;
+
+	return Pawn != nullptr && Benchmark.Start(Pawn, PortalRegistry, CrossingTracker, bExitWhenDone);
+}
+
+const FPortalBenchmark& UPortalSubsystem::GetBenchmark() const
+{
+	return Benchmark;
+}
+
+void UPortalSubsystem::Tick(float DeltaTime)
+{
+	// Drive the benchmark pawn before anything looks at it
+	if (bBenchmarkRequested && Managers.Num() > 0 && Managers[0]->GetViewPawn() != nullptr)
+	{
+		bBenchmarkRequested = false;
+
+		// Nothing to measure is a failure for the build agents
+		if (!StartBenchmark(true))
+		{
+			FPlatformMisc::RequestExitWithStatus(false, 1);
+		}
+	}
+
+	Benchmark.Tick(DeltaTime, LastTickTimeMs);
+
+	SCOPE_PORTAL_STAT(Tick);
+	double StartTime = FPlatformTime::Seconds();
+
+	//-----------------------------------
+	// Teleport what went through a portal
+	// before placing the captures
+	//-----------------------------------
+	UpdateCrossings();
+
+	// Once the crossings moved the authority to the other side
+	UpdateProxies();
+
+	UpdateStreaming();
+
+	UpdateAudio();
+
+	float RenderTargetMemoryMB = 0.0f;
+
+	// Each manager publishes what it displays during its update
+	SharedCaptures.Reset();
+
+	for (APortalManager* Manager : Managers)
+	{
+		if (Manager != nullptr)
+		{
+			Manager->Update(DeltaTime);
+			RenderTargetMemoryMB += Manager->GetRenderTargetMemoryMB();
+		}
+	}
+
+	// Once the captures of this frame are known
+	UpdateEffects();
+
+	SET_MEMORY_STAT(STAT_PortalRenderTargetMemory, int64(RenderTargetMemoryMB * 1024.0f * 1024.0f));
+	CSV_CUSTOM_STAT(Portal, RenderTargetMemoryMB, RenderTargetMemoryMB, ECsvCustomStatOp::Set);
+
+	// Read back the GPU time of the previous captures
+	GpuTimer.Update();
+
+	LastTickTimeMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+void UPortalSubsystem::UpdateCrossings()
+{
+	SCOPE_PORTAL_STAT(Crossings);
+
+	Crossings.Reset();
+	CrossingTracker.Update(PortalRegistry, CrossingQueryRadius, Crossings);
+
+	INC_PORTAL_COUNTER(PortalCrossingPairs, CrossingTracker.NumPairs());
+
+	TArray<AActor*, TInlineAllocator<8>> TeleportedActors;
+
+	for (const FPortalCrossing& Crossing : Crossings)
+	{
+		if (Crossing.Actor == nullptr || Crossing.Portal == nullptr || Crossing.Portal->GetTarget() == nullptr)
+		{
+			continue;
+		}
+
+		// Only one teleport per frame (two portals back to back)
+		if (TeleportedActors.Contains(Crossing.Actor))
+		{
+			continue;
+		}
+
+		TeleportedActors.Add(Crossing.Actor);
+
+		// A player also needs its view to be refreshed, the captures
+		// come with the update of the managers below
+		APortalManager** ViewManager = Managers.FindByPredicate([&Crossing](APortalManager* Manager)
+		{
+			return Manager->GetViewPawn() == Crossing.Actor;
+		});
+
+		if (ViewManager != nullptr)
+		{
+			(*ViewManager)->TeleportByPortal(Crossing.Portal, Crossing.Actor, false);
+		}
+		else
+		{
+			Crossing.Portal->TeleportActor(Crossing.Actor);
+		}
+
+		// Don't detect the way out of the target as another crossing
+		CrossingTracker.ResetActor(Crossing.Actor);
+	}
+}
+
+void UPortalSubsystem::UpdateProxies()
+{
+	if (!bPhysicsProxies)
+	{
+		// Hide the ones still out once, the pool stays
+		if (Proxies.NumActiveProxies() > 0 || Proxies.NumMissedProxies() > 0)
+		{
+			Proxies.ReleaseAll();
+		}
+
+		return;
+	}
+
+	SCOPE_PORTAL_STAT(Proxies);
+
+	Proxies.Update(GetWorld(), PortalRegistry, CrossingQueryRadius, ProxyPoolSize);
+
+	INC_PORTAL_COUNTER(PortalActiveProxies, Proxies.NumActiveProxies());
+	INC_PORTAL_COUNTER(PortalMissedProxies, Proxies.NumMissedProxies());
+}
+
+void UPortalSubsystem::UpdateStreaming()
+{
+	if (!bStreamPortalTargets)
+	{
+		return;
+	}
+
+	SCOPE_PORTAL_STAT(Streaming);
+
+	StreamingViewers.Reset();
+
+	for (APortalManager* Manager : Managers)
+	{
+		APawn* Pawn = Manager != nullptr ? Manager->GetViewPawn() : nullptr;
+
+		if (Pawn != nullptr)
+		{
+			StreamingViewers.Add({ Pawn->GetActorLocation(), Pawn->GetVelocity() });
+		}
+	}
+
+	FPortalStreamingSettings Settings;
+	Settings.RequestDistance = StreamingRequestDistance;
+	Settings.ReleaseDistance = FMath::Max(StreamingReleaseDistance, StreamingRequestDistance);
+	Settings.LookAheadTime = StreamingLookAheadTime;
+	Settings.ReleaseDelay = StreamingReleaseDelay;
+
+	Streamer.Update(GetWorld(), PortalRegistry, StreamingViewers, Settings);
+
+	INC_PORTAL_COUNTER(PortalStreamingRequests, Streamer.NumRequests());
+}
+
+void UPortalSubsystem::UpdateAudio()
+{
+	if (!bPortalAudio)
+	{
+		return;
+	}
+
+	SCOPE_PORTAL_STAT(Audio);
+
+	GatherAudioListeners();
+
+	PortalAudio.Update(GetWorld(), PortalRegistry, AudioListeners, GetAudioSettings());
+
+	INC_PORTAL_COUNTER(PortalAudioVirtual, PortalAudio.NumVirtualEmitters());
+	INC_PORTAL_COUNTER(PortalAudioCulled, PortalAudio.NumCulledEmitters());
+}
+
+void UPortalSubsystem::GatherAudioListeners()
+{
+	AudioListeners.Reset();
+
+	for (APortalManager* Manager : Managers)
+	{
+		FVector Location;
+		FRotator Rotation;
+
+		if (Manager != nullptr && Manager->GetViewPoint(Location, Rotation))
+		{
+			AudioListeners.Add({ Location });
+		}
+	}
+}
+
+FPortalAudioSettings UPortalSubsystem::GetAudioSettings() const
+{
+	FPortalAudioSettings Settings;
+	Settings.PortalDistance = PortalAudioDistance;
+	Settings.MinAngleGain = FMath::Clamp(PortalAudioMinAngleGain, 0.0f, 1.0f);
+	Settings.bCullInaudible = bCullInaudibleSounds;
+
+	return Settings;
+}
+
+void UPortalSubsystem::UpdateEffects()
+{
+	if (!bEffectSignificance)
+	{
+		// Give the effects back their full cost once
+		if (Effects.NumTrackedEffects() > 0)
+		{
+			StopTrackingAllEffects();
+			Effects.Reset();
+		}
+
+		return;
+	}
+
+	SCOPE_PORTAL_STAT(Effects);
+
+	if (bTrackAllEffects && !ActorSpawnedHandle.IsValid())
+	{
+		StartTrackingAllEffects();
+	}
+
+	EffectViews.Reset();
+
+	for (APortalManager* Manager : Managers)
+	{
+		if (Manager != nullptr)
+		{
+			Manager->GetEffectViews(EffectViews);
+		}
+	}
+
+	FPortalEffectSettings Settings;
+	Settings.CullPixelRadius = EffectCullPixelRadius;
+	Settings.FullRatePixelRadius = EffectFullRatePixelRadius;
+	Settings.MinSpawnRateScale = EffectMinSpawnRateScale;
+	Settings.SpawnRateParameterName = EffectSpawnRateParameter;
+	Settings.ReducedTickPixelRadius = EffectReducedTickPixelRadius;
+	Settings.ReducedTickInterval = 1.0f / FMath::Max(EffectReducedTickRate, 1.0f);
+	Settings.CaptureHidePixelRadius = EffectCaptureHidePixelRadius;
+
+	Effects.Update(EffectViews, Settings);
+
+	INC_PORTAL_COUNTER(PortalEffectsTracked, Effects.NumTrackedEffects());
+	INC_PORTAL_COUNTER(PortalEffectsCulled, Effects.NumCulledEffects());
+	INC_PORTAL_COUNTER(PortalEffectsHiddenFromCaptures, Effects.GetCaptureHiddenEffects().Num());
+}
+
+void UPortalSubsystem::StartTrackingAllEffects()
+{
+	UWorld* World = GetWorld();
+
+	if (ActorSpawnedHandle.IsValid() || World == nullptr)
+	{
+		return;
+	}
+
+	for (TActorIterator<AActor> ActorItr(World); ActorItr; ++ActorItr)
+	{
+		TrackActorEffects(*ActorItr);
+	}
+
+	ActorSpawnedHandle = World->AddOnActorSpawnedHandler(
+		FOnActorSpawned::FDelegate::CreateUObject(this, &UPortalSubsystem::OnActorSpawned));
+
+	// Streamed levels don't spawn their actors
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UPortalSubsystem::OnLevelAddedToWorld);
+}
+
+void UPortalSubsystem::StopTrackingAllEffects()
+{
+	UWorld* World = GetWorld();
+
+	if (ActorSpawnedHandle.IsValid() && World != nullptr)
+	{
+		World->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	}
+
+	ActorSpawnedHandle.Reset();
+
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	LevelAddedHandle.Reset();
+}
+
+void UPortalSubsystem::TrackActorEffects(AActor* Actor)
+{
+	if (Actor == nullptr)
+	{
+		return;
+	}
+
+	TInlineComponentArray<UNiagaraComponent*> NiagaraComponents(Actor);
+
+	for (UNiagaraComponent* NiagaraComponent : NiagaraComponents)
+	{
+		Effects.TrackEffect(NiagaraComponent);
+	}
+}
+
+void UPortalSubsystem::OnActorSpawned(AActor* Actor)
+{
+	TrackActorEffects(Actor);
+}
+
+void UPortalSubsystem::OnLevelAddedToWorld(ULevel* Level, UWorld* World)
+{
+	if (World != GetWorld() || Level == nullptr)
+	{
+		return;
+	}
+
+	for (AActor* Actor : Level->Actors)
+	{
+		TrackActorEffects(Actor);
+	}
+}
+
+void UPortalSubsystem::StartTrackingMovableActors()
+{
+	UWorld* World = GetWorld();
+
+	if (MovableActorSpawnedHandle.IsValid() || World == nullptr)
+	{
+		return;
+	}
+
+	// One walk for every portal
+	for (TActorIterator<AActor> ActorItr(World); ActorItr; ++ActorItr)
+	{
+		if (ActorItr->IsRootComponentMovable())
+		{
+			MovableActors.Add(*ActorItr);
+		}
+	}
+
+	MovableActorSpawnedHandle = World->AddOnActorSpawnedHandler(
+		FOnActorSpawned::FDelegate::CreateUObject(this, &UPortalSubsystem::OnMovableActorSpawned));
+}
+
+void UPortalSubsystem::StopTrackingMovableActors()
+{
+	UWorld* World = GetWorld();
+
+	if (MovableActorSpawnedHandle.IsValid() && World != nullptr)
+	{
+		World->RemoveOnActorSpawnedHandler(MovableActorSpawnedHandle);
+	}
+
+	MovableActorSpawnedHandle.Reset();
+	MovableActors.Empty();
+}
+
+void UPortalSubsystem::OnMovableActorSpawned(AActor* Actor)
+{
+	if (Actor == nullptr)
+	{
+		return;
+	}
+
+	if (Actor->IsRootComponentMovable())
+	{
+		MovableActors.Add(Actor);
+	}
+
+	for (APortal_Actor* Portal : VisibilitySetPortals)
+	{
+		Portal->UpdateTargetVisibility(Actor);
+	}
+}
@@ -0,0 +1,310 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineBaseTypes.h"
+#include "WorldSubsystemTickFunction.h"
+#include "PortalRegistry.h"
+#include "PortalCrossing.h"
+#include "PortalStats.h"
+#include "PortalBenchmark.h"
+#include "PortalStreaming.h"
+#include "PortalAudio.h"
+#include "PortalEffects.h"
+#include "PortalProxies.h"
+#include "PortalSubsystem.generated.h"
+
+//Forward declaration
+class APortal_Actor;
+class APortalManager;
+class UPortalSubsystem;
+class UTexture;
+class UAudioComponent;
+class USoundBase;
+class UNiagaraComponent;
+class ULevel;
+
+// Capture displayed by a player this frame
+struct FPortalSharedCapture
+{
+    const APortal_Actor* Portal = nullptr;
+    const APortalManager* Manager = nullptr;
+    UTexture* Texture = nullptr;
+
+    // View the texture was rendered with (projection before cropping)
+    FVector CaptureLocation = FVector::ZeroVector;
+    FRotator CaptureRotation = FRotator::ZeroRotator;
+    FMatrix ProjectionMatrix = FMatrix::Identity;
+
+    FLinearColor UVRect = FLinearColor(0.0f, 0.0f, 1.0f, 1.0f);
+};
+
+/**
+ * Owns the portals of a world and drives the portal managers of the
+ * local players. Runs in TG_PostUpdateWork, after the camera managers
+ * computed the final view of the frame, so that the captures use the
+ * same view as the player.
+ */
+UCLASS()
+class EL_API UPortalSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    UPortalSubsystem();
+
+    virtual void Deinitialize() override;
+
+    // Called by Portal actors on BeginPlay/EndPlay
+    void RegisterPortal(APortal_Actor* Portal);
+    void UnregisterPortal(APortal_Actor* Portal);
+
+    // Called by the PortalManager of each local player
+    void RegisterManager(APortalManager* Manager);
+    void UnregisterManager(APortalManager* Manager);
+
+    // More than one local player (remote players of a listen
+    // server have no manager and do not count)
+    bool IsSplitscreen() const;
+
+    //-----------------------------------
+    // Split-screen : the captures displayed this frame can be
+    // reused by the other players looking through the same
+    // portal from about the same place
+    //-----------------------------------
+    void PublishCapture(const FPortalSharedCapture& Capture);
+
+    const FPortalSharedCapture* FindSharedCapture(const APortal_Actor* Portal, const APortalManager* Manager, const FVector& CaptureLocation, const FRotator& CaptureRotation, const FMatrix& ProjectionMatrix) const;
+
+    // Teleport the actor when it goes through a portal
+    // (mirrored by a proxy while halfway through, see FPortalProxies)
+    UFUNCTION(BlueprintCallable, Category = "Portal")
+        void TrackCrossingActor(AActor* Actor);
+
+    UFUNCTION(BlueprintCallable, Category = "Portal")
+        void UntrackCrossingActor(AActor* Actor);
+
+    //-----------------------------------
+    // Audio heard through the portals (see FPortalAudio)
+    //-----------------------------------
+    UFUNCTION(BlueprintCallable, Category = "Portal|Audio")
+        void TrackPortalAudio(UAudioComponent* AudioComponent);
+
+    UFUNCTION(BlueprintCallable, Category = "Portal|Audio")
+        void UntrackPortalAudio(UAudioComponent* AudioComponent);
+
+    // One-shot heard in place and/or through a portal, false if no player can hear it
+    UFUNCTION(BlueprintCallable, Category = "Portal|Audio")
+        bool PlayPortalSoundAtLocation(USoundBase* Sound, FVector Location, float VolumeMultiplier = 1.0f);
+
+    //-----------------------------------
+    // Significance of the Niagara effects in the player
+    // views and the portal captures (see FPortalEffects)
+    //-----------------------------------
+    UFUNCTION(BlueprintCallable, Category = "Portal|Effects")
+        void TrackEffect(UNiagaraComponent* Effect);
+
+    UFUNCTION(BlueprintCallable, Category = "Portal|Effects")
+        void UntrackEffect(UNiagaraComponent* Effect);
+
+    // Translucent effects skipped by the captures this frame
+    const TArray<TWeakObjectPtr<UPrimitiveComponent>>& GetCaptureHiddenEffects() const;
+
+    // Movable actors of the world, shared by the target visibility sets
+    // of the portals (they remove the destroyed actors they find)
+    TArray<TWeakObjectPtr<AActor>>& GetMovableActors();
+
+    const FPortalRegistry& GetRegistry() const;
+
+    FPortalCrossingTracker& GetCrossingTracker();
+
+    FPortalGpuTimer& GetGpuTimer();
+
+    // Fly the pawn of the first player through every portal (see FPortalBenchmark)
+    UFUNCTION(BlueprintCallable, Category = "Portal")
+        bool StartBenchmark(bool bExitWhenDone);
+
+    const FPortalBenchmark& GetBenchmark() const;
+
+    // Manual Tick, called by the tick function
+    void Tick(float DeltaTime);
+
+    // Tracked actors are tested against the portals within this radius
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Crossing")
+        float CrossingQueryRadius;
+
+    // Mirror the tracked physics objects straddling a portal on its target side
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Crossing")
+        bool bPhysicsProxies;
+
+    // Proxies spawned once, as many objects can be halfway through at a time
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Crossing")
+        int32 ProxyPoolSize;
+
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Splitscreen")
+        bool bShareSplitscreenCaptures;
+
+    // Largest distance between two capture locations sharing a texture
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Splitscreen")
+        float SharedCaptureDistance;
+
+    // Largest difference between two capture rotations sharing a texture, in degrees
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Splitscreen")
+        float SharedCaptureAngle;
+
+    //-----------------------------------
+    // Target side streaming (see FPortalStreamer)
+    //-----------------------------------
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Streaming")
+        bool bStreamPortalTargets;
+
+    // Stream in when a player is (or will be) this close to a portal
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Streaming")
+        float StreamingRequestDistance;
+
+    // Release when every player is further away than this
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Streaming")
+        float StreamingReleaseDistance;
+
+    // Seconds of the player velocity looked ahead
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Streaming")
+        float StreamingLookAheadTime;
+
+    // Seconds out of range before releasing
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Streaming")
+        float StreamingReleaseDelay;
+
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Audio")
+        bool bPortalAudio;
+
+    // Portals further than this from the players carry no sound
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Audio")
+        float PortalAudioDistance;
+
+    // Gain when a player hears the portal from the side (1 when facing it)
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Audio")
+        float PortalAudioMinAngleGain;
+
+    // Stop the tracked loops no player can hear, directly or through a portal
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Audio")
+        bool bCullInaudibleSounds;
+
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        bool bEffectSignificance;
+
+    // Track the Niagara components of every actor (otherwise only TrackEffect)
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        bool bTrackAllEffects;
+
+    // Radius on screen (pixels) under which an effect is paused and hidden
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        float EffectCullPixelRadius;
+
+    // Radius on screen from which an effect spawns at its full rate
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        float EffectFullRatePixelRadius;
+
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        float EffectMinSpawnRateScale;
+
+    // User parameter of the systems multiplying their spawn rates
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        FName EffectSpawnRateParameter;
+
+    // Radius on screen under which an effect simulates at EffectReducedTickRate
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        float EffectReducedTickPixelRadius;
+
+    // Simulations per second of the small effects
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        float EffectReducedTickRate;
+
+    // Translucent effects smaller than this in every capture are left out of the captures
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Effects")
+        float EffectCaptureHidePixelRadius;
+
+private:
+    // Teleport the tracked actors that went through a portal since last frame
+    void UpdateCrossings();
+
+    // Place the proxies of the actors halfway through a portal
+    void UpdateProxies();
+
+    // Stream the target side of the portals the players get close to
+    void UpdateStreaming();
+
+    // Place the sounds heard through the portals
+    void UpdateAudio();
+
+    // View of each player, the audio listener follows the camera
+    void GatherAudioListeners();
+
+    FPortalAudioSettings GetAudioSettings() const;
+
+    // Score the effects against the views of this frame
+    void UpdateEffects();
+
+    // bTrackAllEffects : the effects already there, then the new ones
+    void StartTrackingAllEffects();
+    void StopTrackingAllEffects();
+    void TrackActorEffects(AActor* Actor);
+    void OnActorSpawned(AActor* Actor);
+    void OnLevelAddedToWorld(ULevel* Level, UWorld* World);
+
+    // Portals with a target visibility set : gather the movable actors
+    // once and tell every portal about the spawned ones
+    void StartTrackingMovableActors();
+    void StopTrackingMovableActors();
+    void OnMovableActorSpawned(AActor* Actor);
+
+    // After the camera managers (updated between
+    // TG_PostPhysics and TG_PostUpdateWork)
+    TWorldSubsystemTickFunction<UPortalSubsystem, TG_PostUpdateWork> TickFunction;
+
+    FPortalRegistry PortalRegistry;
+
+    FPortalCrossingTracker CrossingTracker;
+
+    TArray<FPortalCrossing> Crossings;
+
+    FPortalProxies Proxies;
+
+    // Captures published this frame
+    TArray<FPortalSharedCapture> SharedCaptures;
+
+    FPortalGpuTimer GpuTimer;
+
+    FPortalBenchmark Benchmark;
+
+    FPortalStreamer Streamer;
+
+    TArray<FPortalStreamingViewer> StreamingViewers;
+
+    FPortalAudio PortalAudio;
+
+    TArray<FPortalAudioListener> AudioListeners;
+
+    FPortalEffects Effects;
+
+    TArray<FPortalEffectView> EffectViews;
+
+    FDelegateHandle ActorSpawnedHandle;
+    FDelegateHandle LevelAddedHandle;
+
+    TArray<TWeakObjectPtr<AActor>> MovableActors;
+
+    TArray<APortal_Actor*> VisibilitySetPortals;
+
+    FDelegateHandle MovableActorSpawnedHandle;
+
+    // -PortalBenchmark on the command line, start once a player has a pawn
+    bool bBenchmarkRequested;
+
+    // Time spent in Tick() last frame
+    double LastTickTimeMs;
+
+    UPROPERTY()
+        TArray<APortalManager*> Managers;
+};
@@ -6,12 +6,39 @@
 #include "Player_Character.h"
 #include "Kismet/GameplayStatics.h"
 #include "Player_Controller.h"
+#include "EngineUtils.h"
+#include "PortalSubsystem.h"
+#include "PortalStats.h"
+#include "PortalMath.h"
+#include "PortalCharacterMovement.h"
+#include "Components/StaticMeshComponent.h"
+#include "Materials/MaterialInstanceDynamic.h"
 
 APortal_Actor::APortal_Actor(const FObjectInitializer& ObjectInitializer)
     : Super(ObjectInitializer)
 {
     PrimaryActorTick.bCanEverTick = true;
     bIsActive = false;
+    bCaptureUpdateRequested = false;
+    CaptureImportance = 1.0f;
+
+    DisplayComponent = nullptr;
+    TextureParameterName = TEXT("PortalTexture");
+    LeftUVRectParameterName = TEXT("RTT_UVRect_Left");
+    RightUVRectParameterName = TEXT("RTT_UVRect_Right");
+
+    bUseTargetVisibilitySet = false;
+    TargetVisibilityExtent = FVector(2048.0f, 2048.0f, 1024.0f);
+    NextTrackedActor = 0;
+    LastVisibilityUpdateFrame = 0;
+    TargetVisibilityVersion = 0;
+
+    LinkMatrix = FMatrix::Identity;
+    ViewLinkMatrix = FMatrix::Identity;
+    LinkRotation = FQuat::Identity;
+    ViewLinkRotation = FQuat::Identity;
+    LocalOpeningBounds = FBox(ForceInit);
+    bLinkDirty = true;
 
     RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootComponent"));
     RootComponent->Mobility = EComponentMobility::Static;
@@ -27,7 +54,41 @@ APortal_Actor::APortal_Actor(const FObjectInitializer& ObjectInitializer)
 void APortal_Actor::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	//Register to the subsystem so the managers do not have to search for us
+	//(it also shares the movable actors with the visibility sets)
+	UPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPortalSubsystem>();
+
+	if (PortalSubsystem != nullptr)
+	{
+		PortalSubsystem->RegisterPortal(this);
+	}
+
+	BindLinkInvalidation();
+}
+
+void APortal_Actor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    UPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPortalSubsystem>();
+
+    if (PortalSubsystem != nullptr)
+    {
+        PortalSubsystem->UnregisterPortal(this);
+    }
+
+    UnbindLinkInvalidation();
+
+    for (FPortalPlayerDisplay& Display : PlayerDisplays)
+    {
+        if (Display.Component != nullptr)
+        {
+            Display.Component->DestroyComponent();
+        }
+    }
+
+    PlayerDisplays.Empty();
+
+    Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -39,7 +100,10 @@ void APortal_Actor::Tick(float DeltaTime)
 
 bool APortal_Actor::IsActive()
 {
-    return bIsActive;
+    return bIsActive || PlayerDisplays.ContainsByPredicate([](const FPortalPlayerDisplay& Display)
+    {
+        return Display.bActive;
+    });
 }
 
 void APortal_Actor::SetActive(bool NewActive)
@@ -57,6 +121,146 @@ void APortal_Actor::SetRTT_Implementation(UTexture* RenderTexture)
 
 }
 
+void APortal_Actor::SetRTTUVRect_Implementation(FLinearColor UVRect)
+{
+
+}
+
+void APortal_Actor::SetRTTStereoUVRects_Implementation(FLinearColor LeftUVRect, FLinearColor RightUVRect)
+{
+    SetRTTUVRect(LeftUVRect);
+}
+
+void APortal_Actor::SetPlayerActive(int32 PlayerIndex, bool bNewActive)
+{
+    if (PlayerIndex <= 0)
+    {
+        SetActive(bNewActive);
+        return;
+    }
+
+    if (PlayerDisplays.IsValidIndex(PlayerIndex))
+    {
+        PlayerDisplays[PlayerIndex].bActive = bNewActive;
+    }
+    else if (bNewActive)
+    {
+        FPortalPlayerDisplay* Display = GetPlayerDisplay(PlayerIndex);
+
+        if (Display != nullptr)
+        {
+            Display->bActive = true;
+        }
+    }
+}
+
+void APortal_Actor::SetPlayerRTT(int32 PlayerIndex, UTexture* RenderTexture)
+{
+    if (PlayerIndex <= 0)
+    {
+        SetRTT(RenderTexture);
+        return;
+    }
+
+    FPortalPlayerDisplay* Display = GetPlayerDisplay(PlayerIndex);
+
+    if (Display != nullptr && Display->Material != nullptr)
+    {
+        Display->Material->SetTextureParameterValue(TextureParameterName, RenderTexture);
+    }
+}
+
+void APortal_Actor::ClearPlayerRTT(int32 PlayerIndex)
+{
+    if (PlayerIndex <= 0)
+    {
+        ClearRTT();
+        return;
+    }
+
+    if (PlayerDisplays.IsValidIndex(PlayerIndex) && PlayerDisplays[PlayerIndex].Material != nullptr)
+    {
+        PlayerDisplays[PlayerIndex].Material->SetTextureParameterValue(TextureParameterName, nullptr);
+    }
+}
+
+void APortal_Actor::SetPlayerUVRects(int32 PlayerIndex, const FLinearColor& LeftUVRect, const FLinearColor& RightUVRect)
+{
+    if (PlayerIndex <= 0)
+    {
+        SetRTTStereoUVRects(LeftUVRect, RightUVRect);
+        return;
+    }
+
+    FPortalPlayerDisplay* Display = GetPlayerDisplay(PlayerIndex);
+
+    if (Display != nullptr && Display->Material != nullptr)
+    {
+        Display->Material->SetVectorParameterValue(LeftUVRectParameterName, LeftUVRect);
+        Display->Material->SetVectorParameterValue(RightUVRectParameterName, RightUVRect);
+    }
+}
+
+void APortal_Actor::GetHiddenDisplays(int32 PlayerIndex, TArray<UPrimitiveComponent*>& OutComponents) const
+{
+    for (int32 Index = 1; Index < PlayerDisplays.Num(); Index++)
+    {
+        if (Index != PlayerIndex && PlayerDisplays[Index].Component != nullptr)
+        {
+            OutComponents.Add(PlayerDisplays[Index].Component);
+        }
+    }
+
+    //The other players see the first display only until they have their own
+    bool bHasOwnDisplay = PlayerDisplays.IsValidIndex(PlayerIndex) && PlayerDisplays[PlayerIndex].Component != nullptr;
+
+    if (PlayerIndex > 0 && bHasOwnDisplay)
+    {
+        UPrimitiveComponent* SourceDisplay = DisplayComponent != nullptr ? DisplayComponent : FindComponentByClass<UStaticMeshComponent>();
+
+        if (SourceDisplay != nullptr)
+        {
+            OutComponents.Add(SourceDisplay);
+        }
+    }
+}
+
+FPortalPlayerDisplay* APortal_Actor::GetPlayerDisplay(int32 PlayerIndex)
+{
+    UPrimitiveComponent* SourceDisplay = DisplayComponent != nullptr ? DisplayComponent : FindComponentByClass<UStaticMeshComponent>();
+
+    if (PlayerIndex <= 0 || SourceDisplay == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (!PlayerDisplays.IsValidIndex(PlayerIndex))
+    {
+        PlayerDisplays.SetNum(PlayerIndex + 1);
+    }
+
+    FPortalPlayerDisplay& Display = PlayerDisplays[PlayerIndex];
+
+    if (Display.Component == nullptr)
+    {
+        //Same mesh, materials and placement as the display of the first player
+        Display.Component = NewObject<UPrimitiveComponent>(this,
+            SourceDisplay->GetClass(),
+            MakeUniqueObjectName(this, SourceDisplay->GetClass(), TEXT("PortalPlayerDisplay")),
+            RF_Transient,
+            SourceDisplay);
+
+        Display.Component->CreationMethod = EComponentCreationMethod::Instance;
+        Display.Component->SetupAttachment(SourceDisplay->GetAttachParent(), SourceDisplay->GetAttachSocketName());
+        Display.Component->SetRelativeTransform(SourceDisplay->GetRelativeTransform());
+        Display.Component->RegisterComponent();
+
+        Display.Material = Display.Component->CreateAndSetMaterialInstanceDynamic(0);
+    }
+
+    return &Display;
+}
+
 void APortal_Actor::ForceTick_Implementation()
 {
 
@@ -70,38 +274,27 @@ AActor* APortal_Actor::GetTarget()
 void APortal_Actor::SetTarget(AActor* NewTarget)
 {
     Target = NewTarget;
+    bLinkDirty = true;
+
+    if (HasActorBegunPlay())
+    {
+        UnbindLinkInvalidation();
+        BindLinkInvalidation();
+    }
 }
 
 bool APortal_Actor::IsPointInFrontOfPortal(FVector Point, FVector PortalLocation, FVector PortalNormal)
 {
-    FPlane PortalPlane = FPlane(PortalLocation, PortalNormal);
-    float PortalDot = PortalPlane.PlaneDot(Point);
-
-    //If < 0 means we are behind the Plane
-    //See : http://api.unrealengine.com/INT/API/Runtime/Core/Math/FPlane/PlaneDot/index.html
-    return (PortalDot >= 0);
+    return FPortalMath::IsPointInFrontOfPlane(Point, PortalLocation, PortalNormal);
 }
 
 bool APortal_Actor::IsPointCrossingPortal(FVector Point, FVector PortalLocation, FVector PortalNormal)
 {
-    FVector IntersectionPoint;
-    FPlane PortalPlane = FPlane(PortalLocation, PortalNormal);
-    float PortalDot = PortalPlane.PlaneDot(Point);
-    bool IsCrossing = false;
-    bool IsInFront = PortalDot >= 0;
-
-    bool IsIntersect = FMath::SegmentPlaneIntersection(LastPosition,
-        Point,
-        PortalPlane,
-        IntersectionPoint);
+    bool IsInFront = FPortalMath::IsPointInFrontOfPlane(Point, PortalLocation, PortalNormal);
 
     // Did we intersect the portal since last Location ?
-    // If yes, check the direction : crossing forward means we were in front and now at the back
-    // If we crossed backward, ignore it (similar to Prey 2006)
-    if (IsIntersect && !IsInFront && LastInFront)
-    {
-        IsCrossing = true;
-    }
+    // Only crossing forward counts, from the front to the back
+    bool IsCrossing = LastInFront && FPortalMath::IsSegmentCrossingPlane(LastPosition, Point, PortalLocation, PortalNormal);
 
     // Store values for next check
     LastInFront = IsInFront;
@@ -112,12 +305,28 @@ bool APortal_Actor::IsPointCrossingPortal(FVector Point, FVector PortalLocation,
 
 void APortal_Actor::TeleportActor(AActor* ActorToTeleport)
 {
+    SCOPE_PORTAL_STAT(Teleport);
+
     {
         if (ActorToTeleport == nullptr || Target == nullptr)
         {
             return;
         }
 
+        //-------------------------------
+        //In a networked game the movement of the
+        //character predicts the teleport (or leaves
+        //it to the client that owns the character)
+        //-------------------------------
+        ACharacter* Character = Cast<ACharacter>(ActorToTeleport);
+        UPortalCharacterMovementComponent* PortalMovement = Character != nullptr ? Cast<UPortalCharacterMovementComponent>(Character->GetCharacterMovement()) : nullptr;
+
+        if (PortalMovement != nullptr && PortalMovement->TeleportThroughPortal(this))
+        {
+            LastPosition = ActorToTeleport->GetActorLocation();
+            return;
+        }
+
         //-------------------------------
         //Retrieve and save Player Velocity
         //(from the Movement Component)
@@ -137,7 +346,7 @@ void APortal_Actor::TeleportActor(AActor* ActorToTeleport)
         //Compute and apply new location
         //-------------------------------
         FHitResult HitResult;
-        FVector NewLocation = ConvertLocationToActorSpace(ActorToTeleport->GetActorLocation(), this);
+        FVector NewLocation = TransformLocationToTarget(ActorToTeleport->GetActorLocation());
 
         ActorToTeleport->SetActorLocation(NewLocation,
             false,
@@ -147,7 +356,7 @@ void APortal_Actor::TeleportActor(AActor* ActorToTeleport)
         //-------------------------------
         //Compute and apply new rotation
         //-------------------------------
-        FRotator NewRotation = ConvertRotationToActorSpace(ActorToTeleport->GetActorRotation(), this);
+        FRotator NewRotation = TransformRotationToTarget(ActorToTeleport->GetActorQuat()).Rotator();
         
 
         //-------------------------------
@@ -156,28 +365,34 @@ void APortal_Actor::TeleportActor(AActor* ActorToTeleport)
         //-------------------------------
         if (ActorToTeleport->IsA(APlayer_Character::StaticClass()))
         {
-            //Update Controller
-            APlayer_Controller* EPC = Cast<APlayer_Controller>(UGameplayStatics::GetPlayerController(GetWorld(), 0));
+            //Update Controller (the one of this character, not the first player)
+            APlayer_Controller* EPC = Cast<APlayer_Controller>(EC->GetController());
 
             if (EPC != nullptr)
             {
-                NewRotation = ConvertRotationToActorSpace(EPC->GetControlRotation(), this);
-                NewRotation.Yaw += 180.f;
+                NewRotation = GetTeleportedControlRotation(EPC->GetControlRotation());
                 EPC->SetControlRotation(NewRotation);
             }
 
             //Reapply Velocity (Need to reorient direction into local space of Portal)
+            if (EC->GetCharacterMovement() != nullptr)
             {
-                FVector Dots;
-                Dots.X = FVector::DotProduct(SavedVelocity, GetActorForwardVector());
-                Dots.Y = FVector::DotProduct(SavedVelocity, GetActorRightVector());
-                Dots.Z = FVector::DotProduct(SavedVelocity, GetActorUpVector());
+                EC->GetCharacterMovement()->Velocity = TransformDirectionToTarget(SavedVelocity);
+            }
+        }
+        else
+        {
+            ActorToTeleport->SetActorRotation(NewRotation, ETeleportType::TeleportPhysics);
 
-                FVector NewVelocity = Dots.X * Target->GetActorForwardVector()
-                    + Dots.Y * Target->GetActorRightVector()
-                    + Dots.Z * Target->GetActorUpVector();
+            //-------------------------------
+            //Physics objects keep their momentum
+            //through the portal as well
+            //-------------------------------
+            UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(ActorToTeleport->GetRootComponent());
 
-                EC->GetVelocity() = NewVelocity;
+            if (Primitive != nullptr && Primitive->IsSimulatingPhysics())
+            {
+                Primitive->SetPhysicsLinearVelocity(TransformDirectionToTarget(Primitive->GetPhysicsLinearVelocity()));
             }
         }
 
@@ -187,6 +402,29 @@ void APortal_Actor::TeleportActor(AActor* ActorToTeleport)
 }
 
 
+FRotator APortal_Actor::GetTeleportedControlRotation(const FRotator& ControlRotation)
+{
+    //Same half turn as the view and the velocity
+    return TransformRotationToTarget(ControlRotation.Quaternion()).Rotator();
+}
+
+FVector APortal_Actor::TransformLocationToTarget(const FVector& Location)
+{
+    return GetViewLinkMatrix().TransformPosition(Location);
+}
+
+FVector APortal_Actor::TransformDirectionToTarget(const FVector& Direction)
+{
+    return GetViewLinkMatrix().TransformVector(Direction);
+}
+
+FQuat APortal_Actor::TransformRotationToTarget(const FQuat& Rotation)
+{
+    UpdateLinkCache();
+
+    return ViewLinkRotation * Rotation;
+}
+
 FVector APortal_Actor::ConvertLocationToActorSpace(FVector Location, AActor * Reference)
     {
         if (Reference == nullptr || Target == nullptr)
@@ -194,19 +432,16 @@ FVector APortal_Actor::ConvertLocationToActorSpace(FVector Location, AActor * Re
             return FVector::ZeroVector;
         }
 
-        FVector Direction = Location - Reference->GetActorLocation();
-        FVector TargetLocation = Target->GetActorLocation();
-
-        FVector Dots;
-        Dots.X = FVector::DotProduct(Direction, Reference->GetActorForwardVector());
-        Dots.Y = FVector::DotProduct(Direction, Reference->GetActorRightVector());
-        Dots.Z = FVector::DotProduct(Direction, Reference->GetActorUpVector());
-
-        FVector NewDirection = Dots.X * Target->GetActorForwardVector()
-            + Dots.Y * Target->GetActorRightVector()
-            + Dots.Z * Target->GetActorUpVector();
+        if (Reference == this)
+        {
+            return GetLinkMatrix().TransformPosition(Location);
+        }
 
-        return TargetLocation + NewDirection;
+        return FPortalMath::ConvertLocation(Location,
+            Reference->GetActorLocation(),
+            Reference->GetActorQuat(),
+            Target->GetActorLocation(),
+            Target->GetActorQuat());
     }
 
 FRotator APortal_Actor::ConvertRotationToActorSpace(FRotator Rotation, AActor* Reference)
@@ -217,41 +452,289 @@ FRotator APortal_Actor::ConvertRotationToActorSpace(FRotator Rotation, AActor* R
         return FRotator::ZeroRotator;
     }
 
-    FTransform SourceTransform = Reference->GetActorTransform();
-    FTransform TargetTransform = Target->GetActorTransform();
-    FQuat QuatRotation = FQuat(Rotation);
+    if (Reference == this)
+    {
+        return (GetLinkRotation() * FQuat(Rotation)).Rotator();
+    }
+
+    return FPortalMath::ConvertRotation(FQuat(Rotation), Reference->GetActorQuat(), Target->GetActorQuat()).Rotator();
+}
 
-    FQuat LocalQuat = SourceTransform.GetRotation().Inverse() * QuatRotation;
-    FQuat NewWorldQuat = TargetTransform.GetRotation() * LocalQuat;
+const FMatrix& APortal_Actor::GetLinkMatrix()
+{
+    UpdateLinkCache();
 
-    return NewWorldQuat.Rotator();
+    return LinkMatrix;
+}
+
+const FMatrix& APortal_Actor::GetViewLinkMatrix()
+{
+    UpdateLinkCache();
+
+    return ViewLinkMatrix;
+}
+
+const FQuat& APortal_Actor::GetLinkRotation()
+{
+    UpdateLinkCache();
+
+    return LinkRotation;
+}
+
+const FBox& APortal_Actor::GetLocalOpeningBounds()
+{
+    UpdateLinkCache();
+
+    return LocalOpeningBounds;
+}
+
+void APortal_Actor::UpdateLinkCache()
+{
+    //Before BeginPlay nothing tells us when the ends move
+    if (!bLinkDirty && LinkSourceHandle.IsValid())
+    {
+        return;
+    }
+
+    bLinkDirty = false;
+
+    LocalOpeningBounds = CalculateComponentsBoundingBoxInLocalSpace(true);
+
+    if (Target == nullptr)
+    {
+        LinkMatrix = FMatrix::Identity;
+        ViewLinkMatrix = FMatrix::Identity;
+        LinkRotation = FQuat::Identity;
+        ViewLinkRotation = FQuat::Identity;
+        return;
+    }
+
+    //-------------------------------
+    //Same as going through the axes of the portal
+    //then the ones of the target (scale is ignored)
+    //-------------------------------
+    FQuat SourceRotation = GetActorQuat();
+    FQuat TargetRotation = Target->GetActorQuat();
+
+    LinkRotation = TargetRotation * SourceRotation.Inverse();
+    ViewLinkRotation = TargetRotation * FQuat(FVector::UpVector, PI) * SourceRotation.Inverse();
+    LinkMatrix = FPortalMath::MakeLinkMatrix(GetActorLocation(), SourceRotation, Target->GetActorLocation(), TargetRotation, false);
+    ViewLinkMatrix = FPortalMath::MakeLinkMatrix(GetActorLocation(), SourceRotation, Target->GetActorLocation(), TargetRotation, true);
+}
+
+void APortal_Actor::BindLinkInvalidation()
+{
+    bLinkDirty = true;
+
+    if (RootComponent != nullptr)
+    {
+        LinkSourceComponent = RootComponent;
+        LinkSourceHandle = RootComponent->TransformUpdated.AddUObject(this, &APortal_Actor::OnLinkEndMoved);
+    }
+
+    if (Target != nullptr && Target->GetRootComponent() != nullptr)
+    {
+        LinkTargetComponent = Target->GetRootComponent();
+        LinkTargetHandle = LinkTargetComponent->TransformUpdated.AddUObject(this, &APortal_Actor::OnLinkEndMoved);
+    }
+}
+
+void APortal_Actor::UnbindLinkInvalidation()
+{
+    if (LinkSourceComponent.IsValid())
+    {
+        LinkSourceComponent->TransformUpdated.Remove(LinkSourceHandle);
+    }
+
+    if (LinkTargetComponent.IsValid())
+    {
+        LinkTargetComponent->TransformUpdated.Remove(LinkTargetHandle);
+    }
+
+    LinkSourceComponent.Reset();
+    LinkTargetComponent.Reset();
+    LinkSourceHandle.Reset();
+    LinkTargetHandle.Reset();
+    bLinkDirty = true;
+}
+
+void APortal_Actor::OnLinkEndMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+    bLinkDirty = true;
 }
 
 bool APortal_Actor::IsPointInsideBox(FVector Point, UBoxComponent* Box)
 {
     if (Box != nullptr)
     {
-        // From :
-        // https://stackoverflow.com/questions/52673935/check-if-3d-point-inside-a-box/52674010
+        return FPortalMath::IsPointInsideBox(Point,
+            Box->GetComponentLocation(),
+            Box->GetScaledBoxExtent(),
+            Box->GetForwardVector(),
+            Box->GetRightVector(),
+            Box->GetUpVector());
+    }
+    else
+    {
+        return false;
+    }
+}
 
-        FVector Center = Box->GetComponentLocation();
-        FVector Half = Box->GetScaledBoxExtent();
-        FVector DirectionX = Box->GetForwardVector();
-        FVector DirectionY = Box->GetRightVector();
-        FVector DirectionZ = Box->GetUpVector();
+void APortal_Actor::RequestCaptureUpdate()
+{
+    bCaptureUpdateRequested = true;
+}
 
-        FVector Direction = Point - Center;
+bool APortal_Actor::ConsumeCaptureUpdateRequest()
+{
+    bool bWasRequested = bCaptureUpdateRequested;
+    bCaptureUpdateRequested = false;
 
-        bool IsInside = FMath::Abs(FVector::DotProduct(Direction, DirectionX)) <= Half.X &&
-            FMath::Abs(FVector::DotProduct(Direction, DirectionY)) <= Half.Y &&
-            FMath::Abs(FVector::DotProduct(Direction, DirectionZ)) <= Half.Z;
+    return bWasRequested;
+}
 
-        return IsInside;
+bool APortal_Actor::IsInTargetVisibilityBounds(AActor* Actor) const
+{
+    if (Actor == nullptr || Target == nullptr || Actor == this)
+    {
+        return false;
     }
-    else
+
+    //-------------------------------
+    //Box in front of the target, in target space
+    //-------------------------------
+    FVector Origin;
+    FVector Extent;
+    Actor->GetActorBounds(true, Origin, Extent);
+
+    if (Extent.IsNearlyZero())
     {
         return false;
     }
+
+    FBox VisibilityBox = FBox(FVector(0.0f, -TargetVisibilityExtent.Y, -TargetVisibilityExtent.Z),
+        FVector(TargetVisibilityExtent.X * 2.0f, TargetVisibilityExtent.Y, TargetVisibilityExtent.Z));
+
+    FBox ActorBox = FBox(Origin - Extent, Origin + Extent).InverseTransformBy(Target->GetActorTransform());
+
+    return VisibilityBox.Intersect(ActorBox);
+}
+
+void APortal_Actor::BakeTargetVisibilitySet()
+{
+    if (GetWorld() == nullptr || Target == nullptr)
+    {
+        return;
+    }
+
+    Modify();
+    TargetVisibleActors.Reset();
+
+    for (TActorIterator<AActor> ActorItr(GetWorld()); ActorItr; ++ActorItr)
+    {
+        if (IsInTargetVisibilityBounds(*ActorItr))
+        {
+            TargetVisibleActors.Add(*ActorItr);
+        }
+    }
+}
+
+void APortal_Actor::UpdateTargetVisibilitySet(int32 MaxActorsToCheck)
+{
+    //Once per frame, whatever the number of players looking at it
+    if (!bUseTargetVisibilitySet || LastVisibilityUpdateFrame == GFrameCounter)
+    {
+        return;
+    }
+
+    LastVisibilityUpdateFrame = GFrameCounter;
+
+    UPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPortalSubsystem>();
+
+    if (PortalSubsystem == nullptr)
+    {
+        return;
+    }
+
+    //-------------------------------
+    //Round robin over the movable actors of the world
+    //(shared by every portal, gathered by the subsystem)
+    //-------------------------------
+    TArray<TWeakObjectPtr<AActor>>& MovableActors = PortalSubsystem->GetMovableActors();
+
+    for (int32 Count = 0; Count < MaxActorsToCheck && MovableActors.Num() > 0; Count++)
+    {
+        if (NextTrackedActor >= MovableActors.Num())
+        {
+            NextTrackedActor = 0;
+        }
+
+        AActor* Actor = MovableActors[NextTrackedActor].Get();
+
+        if (Actor == nullptr)
+        {
+            MovableActors.RemoveAtSwap(NextTrackedActor);
+            continue;
+        }
+
+        SetTargetVisible(Actor, IsInTargetVisibilityBounds(Actor));
+        NextTrackedActor++;
+    }
+
+    //Destroyed actors
+    int32 Removed = TargetVisibleActors.RemoveAll([](AActor* Actor)
+    {
+        return Actor == nullptr || Actor->IsPendingKill();
+    });
+
+    if (Removed > 0)
+    {
+        TargetVisibilityVersion++;
+    }
+}
+
+void APortal_Actor::UpdateTargetVisibility(AActor* Actor)
+{
+    if (bUseTargetVisibilitySet && Actor != nullptr)
+    {
+        SetTargetVisible(Actor, IsInTargetVisibilityBounds(Actor));
+    }
+}
+
+void APortal_Actor::SetTargetVisible(AActor* Actor, bool bVisible)
+{
+    bool bChanged = false;
+
+    if (bVisible)
+    {
+        if (!TargetVisibleActors.Contains(Actor))
+        {
+            TargetVisibleActors.Add(Actor);
+            bChanged = true;
+        }
+    }
+    else
+    {
+        bChanged = TargetVisibleActors.RemoveSingleSwap(Actor) > 0;
+    }
+
+    if (bChanged)
+    {
+        TargetVisibilityVersion++;
+
+        //The set changed : the current capture is not valid anymore
+        RequestCaptureUpdate();
+    }
+}
+
+int32 APortal_Actor::GetTargetVisibilityVersion() const
+{
+    return TargetVisibilityVersion;
+}
+
+bool APortal_Actor::HasTargetStreaming() const
+{
+    return TargetStreamingLevels.Num() > 0 || TargetAssets.Num() > 0 || TargetPrimaryAssets.Num() > 0;
 }
 
 APortalManager* APortal_Actor::GetPortalManager(AActor* Context)
@@ -261,8 +744,20 @@ APortalManager* APortal_Actor::GetPortalManager(AActor* Context)
     //Retrieve the World from the Context actor
     if (Context != nullptr && Context->GetWorld() != nullptr)
     {
-        //Find PlayerController
-        APlayer_Controller* EPC = Cast<APlayer_Controller>(Context->GetWorld()->GetFirstPlayerController());
+        //Find PlayerController : the one of the Context when it
+        //belongs to a player (split-screen), or the first one
+        APlayer_Controller* EPC = Cast<APlayer_Controller>(Context);
+        APawn* Pawn = Cast<APawn>(Context);
+
+        if (EPC == nullptr && Pawn != nullptr)
+        {
+            EPC = Cast<APlayer_Controller>(Pawn->GetController());
+        }
+
+        if (EPC == nullptr)
+        {
+            EPC = Cast<APlayer_Controller>(Context->GetWorld()->GetFirstPlayerController());
+        }
 
         //Retrieve the Portal Manager
         if (EPC != nullptr && EPC->GetPortalManager() != nullptr)
@@ -6,8 +6,27 @@
 #include "GameFramework/Actor.h"
 #include "PortalManager.h"
 #include "Components/BoxComponent.h"
+#include "UObject/PrimaryAssetId.h"
 #include "Portal_Actor.generated.h"
 
+//Forward declaration
+class UMaterialInstanceDynamic;
+
+//Display of the portal for a local player other than the first one (split-screen)
+USTRUCT()
+struct FPortalPlayerDisplay
+{
+    GENERATED_BODY()
+
+    UPROPERTY(transient)
+        UPrimitiveComponent* Component = nullptr;
+
+    UPROPERTY(transient)
+        UMaterialInstanceDynamic* Material = nullptr;
+
+    bool bActive = false;
+};
+
 UCLASS()
 class EL_API APortal_Actor : public AActor
 {
@@ -20,10 +39,12 @@ public:
 protected:
     virtual void BeginPlay() override;
 
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:
     virtual void Tick(float DeltaTime) override;
 
-    //Status of the Portal (being visualized by the player or not)
+    //Status of the Portal (being visualized by a player or not)
     UFUNCTION(BlueprintPure, Category = "APortal_Actor|Portal")
         bool IsActive();
 
@@ -37,6 +58,17 @@ public:
     UFUNCTION(BlueprintNativeEvent, BlueprintCallable, Category = "APortal_Actor|Portal")
         void SetRTT(UTexture* RenderTexture);
 
+    //Region of the screen stored in the render target (R,G = top-left UV, B,A = size)
+    //the material must sample at (ScreenUV - RG) / BA
+    UFUNCTION(BlueprintNativeEvent, BlueprintCallable, Category = "APortal_Actor|Portal")
+        void SetRTTUVRect(FLinearColor UVRect);
+
+    //Same for each eye in stereo (both eyes share one capture), the material
+    //picks the rect with ResolvedView.StereoPassIndex (0 = left eye or mono)
+    //Calls SetRTTUVRect with the left rect when not overridden
+    UFUNCTION(BlueprintNativeEvent, BlueprintCallable, Category = "APortal_Actor|Portal")
+        void SetRTTStereoUVRects(FLinearColor LeftUVRect, FLinearColor RightUVRect);
+
     UFUNCTION(BlueprintNativeEvent, Category = "APortal_Actor|Portal")
         void ForceTick();
 
@@ -59,14 +91,127 @@ public:
 
     FRotator ConvertRotationToActorSpace(FRotator Rotation, AActor* Reference);
 
+    //Control rotation of a character after TeleportActor()
+    FRotator GetTeleportedControlRotation(const FRotator& ControlRotation);
+
+    //Location/velocity/rotation of what goes through the portal, turned
+    //around the Target up axis like the view (see GetViewLinkMatrix) so
+    //that it comes out where and moving into what the portal showed
+    FVector TransformLocationToTarget(const FVector& Location);
+    FVector TransformDirectionToTarget(const FVector& Direction);
+    FQuat TransformRotationToTarget(const FQuat& Rotation);
+
     UFUNCTION(BlueprintCallable, Category = "APortal_Actor|Portal")
         bool IsPointInsideBox(FVector Point, UBoxComponent* Box);
 
     UFUNCTION(BlueprintCallable, Category = "APortal_Actor|Portal")
         APortalManager* GetPortalManager(AActor* Context);
 
+    //Ask for a new capture even if the manager thinks nothing changed
+    //(ex: a door opened on the target side)
+    UFUNCTION(BlueprintCallable, Category = "APortal_Actor|Portal")
+        void RequestCaptureUpdate();
+
+    //Returns true once after RequestCaptureUpdate()
+    bool ConsumeCaptureUpdateRequest();
+
+    //-----------------------------------
+    //Split-screen : each local player sees the portal with its own texture.
+    //Player 0 goes through the SetRTT/ClearRTT/SetRTTStereoUVRects events,
+    //the other players get a copy of DisplayComponent only they can see,
+    //with a dynamic material receiving the parameters below
+    //-----------------------------------
+    void SetPlayerActive(int32 PlayerIndex, bool bNewActive);
+    void SetPlayerRTT(int32 PlayerIndex, UTexture* RenderTexture);
+    void ClearPlayerRTT(int32 PlayerIndex);
+    void SetPlayerUVRects(int32 PlayerIndex, const FLinearColor& LeftUVRect, const FLinearColor& RightUVRect);
+
+    //Displays of the other players, to hide from the views of PlayerIndex
+    void GetHiddenDisplays(int32 PlayerIndex, TArray<UPrimitiveComponent*>& OutComponents) const;
+
+    //Mesh showing the render target (the first static mesh when not set)
+    UPROPERTY(BlueprintReadWrite, Category = "Portal|Splitscreen")
+        UPrimitiveComponent* DisplayComponent;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Splitscreen")
+        FName TextureParameterName;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Splitscreen")
+        FName LeftUVRectParameterName;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Splitscreen")
+        FName RightUVRectParameterName;
+
+    //Multiplies the priority of the portal when competing for a capture
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+        float CaptureImportance;
+
     FVector ConvertLocationToActorSpace(FVector Location, AActor* Reference);
 
+    //Portal to Target transform, cached until the portal or its Target moves
+    const FMatrix& GetLinkMatrix();
+
+    //Same but turned around the Target up axis : where a view
+    //looking through the portal ends up on the Target side
+    const FMatrix& GetViewLinkMatrix();
+
+    const FQuat& GetLinkRotation();
+
+    //Box of the portal components in portal space (the opening)
+    const FBox& GetLocalOpeningBounds();
+
+    //Target side visibility (what the capture behind this portal can see)
+    //Only the actors of the set are rendered when enabled
+    UPROPERTY(EditAnywhere, Category = "Portal|Visibility")
+        bool bUseTargetVisibilitySet;
+
+    //Half size of the box in front of the Target, in Target space, used to build the set
+    UPROPERTY(EditAnywhere, Category = "Portal|Visibility")
+        FVector TargetVisibilityExtent;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Visibility")
+        TArray<AActor*> TargetVisibleActors;
+
+    //Never rendered by the capture behind this portal
+    UPROPERTY(EditAnywhere, Category = "Portal|Visibility")
+        TArray<AActor*> TargetHiddenActors;
+
+    //Fill TargetVisibleActors with the actors found in the target side box
+    UFUNCTION(CallInEditor, Category = "Portal|Visibility")
+        void BakeTargetVisibilitySet();
+
+    bool IsInTargetVisibilityBounds(AActor* Actor) const;
+
+    //Check a few movable actors and add/remove them from the set
+    //(the first call of the frame only)
+    void UpdateTargetVisibilitySet(int32 MaxActorsToCheck);
+
+    //Add/remove one actor from the set (spawned actors)
+    void UpdateTargetVisibility(AActor* Actor);
+
+    //Incremented every time TargetVisibleActors changes at runtime
+    int32 GetTargetVisibilityVersion() const;
+
+    //-----------------------------------
+    //Target side content, streamed in by the PortalSubsystem
+    //when a player comes close to (or moves toward) the portal
+    //and released once every player left
+    //-----------------------------------
+    UPROPERTY(EditAnywhere, Category = "Portal|Streaming")
+        TArray<TSoftObjectPtr<UWorld>> TargetStreamingLevels;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Streaming")
+        TArray<FSoftObjectPath> TargetAssets;
+
+    //Primary assets preloaded with the bundles below
+    UPROPERTY(EditAnywhere, Category = "Portal|Streaming")
+        TArray<FPrimaryAssetId> TargetPrimaryAssets;
+
+    UPROPERTY(EditAnywhere, Category = "Portal|Streaming")
+        TArray<FName> TargetAssetBundles;
+
+    bool HasTargetStreaming() const;
+
 
 protected:
     UPROPERTY(BlueprintReadOnly)
@@ -75,6 +220,44 @@ protected:
 private:
     bool bIsActive;
 
+    //Created the first time a player other than the first one uses the portal
+    FPortalPlayerDisplay* GetPlayerDisplay(int32 PlayerIndex);
+
+    UPROPERTY()
+        TArray<FPortalPlayerDisplay> PlayerDisplays;
+
+    bool bCaptureUpdateRequested;
+
+    void SetTargetVisible(AActor* Actor, bool bVisible);
+
+    //Next of the movable actors of the subsystem to check
+    int32 NextTrackedActor;
+
+    uint64 LastVisibilityUpdateFrame;
+
+    int32 TargetVisibilityVersion;
+
+    void UpdateLinkCache();
+
+    void BindLinkInvalidation();
+    void UnbindLinkInvalidation();
+
+    void OnLinkEndMoved(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+    FMatrix LinkMatrix;
+    FMatrix ViewLinkMatrix;
+    FQuat LinkRotation;
+    FQuat ViewLinkRotation;
+    FBox LocalOpeningBounds;
+
+    bool bLinkDirty;
+
+    //Components whose TransformUpdated event invalidates the cache
+    TWeakObjectPtr<USceneComponent> LinkSourceComponent;
+    TWeakObjectPtr<USceneComponent> LinkTargetComponent;
+    FDelegateHandle LinkSourceHandle;
+    FDelegateHandle LinkTargetHandle;
+
     AActor* Target;
 
     //Used for Tracking movement of a point
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalSubsystem.h"
+#include "Misc/AutomationTest.h"
+#include "Tests/AutomationCommon.h"
+#include "Engine/World.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//-----------------------------------
+// The portal benchmark as an automation test, for the build agents :
+//   EL -game -nullrhi -unattended -ExecCmds="Automation RunTests EL.Portal.Benchmark; Quit"
+// Fails when the fly-through cannot start, times out
+// or exceeds the portal.Benchmark.* thresholds.
+//-----------------------------------
+
+// Longest fly-through accepted, pawn spawn included
+static const double PortalBenchmarkTestTimeout = 600.0;
+
+// Starts the benchmark once the first player has a pawn, then waits for it to finish
+class FPortalBenchmarkLatentCommand : public IAutomationLatentCommand
+{
+public:
+	FPortalBenchmarkLatentCommand(FAutomationTestBase* InTest)
+		: Test(InTest)
+		, bStarted(false)
+	{
+	}
+
+	virtual bool Update() override
+	{
+		UWorld* World = AutomationCommon::GetAnyGameWorld();
+		UPortalSubsystem* PortalSubsystem = World != nullptr ? World->GetSubsystem<UPortalSubsystem>() : nullptr;
+
+		if (GetCurrentRunTime() > PortalBenchmarkTestTimeout)
+		{
+			Test->AddError(bStarted ? TEXT("Portal benchmark timed out") : TEXT("Portal benchmark could not start (no pawn or no linked portal)"));
+			return true;
+		}
+
+		if (PortalSubsystem == nullptr)
+		{
+			return false;
+		}
+
+		if (!bStarted)
+		{
+			// The pawn may not be there yet, try again next frame
+			bStarted = PortalSubsystem->StartBenchmark(false);
+			return false;
+		}
+
+		const FPortalBenchmark& Benchmark = PortalSubsystem->GetBenchmark();
+
+		if (Benchmark.IsRunning())
+		{
+			return false;
+		}
+
+		// Details and CSV in the log
+		Test->TestTrue(TEXT("Portal benchmark thresholds"), Benchmark.HasPassed());
+
+		return true;
+	}
+
+private:
+	FAutomationTestBase* Test;
+
+	bool bStarted;
+};
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FPortalBenchmarkTest, "EL.Portal.Benchmark", EAutomationTestFlags::ClientContext | EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+void FPortalBenchmarkTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	OutBeautifiedNames.Add(TEXT("Main"));
+	OutTestCommands.Add(TEXT("/Game/Maps/Main"));
+}
+
+bool FPortalBenchmarkTest::RunTest(const FString& Parameters)
+{
+	if (!AutomationOpenMap(Parameters))
+	{
+		AddError(FString::Printf(TEXT("Could not open %s"), *Parameters));
+		return false;
+	}
+
+	ADD_LATENT_AUTOMATION_COMMAND(FPortalBenchmarkLatentCommand(this));
+
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
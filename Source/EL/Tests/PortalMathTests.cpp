@@ -0,0 +1,254 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalMath.h"
+#include "Misc/AutomationTest.h"
+#include "Math/RandomStream.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+//-----------------------------------
+// "Automation RunTests EL.Portal.Math" : the portal geometry
+// against the conversions of the original APortal_Actor, and
+// the vector versions of the array functions against the
+// scalar ones. Timings are "Portal.MathBenchmark".
+//-----------------------------------
+
+static const uint32 PortalMathTestFlags = EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter;
+
+// Element counts around the vector width (tails of 0 to 3 elements)
+static const int32 PortalMathTestCounts[] = { 0, 1, 3, 4, 5, 7, 8, 4099 };
+
+static FQuat RandomRotation(FRandomStream& Random)
+{
+	return FRotator(Random.FRandRange(-90.0f, 90.0f), Random.FRandRange(-180.0f, 180.0f), Random.FRandRange(-180.0f, 180.0f)).Quaternion();
+}
+
+static FVector RandomLocation(FRandomStream& Random, float Range)
+{
+	return FVector(Random.FRandRange(-Range, Range), Random.FRandRange(-Range, Range), Random.FRandRange(-Range, Range));
+}
+
+// APortal_Actor::ConvertLocationToActorSpace() before FPortalMath
+static FVector ConvertLocationBaseline(const FVector& Location, const FVector& SourceLocation, const FQuat& SourceRotation, const FVector& TargetLocation, const FQuat& TargetRotation)
+{
+	FVector Direction = Location - SourceLocation;
+
+	FVector Dots;
+	Dots.X = FVector::DotProduct(Direction, SourceRotation.GetForwardVector());
+	Dots.Y = FVector::DotProduct(Direction, SourceRotation.GetRightVector());
+	Dots.Z = FVector::DotProduct(Direction, SourceRotation.GetUpVector());
+
+	FVector NewDirection = Dots.X * TargetRotation.GetForwardVector()
+		+ Dots.Y * TargetRotation.GetRightVector()
+		+ Dots.Z * TargetRotation.GetUpVector();
+
+	return TargetLocation + NewDirection;
+}
+
+// APortal_Actor::ConvertRotationToActorSpace() before FPortalMath
+static FQuat ConvertRotationBaseline(const FQuat& Rotation, const FQuat& SourceRotation, const FQuat& TargetRotation)
+{
+	FQuat LocalQuat = SourceRotation.Inverse() * Rotation;
+
+	return TargetRotation * LocalQuat;
+}
+
+// Same orientation (q and -q are the same rotation)
+static bool IsSameRotation(const FQuat& A, const FQuat& B)
+{
+	return A.GetForwardVector().Equals(B.GetForwardVector(), 0.001f)
+		&& A.GetUpVector().Equals(B.GetUpVector(), 0.001f);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathPlanesTest, "EL.Portal.Math.Planes", PortalMathTestFlags)
+
+bool FPortalMathPlanesTest::RunTest(const FString& Parameters)
+{
+	FVector Location = FVector(100.0f, -200.0f, 50.0f);
+	FQuat Rotation = FRotator(0.0f, 30.0f, 0.0f).Quaternion();
+	FVector Normal = Rotation.GetForwardVector();
+	FVector Right = Rotation.GetRightVector();
+	FVector Up = Rotation.GetUpVector();
+
+	TestTrue(TEXT("IsPointInFrontOfPlane front"), FPortalMath::IsPointInFrontOfPlane(Location + Normal, Location, Normal));
+	TestTrue(TEXT("IsPointInFrontOfPlane on the plane"), FPortalMath::IsPointInFrontOfPlane(Location + Right, Location, Normal));
+	TestFalse(TEXT("IsPointInFrontOfPlane back"), FPortalMath::IsPointInFrontOfPlane(Location - Normal, Location, Normal));
+
+	TestTrue(TEXT("IsSegmentCrossingPlane forward"), FPortalMath::IsSegmentCrossingPlane(Location + Normal, Location - Normal, Location, Normal));
+	TestFalse(TEXT("IsSegmentCrossingPlane backward"), FPortalMath::IsSegmentCrossingPlane(Location - Normal, Location + Normal, Location, Normal));
+	TestFalse(TEXT("IsSegmentCrossingPlane in front"), FPortalMath::IsSegmentCrossingPlane(Location + Normal, Location + Normal * 2.0f, Location, Normal));
+
+	TestTrue(TEXT("IsPointInsideBox inside"), FPortalMath::IsPointInsideBox(Location + Normal * 9.0f, Location, FVector(10.0f), Normal, Right, Up));
+	TestFalse(TEXT("IsPointInsideBox outside"), FPortalMath::IsPointInsideBox(Location + Normal * 11.0f, Location, FVector(10.0f), Normal, Right, Up));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathConversionsTest, "EL.Portal.Math.Conversions", PortalMathTestFlags)
+
+bool FPortalMathConversionsTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(0x1234);
+
+	for (int32 Case = 0; Case < 256; Case++)
+	{
+		FVector SourceLocation = RandomLocation(Random, 5000.0f);
+		FVector TargetLocation = RandomLocation(Random, 5000.0f);
+		FQuat SourceRotation = RandomRotation(Random);
+		FQuat TargetRotation = RandomRotation(Random);
+		FVector Location = SourceLocation + RandomLocation(Random, 500.0f);
+		FQuat Rotation = RandomRotation(Random);
+
+		//-----------------------------------
+		// Same results as the original actor conversions
+		//-----------------------------------
+		FVector Expected = ConvertLocationBaseline(Location, SourceLocation, SourceRotation, TargetLocation, TargetRotation);
+		FVector Converted = FPortalMath::ConvertLocation(Location, SourceLocation, SourceRotation, TargetLocation, TargetRotation);
+
+		if (!Converted.Equals(Expected, 0.05f))
+		{
+			AddError(FString::Printf(TEXT("ConvertLocation case %d : %s, expected %s"), Case, *Converted.ToString(), *Expected.ToString()));
+		}
+
+		FMatrix LinkMatrix = FPortalMath::MakeLinkMatrix(SourceLocation, SourceRotation, TargetLocation, TargetRotation, false);
+		FVector Linked = LinkMatrix.TransformPosition(Location);
+
+		if (!Linked.Equals(Expected, 0.05f))
+		{
+			AddError(FString::Printf(TEXT("MakeLinkMatrix case %d : %s, expected %s"), Case, *Linked.ToString(), *Expected.ToString()));
+		}
+
+		FQuat ExpectedRotation = ConvertRotationBaseline(Rotation, SourceRotation, TargetRotation);
+
+		if (!IsSameRotation(FPortalMath::ConvertRotation(Rotation, SourceRotation, TargetRotation), ExpectedRotation))
+		{
+			AddError(FString::Printf(TEXT("ConvertRotation case %d"), Case));
+		}
+
+		//-----------------------------------
+		// Mirrored : the view through the portal, half
+		// turned around the target up axis
+		//-----------------------------------
+		FMatrix ViewLinkMatrix = FPortalMath::MakeLinkMatrix(SourceLocation, SourceRotation, TargetLocation, TargetRotation, true);
+		FVector Local = SourceRotation.UnrotateVector(Location - SourceLocation);
+		FVector ExpectedMirrored = TargetLocation + TargetRotation.RotateVector(FVector(-Local.X, -Local.Y, Local.Z));
+
+		if (!ViewLinkMatrix.TransformPosition(Location).Equals(ExpectedMirrored, 0.05f))
+		{
+			AddError(FString::Printf(TEXT("MakeLinkMatrix mirrored case %d"), Case));
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathArraysTest, "EL.Portal.Math.Arrays", PortalMathTestFlags)
+
+bool FPortalMathArraysTest::RunTest(const FString& Parameters)
+{
+	FRandomStream Random(0x5678);
+
+	FVector PlaneLocation = FVector(100.0f, -200.0f, 50.0f);
+	FQuat PlaneRotation = FRotator(0.0f, 30.0f, 0.0f).Quaternion();
+	FVector Normal = PlaneRotation.GetForwardVector();
+	FVector Right = PlaneRotation.GetRightVector();
+	FVector Up = PlaneRotation.GetUpVector();
+
+	FMatrix LinkMatrix = FPortalMath::MakeLinkMatrix(PlaneLocation, PlaneRotation, FVector(-3000.0f, 750.0f, 400.0f), FRotator(10.0f, -120.0f, 5.0f).Quaternion(), false);
+
+	for (int32 Count : PortalMathTestCounts)
+	{
+		TArray<float> X, Y, Z;
+		TArray<float> CurX, CurY, CurZ;
+
+		for (int32 Index = 0; Index < Count; Index++)
+		{
+			FVector Previous = PlaneLocation + RandomLocation(Random, 100.0f);
+			FVector Current = Previous + RandomLocation(Random, 50.0f);
+
+			X.Add(Previous.X);
+			Y.Add(Previous.Y);
+			Z.Add(Previous.Z);
+			CurX.Add(Current.X);
+			CurY.Add(Current.Y);
+			CurZ.Add(Current.Z);
+		}
+
+		// In front
+		TArray<bool> InFront, InFrontScalar;
+		InFront.SetNumZeroed(Count);
+		InFrontScalar.SetNumZeroed(Count);
+
+		FPortalMath::PointsInFrontOfPlane(X.GetData(), Y.GetData(), Z.GetData(), Count, PlaneLocation, Normal, InFront.GetData());
+		FPortalMath::PointsInFrontOfPlaneScalar(X.GetData(), Y.GetData(), Z.GetData(), Count, PlaneLocation, Normal, InFrontScalar.GetData());
+
+		TestTrue(FString::Printf(TEXT("PointsInFrontOfPlane (%d)"), Count), InFront == InFrontScalar);
+
+		// Transform
+		TArray<float> TX = X, TY = Y, TZ = Z;
+		TArray<float> SX = X, SY = Y, SZ = Z;
+
+		FPortalMath::TransformPositions(LinkMatrix, TX.GetData(), TY.GetData(), TZ.GetData(), Count);
+		FPortalMath::TransformPositionsScalar(LinkMatrix, SX.GetData(), SY.GetData(), SZ.GetData(), Count);
+
+		for (int32 Index = 0; Index < Count; Index++)
+		{
+			if (!FVector(TX[Index], TY[Index], TZ[Index]).Equals(FVector(SX[Index], SY[Index], SZ[Index]), 0.01f))
+			{
+				AddError(FString::Printf(TEXT("TransformPositions (%d) differs at %d"), Count, Index));
+				break;
+			}
+		}
+
+		// Crossings, one opening for every segment
+		TArray<float> CenterX, CenterY, CenterZ, NormalX, NormalY, NormalZ, RightX, RightY, RightZ, UpX, UpY, UpZ, HalfWidths, HalfHeights;
+
+		CenterX.Init(PlaneLocation.X, Count);
+		CenterY.Init(PlaneLocation.Y, Count);
+		CenterZ.Init(PlaneLocation.Z, Count);
+		NormalX.Init(Normal.X, Count);
+		NormalY.Init(Normal.Y, Count);
+		NormalZ.Init(Normal.Z, Count);
+		RightX.Init(Right.X, Count);
+		RightY.Init(Right.Y, Count);
+		RightZ.Init(Right.Z, Count);
+		UpX.Init(Up.X, Count);
+		UpY.Init(Up.Y, Count);
+		UpZ.Init(Up.Z, Count);
+		HalfWidths.Init(60.0f, Count);
+		HalfHeights.Init(90.0f, Count);
+
+		FPortalCrossingBatch Batch;
+		Batch.PrevX = X.GetData();
+		Batch.PrevY = Y.GetData();
+		Batch.PrevZ = Z.GetData();
+		Batch.CurX = CurX.GetData();
+		Batch.CurY = CurY.GetData();
+		Batch.CurZ = CurZ.GetData();
+		Batch.CenterX = CenterX.GetData();
+		Batch.CenterY = CenterY.GetData();
+		Batch.CenterZ = CenterZ.GetData();
+		Batch.NormalX = NormalX.GetData();
+		Batch.NormalY = NormalY.GetData();
+		Batch.NormalZ = NormalZ.GetData();
+		Batch.RightX = RightX.GetData();
+		Batch.RightY = RightY.GetData();
+		Batch.RightZ = RightZ.GetData();
+		Batch.UpX = UpX.GetData();
+		Batch.UpY = UpY.GetData();
+		Batch.UpZ = UpZ.GetData();
+		Batch.HalfWidths = HalfWidths.GetData();
+		Batch.HalfHeights = HalfHeights.GetData();
+		Batch.Num = Count;
+
+		TArray<int32> Crossed, CrossedScalar;
+		FPortalMath::FindCrossings(Batch, Crossed);
+		FPortalMath::FindCrossingsScalar(Batch, CrossedScalar);
+
+		TestTrue(FString::Printf(TEXT("FindCrossings (%d)"), Count), Crossed == CrossedScalar);
+	}
+
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
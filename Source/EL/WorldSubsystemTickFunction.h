@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+
+/**
+ * Calls SubsystemType::Tick(DeltaTime) once per frame in TickGroup,
+ * for the world subsystems that need a fixed place in the frame.
+ * Not paused-ticking, never called for viewport only ticks.
+ *
+ * Registered on demand with Register() (a world without anything to
+ * update never ticks), Unregister() in the Deinitialize of the owner.
+ */
+template<typename SubsystemType, ETickingGroup TickGroupType>
+struct TWorldSubsystemTickFunction : public FTickFunction
+{
+    TWorldSubsystemTickFunction()
+    {
+        TickGroup = TickGroupType;
+        EndTickGroup = TickGroupType;
+        bCanEverTick = true;
+        bStartWithTickEnabled = true;
+        bTickEvenWhenPaused = false;
+    }
+
+    // Start ticking in the persistent level of the subsystem world, once
+    void Register(SubsystemType* InSubsystem)
+    {
+        UWorld* World = InSubsystem != nullptr ? InSubsystem->GetWorld() : nullptr;
+
+        if (IsTickFunctionRegistered() || World == nullptr || World->PersistentLevel == nullptr)
+        {
+            return;
+        }
+
+        Subsystem = InSubsystem;
+        RegisterTickFunction(World->PersistentLevel);
+    }
+
+    void Unregister()
+    {
+        if (IsTickFunctionRegistered())
+        {
+            UnRegisterTickFunction();
+        }
+
+        Subsystem = nullptr;
+    }
+
+    virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override
+    {
+        if (Subsystem != nullptr && TickType != LEVELTICK_ViewportsOnly)
+        {
+            Subsystem->Tick(DeltaTime);
+        }
+    }
+
+    virtual FString DiagnosticMessage() override
+    {
+        return Subsystem != nullptr ? Subsystem->GetClass()->GetName() + TEXT("[Tick]") : TEXT("TWorldSubsystemTickFunction");
+    }
+
+private:
+    SubsystemType* Subsystem = nullptr;
+};